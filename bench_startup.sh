@@ -0,0 +1,50 @@
+#!/bin/bash
+set -eu
+
+# --- Make sure we are in the correct directory
+cd "$(dirname "$0")"
+
+# --- Unpack arguments, e.g. 'runs=2000 budget=800 binary=/tmp/cloc'
+runs=1000
+budget=1000 # Microseconds per invocation, on top of starting any process at all
+binary=bin/cloc
+for arg in "$@"; do declare "$arg"; done
+
+if [ ! -x "$binary" ]; then
+    echo "[ERROR]: The binary '$binary' doesn't exist, build it with './build.sh release' first."
+    exit 1
+fi
+
+# --- The inputs that editor integrations and commit hooks typically pass in
+ONE_FILE="src/os.h"
+FEW_FILES="src/os.h src/input.h src/sample.h src/report.h src/trace.h"
+
+# --- Average wall clock time of one invocation in microseconds
+measure() {
+    local start end
+    start=$(date +%s%N)
+    for ((i = 0; i < runs; ++i)); do "$@" > /dev/null; done
+    end=$(date +%s%N)
+    echo $(( (end - start) / runs / 1000 ))
+}
+
+# --- Warm up the page cache, then measure the cost of starting a process that does nothing
+measure "$binary" $FEW_FILES > /dev/null
+baseline=$(measure /bin/true)
+echo "[Baseline]:  ${baseline}us per process"
+
+failed=0
+report() {
+    local name=$1 total=$2
+    local startup=$(( total - baseline ))
+    if [ $startup -gt $budget ]; then
+        echo "[ERROR]: $name took ${startup}us, over the budget of ${budget}us."
+        failed=1
+    else
+        echo "[Startup]:   $name took ${startup}us"
+    fi
+}
+
+report "1 file " "$(measure "$binary" $ONE_FILE)"
+report "5 files" "$(measure "$binary" $FEW_FILES)"
+exit $failed
@@ -0,0 +1,173 @@
+/* ------------------------------------------------- Loading ------------------------------------------------- */
+
+static
+b8 read_cache_file(Cache *cache, char *path) {
+    s64 size;
+    u8 *data = os_map_file(path, &size);
+    if(!data) return true; // No cache yet, everything is counted from scratch
+
+    Partial_Reader reader = { data, size, CACHE_MAGIC_SIZE, size >= CACHE_MAGIC_SIZE && memcmp(data, CACHE_MAGIC, CACHE_MAGIC_SIZE) == 0 };
+
+    u32 version    = read_partial_u32(&reader);
+    u32 block_size = read_partial_u32(&reader);
+    u32 state_size = read_partial_u32(&reader);
+    u64 file_count = read_partial_u64(&reader);
+
+    //
+    // A cache of a different version, or with different blocks or parser states, is just thrown away. Every
+    // entry takes up a few bytes, which protects us from absurd allocations on corrupt files.
+    //
+    if(version != CACHE_VERSION || block_size != CACHE_BLOCK_SIZE || state_size != CACHE_PARSER_STATE_SIZE || file_count > (u64) size) reader.valid = false;
+
+    s64 checkpoint_capacity = size / (5 * sizeof(u64) + CACHE_PARSER_STATE_SIZE);
+    cache->records     = reader.valid ? malloc(max(file_count, 1) * sizeof(Cache_Record)) : NULL;
+    cache->checkpoints = reader.valid ? malloc(max(checkpoint_capacity, 1) * sizeof(Cache_Checkpoint)) : NULL;
+    cache->keys        = reader.valid ? malloc(size) : NULL;
+
+    s64 checkpoint_count = 0;
+    s64 key_offset = 0;
+
+    for(u64 i = 0; reader.valid && i < file_count; ++i) {
+        s64 length;
+        char *path = read_partial_string(&reader, &length);
+        Cache_Record *record = &cache->records[i];
+        record->language         = (Language) read_partial_u32(&reader);
+        record->checkpoint_count = read_partial_u64(&reader);
+        record->checkpoints      = &cache->checkpoints[checkpoint_count];
+
+        if(!reader.valid || record->language >= LANGUAGE_COUNT || record->checkpoint_count > checkpoint_capacity - checkpoint_count) {
+            reader.valid = false;
+            break;
+        }
+
+        for(s64 j = 0; j < record->checkpoint_count; ++j) {
+            Cache_Checkpoint *checkpoint = &cache->checkpoints[checkpoint_count++];
+            checkpoint->end     = read_partial_u64(&reader);
+            checkpoint->hash    = read_partial_u64(&reader);
+            checkpoint->blank   = read_partial_u64(&reader);
+            checkpoint->comment = read_partial_u64(&reader);
+            checkpoint->code    = read_partial_u64(&reader);
+
+            u8 *state = read_partial_bytes(&reader, CACHE_PARSER_STATE_SIZE);
+            if(state) memcpy(checkpoint->parser_state, state, CACHE_PARSER_STATE_SIZE);
+        }
+
+        if(!reader.valid) break;
+
+        char *key = &cache->keys[key_offset];
+        memcpy(key, path, length);
+        key[length] = 0;
+        key_offset += length + 1;
+        string_table_insert(&cache->records_by_path, key, record);
+    }
+
+    os_unmap_file(data, size);
+
+    if(!reader.valid) {
+        printf("[WARNING]: Ignoring the cache file '%s', since it is damaged or from a different version of cloc.\n", path);
+        destroy_string_table(&cache->records_by_path);
+        create_string_table(&cache->records_by_path, 1024);
+    }
+
+    return reader.valid;
+}
+
+Cache *load_cache(Cloc *cloc, char *path) {
+    Cache *cache = malloc(sizeof(Cache));
+    memset(cache, 0, sizeof(Cache));
+    cache->path  = path;
+    cache->file_count = cloc->file_count;
+    cache->files = malloc(max(cloc->file_count, 1) * sizeof(File_Cache));
+    memset(cache->files, 0, max(cloc->file_count, 1) * sizeof(File_Cache));
+    create_string_table(&cache->records_by_path, 1024);
+
+    read_cache_file(cache, path);
+
+    //
+    // Look up every file before the workers start, so that they never have to touch the table.
+    //
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        File_Cache *entry = get_file_cache(cache, file);
+        if(!entry) continue;
+
+        s64 mark = mark_arena(&cloc->scratch);
+        Cache_Record *record = string_table_query(&cache->records_by_path, get_file_path(&cloc->scratch, file, NULL));
+        reset_arena(&cloc->scratch, mark);
+
+        if(record && record->language == file->language) {
+            entry->previous       = record->checkpoints;
+            entry->previous_count = record->checkpoint_count;
+        }
+    }
+
+    return cache;
+}
+
+File_Cache *get_file_cache(Cache *cache, File *file) {
+    // Raw files are cheap enough to always count again.
+    return cache && file->language != LANGUAGE_COUNT ? &cache->files[file->index] : NULL;
+}
+
+void destroy_cache(Cache *cache) {
+    for(s64 i = 0; i < cache->file_count; ++i) free(cache->files[i].checkpoints);
+    destroy_string_table(&cache->records_by_path);
+    free(cache->records);
+    free(cache->checkpoints);
+    free(cache->keys);
+    free(cache->files);
+    free(cache);
+}
+
+
+
+/* ------------------------------------------------- Writing ------------------------------------------------- */
+
+b8 write_cache(Cloc *cloc, Cache *cache) {
+    FILE *output = fopen(cache->path, "wb");
+    if(!output) {
+        printf("[ERROR]: Failed to create the cache file '%s'.\n", cache->path);
+        return false;
+    }
+
+    // Only files that were actually parsed have checkpoints, binary and skipped files are sniffed again.
+    s64 file_count = 0;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        File_Cache *entry = get_file_cache(cache, file);
+        file_count += entry && entry->checkpoint_count > 0;
+    }
+
+    fwrite(CACHE_MAGIC, 1, CACHE_MAGIC_SIZE, output);
+    write_partial_u32(output, CACHE_VERSION);
+    write_partial_u32(output, CACHE_BLOCK_SIZE);
+    write_partial_u32(output, CACHE_PARSER_STATE_SIZE);
+    write_partial_u64(output, file_count);
+
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        File_Cache *entry = get_file_cache(cache, file);
+        if(!entry || entry->checkpoint_count == 0) continue;
+
+        s64 mark = mark_arena(&cloc->scratch);
+        char *path = get_file_path(&cloc->scratch, file, NULL);
+        write_partial_string(output, path, strlen(path));
+        reset_arena(&cloc->scratch, mark);
+
+        write_partial_u32(output, file->language);
+        write_partial_u64(output, entry->checkpoint_count);
+
+        for(s64 i = 0; i < entry->checkpoint_count; ++i) {
+            Cache_Checkpoint *checkpoint = &entry->checkpoints[i];
+            write_partial_u64(output, checkpoint->end);
+            write_partial_u64(output, checkpoint->hash);
+            write_partial_u64(output, checkpoint->blank);
+            write_partial_u64(output, checkpoint->comment);
+            write_partial_u64(output, checkpoint->code);
+            fwrite(checkpoint->parser_state, 1, CACHE_PARSER_STATE_SIZE, output);
+        }
+    }
+
+    b8 success = !ferror(output);
+    if(fclose(output) != 0) success = false;
+
+    if(!success) printf("[ERROR]: Failed to write the cache file '%s'.\n", cache->path);
+    return success;
+}
@@ -0,0 +1,63 @@
+struct Cloc;
+
+#define CACHE_MAGIC "CLOCCACH"
+#define CACHE_MAGIC_SIZE 8
+#define CACHE_VERSION 1
+#define CACHE_BLOCK_SIZE 64 * 1024  // Must divide FILE_BUFFER_SIZE, so that a full read never splits a block
+#define CACHE_PARSER_STATE_SIZE 32  // Enough for the state of every parser, which worker.c checks
+
+//
+// The cache remembers how far every file was parsed, so that files that only grew since the last run don't
+// have to be parsed from the start again. Every file is cut into blocks, and after every block the cache
+// stores a checkpoint with the hash of that block, the stats so far and a snapshot of the parser state. The
+// last checkpoint covers the (usually shorter) rest of the file.
+//
+// On the next run, the blocks are hashed again, which is a lot cheaper than parsing them. Counting resumes
+// from the last checkpoint before the first block that changed, so a file that was appended to only parses
+// its last block and the new tail. The cache uses the encoding of the partial results:
+//
+//   Header:      magic[8], u32 version, u32 block size, u32 parser state size, u64 file count
+//   Files:       string path, u32 language, u64 checkpoint count
+//   Checkpoints: s64 end offset, u64 block hash, s64 blank, s64 comment, s64 code, u8 parser state[]
+//
+
+typedef struct Cache_Checkpoint {
+    s64 end; // The offset in the file right after this block
+    u64 hash;
+    s64 blank;
+    s64 comment;
+    s64 code;
+    u8 parser_state[CACHE_PARSER_STATE_SIZE];
+} Cache_Checkpoint;
+
+// One per file that is counted with '--cache', indexed by File.index. Only the worker counting the file touches it.
+typedef struct File_Cache {
+    Cache_Checkpoint *previous; // From the cache file, NULL if the file wasn't cached yet
+    s64 previous_count;
+    Cache_Checkpoint *checkpoints;
+    s64 checkpoint_count;
+    s64 checkpoint_capacity;
+} File_Cache;
+
+typedef struct Cache_Record {
+    Language language;
+    Cache_Checkpoint *checkpoints;
+    s64 checkpoint_count;
+} Cache_Record;
+
+typedef struct Cache {
+    char *path;
+    File_Cache *files; // Indexed by File.index
+    s64 file_count;
+
+    // --- What was loaded from the cache file
+    String_Table records_by_path;
+    Cache_Record *records;
+    Cache_Checkpoint *checkpoints;
+    char *keys;
+} Cache;
+
+Cache *load_cache(struct Cloc *cloc, char *path);
+File_Cache *get_file_cache(Cache *cache, File *file); // NULL without a cache, and for raw files
+b8 write_cache(struct Cloc *cloc, Cache *cache);
+void destroy_cache(Cache *cache);
@@ -4,14 +4,47 @@
 #include <assert.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 
 // --- Local Headers ---
 #include "os.h"
 #include "worker.h"
 #include "cloc.h"
+#include "watch.h"
+#include "diff.h"
+#include "git.h"
+#include "partial.h"
+#include "stream.h"
+#include "duplicates.h"
+#include "sample.h"
+#include "input.h"
+#include "metrics.h"
+#include "complexity.h"
+#include "progress.h"
+#include "cache.h"
+#include "counters.h"
+#include "trace.h"
+#include "history.h"
+#include "report.h"
 
 // --- Local Sources ---
 #include "worker.c"
+#include "watch.c"
+#include "diff.c"
+#include "git.c"
+#include "partial.c"
+#include "stream.c"
+#include "duplicates.c"
+#include "sample.c"
+#include "input.c"
+#include "metrics.c"
+#include "complexity.c"
+#include "progress.c"
+#include "cache.c"
+#include "counters.c"
+#include "trace.c"
+#include "history.c"
+#include "report.c"
 
 #if WIN32
 # include "win32.c"
@@ -37,15 +70,32 @@ const s64 FILE_EXTENSION_MAP_SIZE = sizeof(FILE_EXTENSION_MAP) / sizeof(FILE_EXT
 
 /* -------------------------------------------------- Arena -------------------------------------------------- */
 
+static
+void back_arena(Arena *arena, s64 end) {
+    //
+    // Keep some memory after the committed bytes backed, since aprint and sprint format their output right
+    // there before pushing it.
+    //
+    if(end + ARENA_COMMIT_SIZE <= arena->backed || arena->backed == arena->reserved) return;
+
+    s64 backed = min((end + 2 * ARENA_COMMIT_SIZE - 1) / ARENA_COMMIT_SIZE * ARENA_COMMIT_SIZE, arena->reserved);
+    b8 success = os_commit_memory(arena->base + arena->backed, backed - arena->backed);
+    assert(success && "Arena could not be backed with memory!");
+    arena->backed = backed;
+}
+
 void create_arena(Arena *arena, s64 reserved) {
-    arena->base      = (char *) malloc(reserved);
+    arena->base      = (char *) os_reserve_memory(reserved);
     arena->reserved  = reserved;
     arena->committed = 0;
+    arena->backed    = 0;
     assert(arena->base != NULL && "Arena reservation is too large!");
+    back_arena(arena, 0);
 }
 
 void *push_arena(Arena *arena, s64 bytes) {
     assert(arena->committed + bytes <= arena->reserved && "Arena ran out of space!");
+    back_arena(arena, arena->committed + bytes);
     void *pointer = (void *) (arena->base + arena->committed);
     arena->committed += bytes;
     return pointer;
@@ -67,20 +117,17 @@ void reset_arena(Arena *arena, s64 mark) {
 }
 
 void destroy_arena(Arena *arena) {
-    free(arena->base);
+    if(arena->base) os_release_memory(arena->base, arena->reserved);
     arena->base      = NULL;
     arena->reserved  = 0;
     arena->committed = 0;
+    arena->backed    = 0;
 }
 
 
 
 /* ---------------------------------------------- String Builder ---------------------------------------------- */
 
-#define aprint(arena, format, ...) push_arena(arena, sprintf((arena)->base + (arena)->committed, format, ##__VA_ARGS__) + 1)
-#define sprint(builder, format, ...) push_string_builder(builder, sprintf((builder)->arena->base + (builder)->arena->committed, format, ##__VA_ARGS__))
-
-static
 char *push_string_builder(String_Builder *builder, s64 characters) {
     assert(builder->pointer + builder->size_in_characters == builder->arena->base + builder->arena->committed); // Make sure we are still contiguous inside the arena and nothing else has used the arena since. Otherwise, our string content would be corrupted!
     char *pointer = push_arena(builder->arena, characters);
@@ -172,9 +219,83 @@ b8 string_list_contains(String_List *list, char *needle) {
 
 
 
+/* ----------------------------------------------- String Table ----------------------------------------------- */
+
+u64 hash_string(const char *string) {
+    return extend_string_hash(STRING_HASH_SEED, string);
+}
+
+u64 extend_string_hash(u64 hash, const char *string) {
+    // FNV-1a, which can be continued over multiple strings since it works byte by byte
+    while(*string) {
+        hash ^= (u8) *string;
+        hash *= 0x100000001b3;
+        ++string;
+    }
+    return hash;
+}
+
+void create_string_table(String_Table *table, s64 initial_capacity) {
+    table->capacity = 16;
+    while(table->capacity < initial_capacity) table->capacity *= 2;
+    table->count   = 0;
+    table->entries = calloc(table->capacity, sizeof(String_Table_Entry));
+}
+
+void destroy_string_table(String_Table *table) {
+    free(table->entries);
+    table->entries  = NULL;
+    table->count    = 0;
+    table->capacity = 0;
+}
+
+static
+String_Table_Entry *find_string_table_entry(String_Table_Entry *entries, s64 capacity, const char *key, u64 hash) {
+    s64 index = hash & (capacity - 1);
+    while(entries[index].key != NULL && (entries[index].hash != hash || strcmp(entries[index].key, key) != 0)) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &entries[index];
+}
+
+void *string_table_query(String_Table *table, const char *key) {
+    String_Table_Entry *entry = find_string_table_entry(table->entries, table->capacity, key, hash_string(key));
+    return entry->value;
+}
+
+void string_table_insert(String_Table *table, const char *key, void *value) {
+    if((table->count + 1) * 4 > table->capacity * 3) {
+        //
+        // Keep the load factor below 75% so that probe sequences stay short.
+        //
+        s64 new_capacity = table->capacity * 2;
+        String_Table_Entry *new_entries = calloc(new_capacity, sizeof(String_Table_Entry));
+
+        for(s64 i = 0; i < table->capacity; ++i) {
+            if(table->entries[i].key == NULL) continue;
+            *find_string_table_entry(new_entries, new_capacity, table->entries[i].key, table->entries[i].hash) = table->entries[i];
+        }
+
+        free(table->entries);
+        table->entries  = new_entries;
+        table->capacity = new_capacity;
+    }
+
+    u64 hash = hash_string(key);
+    String_Table_Entry *entry = find_string_table_entry(table->entries, table->capacity, key, hash);
+    if(entry->key == NULL) ++table->count;
+    entry->hash  = hash;
+    entry->key   = key;
+    entry->value = value;
+}
+
+
+
 /* ----------------------------------------------- Cloc Helpers ----------------------------------------------- */
 
 File *get_next_file_to_parse(Cloc *cloc) {
+    if(cloc->stream) return get_next_stream_file(cloc->stream);
+
 #if USE_CAS
     File *current;
 
@@ -196,7 +317,6 @@ File *get_next_file_to_parse(Cloc *cloc) {
 
 /* ---------------------------------------------- Stats Handling ---------------------------------------------- */
 
-static
 void combine_stats(Stats *dst, Stats *src) {
     dst->blank   += src->blank;
     dst->comment += src->comment;
@@ -204,7 +324,56 @@ void combine_stats(Stats *dst, Stats *src) {
     dst->file_count += src->file_count;
 }
 
-static
+void combine_line_metrics(Line_Metrics *dst, Line_Metrics *src) {
+    dst->max_line_length    = max(dst->max_line_length, src->max_line_length);
+    dst->total_line_length += src->total_line_length;
+    for(s64 i = 0; i < LINE_LENGTH_BUCKET_COUNT; ++i) dst->line_length_histogram[i] += src->line_length_histogram[i];
+    dst->trailing_whitespace_lines += src->trailing_whitespace_lines;
+    dst->tab_indented_lines        += src->tab_indented_lines;
+    dst->blank_bytes   += src->blank_bytes;
+    dst->comment_bytes += src->comment_bytes;
+    dst->code_bytes    += src->code_bytes;
+}
+
+void combine_code_complexity(Code_Complexity *dst, Code_Complexity *src) {
+    dst->functions += src->functions;
+    dst->branches  += src->branches;
+    dst->max_function_complexity = max(dst->max_function_complexity, src->max_function_complexity);
+    dst->max_nesting_depth       = max(dst->max_nesting_depth, src->max_nesting_depth);
+}
+
+Line_Metrics *get_file_metrics(Cloc *cloc, File *file) {
+    // Raw files have no lines to measure.
+    return cloc->line_metrics && file->language != LANGUAGE_COUNT ? &cloc->line_metrics[file->index] : NULL;
+}
+
+Code_Complexity *get_file_complexity(Cloc *cloc, File *file) {
+    // Raw files have no code to scan.
+    return cloc->code_complexity && file->language != LANGUAGE_COUNT ? &cloc->code_complexity[file->index] : NULL;
+}
+
+void add_file_to_totals(Cloc *cloc, File_Totals *totals, File *file) {
+    ++totals->status_counts[file->status];
+    if(file->language == LANGUAGE_COUNT) return;
+
+    combine_stats(&totals->language_stats[file->status][file->language], &file->stats);
+    Line_Metrics *metrics = get_file_metrics(cloc, file);
+    Code_Complexity *complexity = get_file_complexity(cloc, file);
+    if(metrics) combine_line_metrics(&totals->language_metrics[file->status][file->language], metrics);
+    if(complexity) combine_code_complexity(&totals->language_complexity[file->status][file->language], complexity);
+}
+
+void combine_file_totals(File_Totals *dst, File_Totals *src) {
+    for(s64 i = 0; i < FILE_STATUS_COUNT; ++i) {
+        dst->status_counts[i] += src->status_counts[i];
+        for(s64 j = 0; j < LANGUAGE_COUNT; ++j) {
+            combine_stats(&dst->language_stats[i][j], &src->language_stats[i][j]);
+            combine_line_metrics(&dst->language_metrics[i][j], &src->language_metrics[i][j]);
+            combine_code_complexity(&dst->language_complexity[i][j], &src->language_complexity[i][j]);
+        }
+    }
+}
+
 char *combine_file_paths(Cloc *cloc, char *directory_path, char *file_path) {
     s64 directory_path_length = strlen(directory_path);
 
@@ -227,26 +396,176 @@ char *find_file_extension(char *file_path) {
     return index ? &file_path[index] : NULL;
 }
 
-static
-void register_file_to_parse(Cloc *cloc, char *file_path) {
+Language get_language_for_file_path(char *file_path) {
     char *file_extension = find_file_extension(file_path);
-    if(!file_extension) return; // Files without a file extension are unsupported
+    if(!file_extension) return LANGUAGE_COUNT; // Files without a file extension are unsupported
 
-    Language language = LANGUAGE_COUNT;
-
-    for(s64 i = 0; i < FILE_EXTENSION_MAP_SIZE && language == LANGUAGE_COUNT; ++i) {
+    for(s64 i = 0; i < FILE_EXTENSION_MAP_SIZE; ++i) {
         if(strcmp(FILE_EXTENSION_MAP[i].extension, file_extension) == 0) {
-            language = FILE_EXTENSION_MAP[i].language;
+            return FILE_EXTENSION_MAP[i].language;
         }
     }
 
-    if(language == LANGUAGE_COUNT) return; // Unrecognized language, ignore
+    return LANGUAGE_COUNT;
+}
+
+static
+Directory_Node *create_directory_node(Arena *arena, Directory_Node *parent, char *name, s64 name_length) {
+    Directory_Node *directory = push_arena(arena, sizeof(Directory_Node));
+    directory->parent       = parent;
+    directory->first_child  = NULL;
+    directory->next_sibling = parent->first_child;
+    directory->name         = push_arena(arena, name_length + 1);
+    directory->path_length  = parent->path_length + name_length + 1;
+    directory->depth        = parent->depth + 1;
+    directory->partial_index = -1;
+    memcpy(directory->name, name, name_length);
+    directory->name[name_length] = 0;
+    parent->first_child = directory;
+    return directory;
+}
+
+Directory_Node *get_or_create_child_directory(Arena *arena, Directory_Node *parent, char *name, s64 name_length) {
+    Directory_Node *child = parent->first_child;
+    while(child && !(child->path_length - parent->path_length - 1 == name_length && memcmp(child->name, name, name_length) == 0)) child = child->next_sibling;
+    return child ? child : create_directory_node(arena, parent, name, name_length);
+}
+
+Directory_Node *intern_directory_path(Arena *arena, Directory_Node *root, char *directory_path) {
+    //
+    // Walk down the trie one path component at a time, creating the nodes that don't exist yet. The first
+    // component of an absolute POSIX path is empty, which gives us the node for '/'. Any other empty
+    // components come from duplicate or trailing separators and are skipped.
+    //
+    Directory_Node *directory = root;
+    char *component = directory_path;
+
+    while(true) {
+        char *end = component;
+        while(*end && *end != '/' && *end != '\\') ++end;
+
+        s64 length = end - component;
+        if(length > 0 || directory == root) directory = get_or_create_child_directory(arena, directory, component, length);
+
+        if(!*end) break;
+        component = end + 1;
+    }
+
+    return directory;
+}
+
+Directory_Node *find_common_directory(Directory_Node *lhs, Directory_Node *rhs) {
+    while(lhs->depth > rhs->depth) lhs = lhs->parent;
+    while(rhs->depth > lhs->depth) rhs = rhs->parent;
+
+    while(lhs != rhs) {
+        lhs = lhs->parent;
+        rhs = rhs->parent;
+    }
+
+    return lhs;
+}
+
+static
+void write_directory_path(char *buffer, Directory_Node *directory, Directory_Node *root) {
+    //
+    // Fill in the path back to front, since we can only walk the trie upwards.
+    //
+    s64 offset = directory->path_length - (root ? root->path_length : 0);
+
+    for(Directory_Node *node = directory; node != root && node->parent != NULL; node = node->parent) {
+        s64 name_length = node->path_length - node->parent->path_length - 1;
+        offset -= 1;
+        buffer[offset] = '/';
+        offset -= name_length;
+        memcpy(&buffer[offset], node->name, name_length);
+    }
+}
+
+char *get_directory_path(Arena *arena, Directory_Node *directory) {
+    char *path = push_arena(arena, directory->path_length + 1);
+    write_directory_path(path, directory, NULL);
+
+    // Only keep the trailing separator for the file system roots, since '/' or 'C:/' need it.
+    b8 is_root = directory->parent == NULL || directory->parent->parent == NULL;
+    path[is_root ? directory->path_length : directory->path_length - 1] = 0;
+    return path;
+}
+
+s64 get_file_path_length(File *file, Directory_Node *root) {
+    return file->directory->path_length - (root ? root->path_length : 0) + strlen(file->name);
+}
+
+void write_file_path(char *buffer, File *file, Directory_Node *root) {
+    s64 directory_length = file->directory->path_length - (root ? root->path_length : 0);
+    write_directory_path(buffer, file->directory, root);
+    strcpy(&buffer[directory_length], file->name);
+}
+
+char *get_file_path(Arena *arena, File *file, Directory_Node *root) {
+    char *path = push_arena(arena, get_file_path_length(file, root) + 1);
+    write_file_path(path, file, root);
+    return path;
+}
+
+static
+b8 is_counted_file(File *file) {
+    return file->language != LANGUAGE_COUNT && file->stats.file_count > 0;
+}
+
+void collect_counted_files(Cloc *cloc, Counted_Files *counted) {
+    Directory_Node *common_directory = NULL;
+    s64 file_count = 0;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        if(!is_counted_file(file)) continue;
+        common_directory = common_directory ? find_common_directory(common_directory, file->directory) : file->directory;
+        ++file_count;
+    }
+
+    s64 path_bytes = 0;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        if(is_counted_file(file)) path_bytes += get_file_path_length(file, common_directory) + 1;
+    }
+
+    create_arena(&counted->arena, max(path_bytes, 1));
+    counted->files = malloc(max(file_count, 1) * sizeof(File *));
+    counted->paths = malloc(max(file_count, 1) * sizeof(char *));
+    counted->count = 0;
+
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        if(!is_counted_file(file)) continue;
+        counted->files[counted->count] = file;
+        counted->paths[counted->count] = get_file_path(&counted->arena, file, common_directory);
+        ++counted->count;
+    }
+}
+
+void destroy_counted_files(Counted_Files *counted) {
+    destroy_arena(&counted->arena);
+    free(counted->files);
+    free(counted->paths);
+    counted->files = NULL;
+    counted->paths = NULL;
+    counted->count = 0;
+}
+
+File *register_file_to_parse(Cloc *cloc, Directory_Node *directory, char *name, u64 read_position) {
+    Language language = get_language_for_file_path(name);
+    if(language == LANGUAGE_COUNT && !cloc->lines_only) return NULL; // Unrecognized language, ignore
+
+    // In streaming mode the file goes straight to the workers, and must not be touched after this.
+    if(cloc->stream) return queue_stream_file(cloc->stream, directory, name, language, read_position);
     
     File *entry      = push_arena(&cloc->perm, sizeof(File));
     entry->next      = cloc->first_file;
-    entry->file_path = os_make_absolute_path(&cloc->perm, file_path);
+    entry->directory = directory;
+    entry->name      = push_string(&cloc->perm, name);
     entry->language  = language;
-    entry->stats.ident      = entry->file_path;
+    entry->status    = FILE_Source;
+    entry->index     = (u32) cloc->file_count;
+    entry->read_position = read_position;
+    entry->bytes     = 0;
+    entry->stats.ident      = entry->name;
     entry->stats.blank      = 0;
     entry->stats.comment    = 0;
     entry->stats.code       = 0;
@@ -254,97 +573,322 @@ void register_file_to_parse(Cloc *cloc, char *file_path) {
     cloc->first_file = entry;
     cloc->next_file  = entry;
     ++cloc->file_count;
+    return entry;
+}
+
+Directory_Node *intern_file_directory(Cloc *cloc, char *file_path, char **name) {
+    // The name is allocated in the scratch arena.
+    return intern_resolved_file_directory(cloc, os_make_absolute_path(&cloc->scratch, file_path), name);
+}
+
+Directory_Node *intern_resolved_file_directory(Cloc *cloc, char *resolved_path, char **name) {
+    //
+    // Split the resolved path into its directory and its name, cutting the string at the last separator.
+    // The name points into the given path.
+    //
+    s64 name_offset = strlen(resolved_path);
+    while(name_offset > 0 && resolved_path[name_offset - 1] != '/' && resolved_path[name_offset - 1] != '\\') --name_offset;
+
+    *name = &resolved_path[name_offset];
+    if(name_offset > 0) resolved_path[name_offset - 1] = 0;
+
+    return intern_directory_path(&cloc->perm, &cloc->root_directory, name_offset > 0 ? resolved_path : "");
+}
+
+File *register_file_path_to_parse(Cloc *cloc, char *file_path) {
+    s64 mark = mark_arena(&cloc->scratch);
+
+    char *name;
+    Directory_Node *directory = intern_file_directory(cloc, file_path, &name);
+    File *file = register_file_to_parse(cloc, directory, name, 0);
+
+    reset_arena(&cloc->scratch, mark);
+    return file;
+}
+
+b8 is_in_shard(Cloc *cloc, u64 path_hash) {
+    if(cloc->shard_count <= 1) return true;
+
+    s64 shard_index = (s64) (path_hash % (u64) cloc->shard_count);
+    return shard_index == cloc->shard_index;
 }
 
 static
-void register_directory_to_parse(Cloc *cloc, char *directory_path) {
+s64 find_file_identity_slot(File_Identity *entries, s64 capacity, u64 device, u64 inode) {
+    u64 hash = (device * 0x9e3779b97f4a7c15) ^ (inode * 0xc2b2ae3d27d4eb4f);
+    s64 slot = (s64) ((hash ^ (hash >> 29)) & (capacity - 1));
+    while(entries[slot].inode && (entries[slot].device != device || entries[slot].inode != inode)) slot = (slot + 1) & (capacity - 1);
+    return slot;
+}
+
+static
+b8 insert_file_identity(File_Identity_Set *set, u64 device, u64 inode) {
+    if(inode == 0) return true; // The platform didn't tell us, so treat it as new
+
+    if((set->count + 1) * 2 > set->capacity) {
+        s64 capacity = set->capacity ? set->capacity * 2 : FILE_IDENTITY_SET_INITIAL_CAPACITY;
+        File_Identity *entries = malloc(capacity * sizeof(File_Identity));
+        memset(entries, 0, capacity * sizeof(File_Identity));
+
+        for(s64 i = 0; i < set->capacity; ++i) {
+            if(set->entries[i].inode) entries[find_file_identity_slot(entries, capacity, set->entries[i].device, set->entries[i].inode)] = set->entries[i];
+        }
+
+        free(set->entries);
+        set->entries  = entries;
+        set->capacity = capacity;
+    }
+
+    s64 slot = find_file_identity_slot(set->entries, set->capacity, device, inode);
+    if(set->entries[slot].inode) return false;
+
+    set->entries[slot].device = device;
+    set->entries[slot].inode  = inode;
+    ++set->count;
+    return true;
+}
+
+//
+// The directories on the way from the traversal root to the current one. A directory that was already visited is
+// skipped in any case, but if it is one of these, a symlink leads back into its own parent and we say so.
+//
+typedef struct Traversal_Frame {
+    File_Identity identity;
+    struct Traversal_Frame *parent;
+} Traversal_Frame;
+
+static
+b8 enter_directory(Cloc *cloc, Traversal_Frame *frame, char *directory_path) {
+    // Without following symlinks, every directory can only be reached through one path.
+    if(!cloc->follow_symlinks || insert_file_identity(&cloc->visited_identities, frame->identity.device, frame->identity.inode)) return true;
+
+    for(Traversal_Frame *ancestor = frame->parent; ancestor != NULL; ancestor = ancestor->parent) {
+        if(ancestor->identity.device == frame->identity.device && ancestor->identity.inode == frame->identity.inode) {
+            printf("[WARNING]: Skipping the directory '%s', since it leads back into itself.\n", directory_path);
+            break;
+        }
+    }
+
+    return false;
+}
+
+static
+void register_directory_node_to_parse(Cloc *cloc, Directory_Node *directory, char *directory_path, u64 path_hash, Traversal_Frame *frame) {
+    //
+    // The path hash covers the path relative to the directory the traversal started in, so that processes
+    // on different machines agree on the sharding even if their checkouts live in different places.
+    //
     s64 mark = mark_arena(&cloc->scratch);
+    Hardware_Time scan_start = cloc->trace ? os_get_hardware_time() : 0;
+
+    // Start watching this directory before we list its content, so that no change can slip in between.
+    if(cloc->watch_daemon) register_watched_directory(cloc->watch_daemon, directory_path);
     
-    char *resolved_path = os_make_absolute_path(&cloc->scratch, directory_path); // Resolve any tricks in this path here to make our future easier.
-    
-    File_Iterator iterator = find_first_file(&cloc->scratch, resolved_path);
+    File_Iterator iterator = find_first_file(&cloc->scratch, directory_path, cloc->follow_symlinks);
     
     while(iterator.valid) {
         if(strcmp(iterator.path, ".") == 0 || strcmp(iterator.path, "..") == 0) {
             // Ignore these paths
         } else if(iterator.kind == OS_PATH_Is_Directory && !string_list_contains(cloc->excluded_directories, iterator.path)) {
-            register_directory_to_parse(cloc, combine_file_paths(cloc, resolved_path, iterator.path));
-        } else if(iterator.kind == OS_PATH_Is_File) {
-            register_file_to_parse(cloc, combine_file_paths(cloc, resolved_path, iterator.path));
+            Traversal_Frame child_frame = { { iterator.device, iterator.inode }, frame };
+            char *child_path = combine_file_paths(cloc, directory_path, iterator.path);
+
+            if(enter_directory(cloc, &child_frame, child_path)) {
+                // Every directory is only listed once during the traversal, so its children are always new nodes.
+                Directory_Node *child = create_directory_node(&cloc->perm, directory, iterator.path, strlen(iterator.path));
+                register_directory_node_to_parse(cloc, child, child_path, extend_string_hash(extend_string_hash(path_hash, iterator.path), "/"), &child_frame);
+            }
+        } else if(iterator.kind == OS_PATH_Is_File && is_in_shard(cloc, extend_string_hash(path_hash, iterator.path))) {
+            // Hardlinks and symlinked files are only counted through the first path we find them at.
+            if(!cloc->follow_symlinks || insert_file_identity(&cloc->visited_identities, iterator.device, iterator.inode)) {
+                register_file_to_parse(cloc, directory, iterator.path, iterator.inode);
+            }
         }
 
         find_next_file(&cloc->scratch, &iterator);
     }
 
+    close_file_iterator(&iterator);
     reset_arena(&cloc->scratch, mark);
+
+    // Includes the scans of all subdirectories, which nest inside of this one in the trace.
+    if(cloc->trace) record_trace_span(&cloc->trace->buffers[0], TRACE_SPAN_Directory_Scan, scan_start, directory, 0);
 }
 
+void register_directory_to_parse(Cloc *cloc, char *directory_path) {
+    s64 mark = mark_arena(&cloc->scratch);
+    
+    char *resolved_path = os_make_absolute_path(&cloc->scratch, directory_path); // Resolve any tricks in this path here to make our future easier.
+
+    Traversal_Frame frame = { { 0, 0 }, NULL };
+    if(cloc->follow_symlinks) os_get_file_identity(resolved_path, &frame.identity.device, &frame.identity.inode);
+
+    if(enter_directory(cloc, &frame, resolved_path)) {
+        Directory_Node *directory = intern_directory_path(&cloc->perm, &cloc->root_directory, resolved_path);
+        register_directory_node_to_parse(cloc, directory, resolved_path, STRING_HASH_SEED, &frame);
+    }
+
+    reset_arena(&cloc->scratch, mark);
+}
+
+void register_path_to_parse(Cloc *cloc, char *path, OS_Path_Kind kind) {
+    switch(kind) {
+    case OS_PATH_Is_File: {
+        u64 device = 0, inode = 0;
+        if(cloc->follow_symlinks && os_get_file_identity(path, &device, &inode) && !insert_file_identity(&cloc->visited_identities, device, inode)) break;
+
+        // Files on the command line are sharded by the path as it was given.
+        if(is_in_shard(cloc, hash_string(path))) register_file_path_to_parse(cloc, path);
+    } break;
+
+    case OS_PATH_Is_Directory:
+        register_directory_to_parse(cloc, path);
+        break;
+
+    case OS_PATH_Non_Existent:
+        break;
+    }
+}
 
 
-/* ----------------------------------------------- Table Output ----------------------------------------------- */
+
+/* ------------------------------------------------ Read Order ------------------------------------------------ */
 
 static
-void print_separator_line(Cloc *cloc, const char *content) {
+int compare_files_by_read_position(const void *lhs, const void *rhs) {
+    u64 lhs_position = (*(File **) lhs)->read_position;
+    u64 rhs_position = (*(File **) rhs)->read_position;
+    return lhs_position < rhs_position ? -1 : lhs_position > rhs_position;
+}
+
+static
+void sort_file_array(Cloc *cloc, File **files, s64 file_count) {
+    qsort(files, file_count, sizeof(File *), compare_files_by_read_position);
+
+    for(s64 i = 0; i < file_count; ++i) files[i]->next = i + 1 < file_count ? files[i + 1] : NULL;
+    cloc->first_file = file_count ? files[0] : NULL;
+    cloc->next_file  = cloc->first_file;
+}
+
+void sort_files_by_read_order(Cloc *cloc) {
+    if(cloc->read_order == READ_ORDER_Traversal || cloc->file_count == 0) return;
+
+    File **files = malloc(cloc->file_count * sizeof(File *));
+    s64 file_count = 0;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) files[file_count++] = file;
+
+    //
+    // The inodes come for free with the directory listing. Files that were given on the command line don't
+    // have one, and just end up at the front.
+    //
+    sort_file_array(cloc, files, file_count);
+
+    if(cloc->read_order == READ_ORDER_Extent) {
+        //
+        // Looking up the extents needs the inode of every file, so doing that in inode order already avoids
+        // most of the seeking. Files whose extents are unknown keep their inode order at the front, since
+        // mixing inodes and disk offsets in one key would be meaningless. Offsets are shifted by one bit to
+        // make room for that.
+        //
+        s64 mark = mark_arena(&cloc->scratch);
+
+        for(s64 i = 0; i < file_count; ++i) {
+            u64 offset = os_get_physical_file_offset(get_file_path(&cloc->scratch, files[i], NULL));
+            files[i]->read_position = offset ? (1ULL << 63) | (offset >> 1) : files[i]->read_position >> 1;
+            reset_arena(&cloc->scratch, mark);
+        }
+
+        sort_file_array(cloc, files, file_count);
+    }
+
+    free(files);
+}
+
+static
+b8 is_small_input(Cloc *cloc) {
+    if(cloc->file_count > INLINE_MAX_FILES) return false;
+
+    s64 bytes = 0;
+    for(File *file = cloc->first_file; file != NULL && bytes <= INLINE_MAX_BYTES; file = file->next) {
+        s64 mark = mark_arena(&cloc->scratch);
+        bytes += os_get_file_size_by_path(get_file_path(&cloc->scratch, file, NULL));
+        reset_arena(&cloc->scratch, mark);
+    }
+
+    return bytes <= INLINE_MAX_BYTES;
+}
+
+
+
+/* ----------------------------------------------- Table Output ----------------------------------------------- */
+
+//
+// The lines of the tables are built separately from printing them, so that reports can also write them into
+// their own buffers.
+//
+void append_separator_line(String_Builder *builder, const char *content) {
     const char DELIMITER_CHAR = '-';
 
     s64 content_length = strlen(content);
     if(content_length > 0) {
-        String_Builder builder;
-        create_string_builder(&builder, &cloc->scratch);
-    
         s64 total_stars = (OUTPUT_LINE_WIDTH - content_length - 2);
         s64 lhs_stars = total_stars / 2;
         s64 rhs_stars = total_stars / 2 + total_stars % 2;
 
-        append_repeated_char(&builder, DELIMITER_CHAR, lhs_stars);
-        append_char(&builder, ' ');
-        append_string(&builder, content);
-        append_char(&builder, ' ');
-        append_repeated_char(&builder, DELIMITER_CHAR, rhs_stars);
-    
-        print_string_builder_as_line(&builder);
+        append_repeated_char(builder, DELIMITER_CHAR, lhs_stars);
+        append_char(builder, ' ');
+        append_string(builder, content);
+        append_char(builder, ' ');
+        append_repeated_char(builder, DELIMITER_CHAR, rhs_stars);
     } else {
-        char line[OUTPUT_LINE_WIDTH];
-        memset(line, DELIMITER_CHAR, sizeof(line));
-        printf("%.*s\n", OUTPUT_LINE_WIDTH, line);
+        append_repeated_char(builder, DELIMITER_CHAR, OUTPUT_LINE_WIDTH);
     }
 }
 
+void append_table_header(String_Builder *builder, const char *ident_header, b8 is_language_entries) {
+    append_string(builder, ident_header);
+    if(is_language_entries)
+        append_right_justified_string_at_offset(builder, "Files", ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(builder, "Empty",   ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(builder, "Comment", ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(builder, "Code",    ' ', CODE_LINES_COLUMN_OFFSET);
+}
+
+void append_table_entry(String_Builder *builder, const char *ident, Stats *stats, b8 is_language_entries) {
+    append_string_with_max_length(builder, ident, (is_language_entries ? FILE_COUNT_COLUMN_OFFSET : EMPTY_LINES_COLUMN_OFFSET) - 3);
+    if(is_language_entries)
+        append_right_justified_integer_at_offset(builder, stats->file_count,    ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(builder, stats->blank,         ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(builder, stats->comment,       ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(builder, stats->code,          ' ', CODE_LINES_COLUMN_OFFSET);
+}
+
+void print_separator_line(Cloc *cloc, const char *content) {
+    s64 mark = mark_arena(&cloc->scratch);
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_separator_line(&builder, content);
+    print_string_builder_as_line(&builder);
+    reset_arena(&cloc->scratch, mark);
+}
+
 static
 void print_table_header_line(Cloc *cloc) {
     String_Builder builder;
     create_string_builder(&builder, &cloc->scratch);
 
     switch(cloc->output_mode) {
-    case OUTPUT_By_File:
-        append_string(&builder, "File");
-        append_right_justified_string_at_offset(&builder, "Empty",   ' ', EMPTY_LINES_COLUMN_OFFSET);
-        append_right_justified_string_at_offset(&builder, "Comment", ' ', COMMENT_LINES_COLUMN_OFFSET);
-        append_right_justified_string_at_offset(&builder, "Code",    ' ', CODE_LINES_COLUMN_OFFSET);
-        break;
-
-    case OUTPUT_By_Language:
-        append_string(&builder, "Language");
-        append_right_justified_string_at_offset(&builder, "Files",    ' ', FILE_COUNT_COLUMN_OFFSET);
-        append_right_justified_string_at_offset(&builder, "Empty",    ' ', EMPTY_LINES_COLUMN_OFFSET);
-        append_right_justified_string_at_offset(&builder, "Comment",  ' ', COMMENT_LINES_COLUMN_OFFSET);
-        append_right_justified_string_at_offset(&builder, "Code",     ' ', CODE_LINES_COLUMN_OFFSET);
-        break;
+    case OUTPUT_By_File:     append_table_header(&builder, "File", false); break;
+    case OUTPUT_By_Language: append_table_header(&builder, "Language", true); break;
     }
 
     print_string_builder_as_line(&builder);
 }
 
-static
 void print_table_entry_line(Cloc *cloc, Stats *stats, b8 is_language_entries) {
     String_Builder builder;
     create_string_builder(&builder, &cloc->scratch);
-    append_string_with_max_length(&builder, &stats->ident[cloc->common_prefix_length], (is_language_entries ? FILE_COUNT_COLUMN_OFFSET : EMPTY_LINES_COLUMN_OFFSET) - 3);
-    if(is_language_entries)
-        append_right_justified_integer_at_offset(&builder, stats->file_count,    ' ', FILE_COUNT_COLUMN_OFFSET);
-    append_right_justified_integer_at_offset(&builder, stats->blank,         ' ', EMPTY_LINES_COLUMN_OFFSET);
-    append_right_justified_integer_at_offset(&builder, stats->comment,       ' ', COMMENT_LINES_COLUMN_OFFSET);
-    append_right_justified_integer_at_offset(&builder, stats->code,          ' ', CODE_LINES_COLUMN_OFFSET);
+    append_table_entry(&builder, &stats->ident[cloc->common_prefix_length], stats, is_language_entries);
     print_string_builder_as_line(&builder);    
 }
 
@@ -402,6 +946,248 @@ void prepare_stats(Cloc *cloc, Stats *stats, s64 stat_count, b8 set_common_prefi
 }
 
 
+Stats print_file_stats_table(Cloc *cloc, Stats *file_stats, s64 file_count, b8 set_common_prefix) {
+    Stats sum_stats = { 0 };
+    sum_stats.ident = "SUM:";
+
+    for(s64 i = 0; i < file_count; ++i) {
+        combine_stats(&sum_stats, &file_stats[i]);
+    }
+
+    prepare_stats(cloc, file_stats, file_count, set_common_prefix);
+            
+    for(s64 i = 0; i < file_count; ++i) {
+        print_table_entry_line(cloc, &file_stats[i], false);
+    }
+
+    if(sum_stats.file_count > 1) {
+        cloc->common_prefix = NULL;
+        cloc->common_prefix_length = 0;
+        print_separator_line(cloc, "");
+        print_table_entry_line(cloc, &sum_stats, false);
+    }
+
+    return sum_stats;
+}
+
+Stats print_language_stats_table(Cloc *cloc, Stats language_stats[LANGUAGE_COUNT]) {
+    Stats sum_stats = { 0 };
+    sum_stats.ident = "SUM:";
+
+    Stats sorted_stats[LANGUAGE_COUNT];
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+        sorted_stats[i] = language_stats[i];
+        sorted_stats[i].ident = LANGUAGE_STRINGS[i];
+        combine_stats(&sum_stats, &language_stats[i]);
+    }
+
+    prepare_stats(cloc, sorted_stats, LANGUAGE_COUNT, false);
+            
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+        if(sorted_stats[i].file_count > 0) print_table_entry_line(cloc, &sorted_stats[i], true);
+    }
+
+    if(sum_stats.file_count > 1) {
+        cloc->common_prefix = NULL;
+        cloc->common_prefix_length = 0;
+        print_separator_line(cloc, "");
+        print_table_entry_line(cloc, &sum_stats, true);
+    }
+
+    return sum_stats;
+}
+
+void print_skipped_files_line(Cloc *cloc, s64 status_counts[FILE_STATUS_COUNT]) {
+    //
+    // Let the user know about the files that were dropped, since these are not visible in the tables.
+    //
+    s64 skipped_generated = cloc->skip_generated ? status_counts[FILE_Generated] : 0;
+    if(status_counts[FILE_Binary] > 0 || skipped_generated > 0) {
+        if(skipped_generated > 0) {
+            print_separator_line(cloc, aprint(&cloc->scratch, "Skipped %" PRId64 " binary, %" PRId64 " generated files", status_counts[FILE_Binary], skipped_generated));
+        } else {
+            print_separator_line(cloc, aprint(&cloc->scratch, "Skipped %" PRId64 " binary files", status_counts[FILE_Binary]));
+        }
+    }
+}
+
+static
+Stats print_stats_table_for_status(Cloc *cloc, File_Status status) {
+    switch(cloc->output_mode) {
+    case OUTPUT_By_File: {
+        //
+        // The common prefix of all files is just the deepest directory that contains all of them, so we
+        // can build the idents relative to that directory right away.
+        //
+        Directory_Node *common_directory = NULL;
+        for(File *file = cloc->first_file; file != NULL; file = file->next) {
+            if(file->status != status || file->stats.file_count == 0) continue;
+            common_directory = common_directory ? find_common_directory(common_directory, file->directory) : file->directory;
+        }
+
+        Stats *file_stats = push_arena(&cloc->scratch, cloc->file_count * sizeof(Stats));
+
+        s64 index = 0;
+        for(File *file = cloc->first_file; file != NULL; file = file->next) {
+            if(file->status != status || file->stats.file_count == 0) continue;
+            file_stats[index] = file->stats;
+            file_stats[index].ident = get_file_path(&cloc->scratch, file, common_directory);
+            ++index;
+        }
+
+        cloc->common_prefix = NULL;
+        cloc->common_prefix_length = 0;
+        return print_file_stats_table(cloc, file_stats, index, false);
+    }
+
+    case OUTPUT_By_Language: {
+        Stats language_stats[LANGUAGE_COUNT];
+        memcpy(language_stats, cloc->totals.language_stats[status], LANGUAGE_COUNT * sizeof(Stats));
+        return print_language_stats_table(cloc, language_stats);
+    }
+    }
+
+    Stats empty = { 0 };
+    return empty;
+}
+
+typedef struct Raw_Stats {
+    const char *ident;
+    s64 file_count;
+    s64 bytes;
+    s64 lines;
+} Raw_Stats;
+
+static
+int compare_raw_stats(const void *lhs, const void *rhs) {
+    const Raw_Stats *a = lhs, *b = rhs;
+    if(a->lines != b->lines) return a->lines > b->lines ? -1 : 1;
+    if(a->file_count != b->file_count) return a->file_count > b->file_count ? -1 : 1;
+    return strcmp(a->ident, b->ident);
+}
+
+static
+void print_raw_stats_line(Cloc *cloc, Raw_Stats *stats, b8 is_extension_entries) {
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string_with_max_length(&builder, stats->ident, (is_extension_entries ? FILE_COUNT_COLUMN_OFFSET : COMMENT_LINES_COLUMN_OFFSET) - 3);
+    if(is_extension_entries)
+        append_right_justified_integer_at_offset(&builder, stats->file_count, ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(&builder, stats->bytes, ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(&builder, stats->lines, ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+}
+
+static
+Stats print_raw_stats_table(Cloc *cloc) {
+    //
+    // Files of unknown languages only have physical lines, so they get their own table, grouped by their
+    // extension instead of their language.
+    //
+    b8 by_extension = cloc->output_mode == OUTPUT_By_Language;
+
+    print_separator_line(cloc, "Lines only");
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string(&builder, by_extension ? "Extension" : "File");
+    if(by_extension)
+        append_right_justified_string_at_offset(&builder, "Files", ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Bytes", ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Lines", ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+    print_separator_line(cloc, "");
+
+    Directory_Node *common_directory = NULL;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        if(file->status != FILE_Raw) continue;
+        common_directory = common_directory ? find_common_directory(common_directory, file->directory) : file->directory;
+    }
+
+    Raw_Stats *rows = push_arena(&cloc->scratch, cloc->file_count * sizeof(Raw_Stats));
+    s64 row_count   = 0;
+    Raw_Stats sum_stats = { "SUM:", 0, 0, 0 };
+
+    String_Table rows_by_extension;
+    if(by_extension) create_string_table(&rows_by_extension, 64);
+
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        if(file->status != FILE_Raw) continue;
+
+        Raw_Stats *row;
+        if(by_extension) {
+            char *extension = strrchr(file->name, '.');
+            if(!extension || extension == file->name) extension = "(none)"; // Dot files don't have an extension either
+
+            s64 row_index = (s64) string_table_query(&rows_by_extension, extension);
+            if(!row_index) {
+                row_index = ++row_count;
+                rows[row_index - 1] = (Raw_Stats) { extension, 0, 0, 0 };
+                string_table_insert(&rows_by_extension, extension, (void *) row_index);
+            }
+
+            row = &rows[row_index - 1];
+        } else {
+            row = &rows[row_count++];
+            *row = (Raw_Stats) { get_file_path(&cloc->scratch, file, common_directory), 0, 0, 0 };
+        }
+
+        row->file_count += 1;
+        row->bytes      += file->bytes;
+        row->lines      += file->stats.code;
+        sum_stats.file_count += 1;
+        sum_stats.bytes      += file->bytes;
+        sum_stats.lines      += file->stats.code;
+    }
+
+    if(by_extension) destroy_string_table(&rows_by_extension);
+
+    qsort(rows, row_count, sizeof(Raw_Stats), compare_raw_stats);
+    for(s64 i = 0; i < row_count; ++i) print_raw_stats_line(cloc, &rows[i], by_extension);
+
+    if(sum_stats.file_count > 1) {
+        print_separator_line(cloc, "");
+        print_raw_stats_line(cloc, &sum_stats, by_extension);
+    }
+
+    Stats stats = { 0 };
+    stats.code       = sum_stats.lines;
+    stats.file_count = sum_stats.file_count;
+    return stats;
+}
+
+Stats print_stats_table(Cloc *cloc) {
+    s64 *status_counts = cloc->totals.status_counts;
+
+    Stats sum_stats = print_stats_table_for_status(cloc, FILE_Source);
+
+    if(cloc->report_generated && status_counts[FILE_Generated] > 0) {
+        print_separator_line(cloc, "Generated");
+        Stats generated_stats = print_stats_table_for_status(cloc, FILE_Generated);
+        combine_stats(&sum_stats, &generated_stats);
+    }
+
+    if(status_counts[FILE_Raw] > 0) {
+        Stats raw_stats = print_raw_stats_table(cloc);
+        combine_stats(&sum_stats, &raw_stats);
+    }
+
+    print_skipped_files_line(cloc, status_counts);
+    return sum_stats;
+}
+
+
+
+static
+void print_timing_line(Cloc *cloc, Hardware_Time start, Stats *sum_stats) {
+    Hardware_Time end = os_get_hardware_time();
+    f64 seconds   = os_convert_hardware_time_to_seconds(end - start);
+    f64 lps       = (sum_stats->blank + sum_stats->comment + sum_stats->code) / seconds;
+    f64 megabytes = os_get_working_set_size() / 1000000;
+    print_separator_line(cloc, aprint(&cloc->scratch, "%.2fs // %" PRId64 " l/s // %.1fmb", seconds, (s64) lps, megabytes));
+}
+
+
 
 /* ----------------------------------------------- Entry Point ----------------------------------------------- */
 
@@ -412,8 +1198,21 @@ int main(int argc, char *argv[]) {
     // Set up the global instance
     //
     Cloc cloc = { 0 };
-    create_arena(&cloc.perm, 1024 * 1024);
-    create_arena(&cloc.scratch, 1024 * 1024);
+    create_arena(&cloc.perm, PERM_ARENA_SIZE);
+    create_arena(&cloc.scratch, SCRATCH_ARENA_SIZE);
+
+    char *partial_output_path = NULL;
+    b8 merge_mode = false;
+    String_List *stream_paths = NULL;
+    char *cache_path = NULL;
+    char *trace_path = NULL;
+    char *record_path = NULL;
+    char *record_label = NULL;
+    b8 record_directories = false;
+    char *history_path = NULL;
+    char *history_series = NULL;
+    char *history_column = NULL;
+    s64 history_last_count = 0;
     
     {
 
@@ -433,6 +1232,14 @@ int main(int argc, char *argv[]) {
         // specified doesn't matter.
         //
         String_List *filepaths = NULL;
+        char *watch_socket_path = NULL;
+        char *diff_old_path = NULL;
+        char *diff_new_path = NULL;
+        String_List *git_revisions = NULL;
+        String_List *merge_paths = NULL;
+        String_List *file_lists = NULL;
+        String_List *compile_databases = NULL;
+        b8 include_depfiles = false;
 
         for(int i = 1; i < argc;) {
             char *argument = argv[i];
@@ -449,6 +1256,174 @@ int main(int argc, char *argv[]) {
             } else if(strcmp(argument, "--no-jobs") == 0) {
                 cloc.no_jobs = true;
                 ++i;
+            } else if(strcmp(argument, "--stream") == 0) {
+                cloc.stream_output = true;
+                ++i;
+            } else if(strcmp(argument, "--lines-only") == 0) {
+                cloc.lines_only = true;
+                ++i;
+            } else if(strcmp(argument, "--report-generated") == 0) {
+                cloc.report_generated = true;
+                ++i;
+            } else if(strcmp(argument, "--skip-generated") == 0) {
+                cloc.skip_generated = true;
+                ++i;
+            } else if(strcmp(argument, "--metrics") == 0) {
+                cloc.collect_metrics = true;
+                ++i;
+            } else if(strcmp(argument, "--complexity") == 0) {
+                cloc.collect_complexity = true;
+                ++i;
+            } else if(strcmp(argument, "--follow-symlinks") == 0) {
+                cloc.follow_symlinks = true;
+                ++i;
+            } else if(strcmp(argument, "--hw-counters") == 0) {
+                cloc.count_hardware_events = true;
+                ++i;
+            } else if(strcmp(argument, "--progress") == 0) {
+                cloc.show_progress = true;
+                ++i;
+            } else if(strcmp(argument, "--duplicates") == 0) {
+                if(!cloc.duplicate_window) cloc.duplicate_window = DUPLICATE_DEFAULT_WINDOW;
+                ++i;
+            } else if(strcmp(argument, "--duplicate-lines") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                char *end;
+                cloc.duplicate_window = strtoll(argv[i + 1], &end, 10);
+                if(*end != 0 || cloc.duplicate_window < 1) {
+                    printf("[ERROR]: The option '%s' expects a positive number of code lines.\n", argument);
+                    cloc.cli_valid = false;
+                }
+                i += 2;
+            } else if(strcmp(argument, "--sample") == 0) {
+                //
+                // Either a fraction of all files (which must contain a '.'), or an absolute number of files.
+                //
+                EXPECT_ADDITIONAL_ARG();
+                char *end;
+                if(strchr(argv[i + 1], '.')) {
+                    cloc.sample_fraction = strtod(argv[i + 1], &end);
+                    cloc.sample_count    = 0;
+                    if(*end != 0 || cloc.sample_fraction <= 0 || cloc.sample_fraction > 1) cloc.cli_valid = false;
+                } else {
+                    cloc.sample_count    = strtoll(argv[i + 1], &end, 10);
+                    cloc.sample_fraction = 0;
+                    if(*end != 0 || cloc.sample_count < 1) cloc.cli_valid = false;
+                }
+
+                if(!cloc.cli_valid) printf("[ERROR]: The option '%s' expects a fraction in (0, 1] or a positive number of files.\n", argument);
+                i += 2;
+            } else if(strcmp(argument, "--diff") == 0) {
+                if(i + 2 >= argc || argv[i + 1][0] == '-' || argv[i + 2][0] == '-') {
+                    printf("[ERROR]: The option '%s' expects two additional arguments.\n", argument);
+                    cloc.cli_valid = false;
+                    i += 1;
+                    continue;
+                }
+
+                cloc.diff_mode = true;
+                diff_old_path  = argv[i + 1];
+                diff_new_path  = argv[i + 2];
+                i += 3;
+            } else if(strcmp(argument, "--rev") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                git_revisions = append_string_list(&cloc.scratch, git_revisions, argv[i + 1]);
+                i += 2;
+            } else if(strcmp(argument, "--cache") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                cache_path = argv[i + 1];
+                i += 2;
+            } else if(strcmp(argument, "--trace") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                trace_path = argv[i + 1];
+                i += 2;
+            } else if(strcmp(argument, "--report") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                if(!add_report(&cloc, argv[i + 1])) cloc.cli_valid = false;
+                i += 2;
+            } else if(strcmp(argument, "--record") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                record_path = argv[i + 1];
+                i += 2;
+            } else if(strcmp(argument, "--label") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                record_label = argv[i + 1];
+                i += 2;
+            } else if(strcmp(argument, "--record-directories") == 0) {
+                record_directories = true;
+                ++i;
+            } else if(strcmp(argument, "--history") == 0) {
+                if(i + 3 >= argc || argv[i + 1][0] == '-' || argv[i + 2][0] == '-' || argv[i + 3][0] == '-') {
+                    printf("[ERROR]: The option '%s' expects three additional arguments.\n", argument);
+                    cloc.cli_valid = false;
+                    i += 1;
+                    continue;
+                }
+
+                history_path   = argv[i + 1];
+                history_series = argv[i + 2];
+                history_column = argv[i + 3];
+                i += 4;
+            } else if(strcmp(argument, "--last") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                char *end;
+                history_last_count = strtoll(argv[i + 1], &end, 10);
+                if(*end != 0 || history_last_count < 1) {
+                    printf("[ERROR]: The option '%s' expects a positive number of runs.\n", argument);
+                    cloc.cli_valid = false;
+                }
+                i += 2;
+            } else if(strcmp(argument, "--emit-partial") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                partial_output_path = argv[i + 1];
+                i += 2;
+            } else if(strcmp(argument, "--merge") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                for(++i; i < argc && argv[i][0] != '-'; ++i) {
+                    merge_paths = append_string_list(&cloc.scratch, merge_paths, argv[i]);
+                }
+            } else if(strcmp(argument, "--shard") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                char *end;
+                s64 shard_index = strtoll(argv[i + 1], &end, 10);
+                s64 shard_count = *end == '/' ? strtoll(end + 1, &end, 10) : 0;
+                if(*end != 0 || shard_index < 1 || shard_index > shard_count) {
+                    printf("[ERROR]: The option '%s' expects an argument of the form 'i/n', where 1 <= i <= n.\n", argument);
+                    cloc.cli_valid = false;
+                } else {
+                    cloc.shard_index = shard_index - 1;
+                    cloc.shard_count = shard_count;
+                }
+                i += 2;
+            } else if(strcmp(argument, "--files-from") == 0) {
+                // '-' reads the list from the standard input.
+                if(i + 1 >= argc || strcmp(argv[i + 1], "-") != 0) EXPECT_ADDITIONAL_ARG();
+                file_lists = append_string_list(&cloc.scratch, file_lists, argv[i + 1]);
+                i += 2;
+            } else if(strcmp(argument, "--compile-commands") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                compile_databases = append_string_list(&cloc.scratch, compile_databases, argv[i + 1]);
+                i += 2;
+            } else if(strcmp(argument, "--depfiles") == 0) {
+                include_depfiles = true;
+                ++i;
+            } else if(strcmp(argument, "--watch") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                watch_socket_path = argv[i + 1];
+                i += 2;
+            } else if(strcmp(argument, "--read-order") == 0) {
+                EXPECT_ADDITIONAL_ARG();
+                if(strcmp(argv[i + 1], "traversal") == 0) {
+                    cloc.read_order = READ_ORDER_Traversal;
+                } else if(strcmp(argv[i + 1], "inode") == 0) {
+                    cloc.read_order = READ_ORDER_Inode;
+                } else if(strcmp(argv[i + 1], "extent") == 0) {
+                    cloc.read_order = READ_ORDER_Extent;
+                } else {
+                    printf("[ERROR]: Unknown read order '%s', expected 'traversal', 'inode' or 'extent'.\n", argv[i + 1]);
+                    cloc.cli_valid = false;
+                }
+                i += 2;
             } else if(strcmp(argument, "--exclude-dir") == 0) {
                 EXPECT_ADDITIONAL_ARG();
                 cloc.excluded_directories = append_string_list(&cloc.perm, cloc.excluded_directories, argv[i + 1]);
@@ -460,118 +1435,358 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        if(cloc.cli_valid && cloc.diff_mode && (filepaths || watch_socket_path)) {
+            printf("[ERROR]: The option '--diff' cannot be combined with other file paths or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && (merge_paths || partial_output_path) && (cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The options '--merge' and '--emit-partial' cannot be combined with '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.stream_output && (merge_paths || partial_output_path || cloc.diff_mode || git_revisions || watch_socket_path || cloc.read_order != READ_ORDER_Traversal)) {
+            printf("[ERROR]: The option '--stream' cannot be combined with '--merge', '--emit-partial', '--diff', '--rev', '--watch' or '--read-order'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.duplicate_window && (merge_paths || cloc.stream_output || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--duplicates' cannot be combined with '--merge', '--stream', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && (cloc.sample_fraction || cloc.sample_count) && (cloc.output_mode == OUTPUT_By_File || cloc.report_generated || merge_paths || partial_output_path || cloc.stream_output || cloc.duplicate_window || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--sample' cannot be combined with '--by-file', '--report-generated', '--merge', '--emit-partial', '--stream', '--duplicates', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.skip_generated && cloc.report_generated) {
+            printf("[ERROR]: The options '--skip-generated' and '--report-generated' cannot be combined.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.lines_only && (merge_paths || partial_output_path || cloc.stream_output || cloc.duplicate_window || cloc.sample_fraction || cloc.sample_count || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--lines-only' cannot be combined with '--merge', '--emit-partial', '--stream', '--duplicates', '--sample', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && (file_lists || compile_databases) && (merge_paths || cloc.stream_output || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The options '--files-from' and '--compile-commands' cannot be combined with '--merge', '--stream', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.show_progress && (merge_paths || cloc.stream_output || cloc.diff_mode || git_revisions)) {
+            printf("[ERROR]: The option '--progress' cannot be combined with '--merge', '--stream', '--diff' or '--rev'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.collect_metrics && (merge_paths || cloc.stream_output || cloc.sample_fraction || cloc.sample_count || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--metrics' cannot be combined with '--merge', '--stream', '--sample', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.collect_complexity && (merge_paths || cloc.stream_output || cloc.sample_fraction || cloc.sample_count || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--complexity' cannot be combined with '--merge', '--stream', '--sample', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.follow_symlinks && (merge_paths || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--follow-symlinks' cannot be combined with '--merge', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cache_path && (merge_paths || cloc.stream_output || cloc.duplicate_window || cloc.sample_fraction || cloc.sample_count || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--cache' cannot be combined with '--merge', '--stream', '--duplicates', '--sample', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.count_hardware_events && (merge_paths || cloc.stream_output || cloc.duplicate_window || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--hw-counters' cannot be combined with '--merge', '--stream', '--duplicates', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && trace_path && (merge_paths || cloc.stream_output || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--trace' cannot be combined with '--merge', '--stream', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && record_path && (cloc.stream_output || cloc.sample_fraction || cloc.sample_count || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--record' cannot be combined with '--stream', '--sample', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.first_report && (cloc.stream_output || cloc.sample_fraction || cloc.sample_count || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--report' cannot be combined with '--stream', '--sample', '--diff', '--rev' or '--watch'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && (record_label || record_directories) && !record_path) {
+            printf("[ERROR]: The options '--label' and '--record-directories' require '--record'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && history_last_count && !history_path) {
+            printf("[ERROR]: The option '--last' requires '--history'.\n");
+            cloc.cli_valid = false;
+        }
+
+        // Queries don't count anything, so they don't go together with anything that does.
+        if(cloc.cli_valid && history_path && (filepaths || file_lists || compile_databases || merge_paths || record_path || cloc.first_report || partial_output_path || cloc.diff_mode || git_revisions || watch_socket_path)) {
+            printf("[ERROR]: The option '--history' cannot be combined with file paths or any other mode.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && include_depfiles && !compile_databases) {
+            printf("[ERROR]: The option '--depfiles' requires '--compile-commands'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && cloc.shard_count > 1 && (merge_paths || git_revisions)) {
+            printf("[ERROR]: The option '--shard' cannot be combined with '--merge' or '--rev'.\n");
+            cloc.cli_valid = false;
+        }
+
+        if(cloc.cli_valid && merge_paths) {
+            //
+            // Merged files were already counted by the runs that wrote the partial results, so there is
+            // nothing left to traverse. The list was built in reverse, so restore the command line order,
+            // which decides which partial wins for duplicate files.
+            //
+            if(filepaths) {
+                printf("[ERROR]: The option '--merge' cannot be combined with other file paths.\n");
+                cloc.cli_valid = false;
+            } else {
+                String_List *ordered_merge_paths = NULL;
+                for(String_List *merge_path = merge_paths; merge_path; merge_path = merge_path->next) {
+                    ordered_merge_paths = append_string_list(&cloc.scratch, ordered_merge_paths, merge_path->content);
+                }
+
+                cloc.cli_valid = merge_partial_results(&cloc, ordered_merge_paths);
+                merge_mode     = true;
+            }
+        }
+
+        if(cloc.cli_valid && cloc.diff_mode) {
+            cloc.cli_valid = register_diff_trees(&cloc, diff_old_path, diff_new_path);
+        }
+
+        if(cloc.cli_valid && git_revisions) {
+            //
+            // In git mode, the file path is the repository (defaulting to the current directory), and all
+            // revisions are read straight from its object database.
+            //
+            if(cloc.diff_mode || watch_socket_path || (filepaths && filepaths->next)) {
+                printf("[ERROR]: The option '--rev' expects at most one repository path, and cannot be combined with '--diff' or '--watch'.\n");
+                cloc.cli_valid = false;
+            } else {
+                cloc.git_repository = open_git_repository(&cloc, filepaths ? filepaths->content : ".");
+                cloc.cli_valid = cloc.git_repository != NULL;
+                filepaths = NULL;
+            }
+
+            //
+            // The revisions list was built in reverse, so restore the command line order.
+            //
+            String_List *ordered_revisions = NULL;
+            for(String_List *revision = git_revisions; revision; revision = revision->next) {
+                ordered_revisions = append_string_list(&cloc.scratch, ordered_revisions, revision->content);
+            }
+
+            for(String_List *revision = ordered_revisions; revision && cloc.cli_valid; revision = revision->next) {
+                cloc.cli_valid = register_git_revision(cloc.git_repository, revision->content);
+            }
+        }
+
+        if(cloc.cli_valid && watch_socket_path) {
+            //
+            // The watch daemon needs to be set up before the traversal, so that it can start watching
+            // the directories before we list their content.
+            //
+            cloc.watch_daemon = create_watch_daemon(&cloc, watch_socket_path);
+            if(!cloc.watch_daemon) cloc.cli_valid = false;
+        }
+
+        // The traversal itself may take a long time on slow file systems, so the reporter already runs during it.
+        if(cloc.cli_valid && cloc.show_progress) cloc.progress = start_progress_reporter(&cloc);
+        if(cloc.cli_valid && cloc.count_hardware_events) cloc.thread_counters = create_thread_counters(&cloc);
+        if(cloc.cli_valid && trace_path) cloc.trace = create_trace(trace_path);
+
         for(String_List *filepath = filepaths; filepath; filepath = filepath->next) {
             //
             // Register new files to parse
             //
             OS_Path_Kind path_kind = os_resolve_path_kind(filepath->content);
-            switch(path_kind) {
-            case OS_PATH_Is_File:
-                register_file_to_parse(&cloc, filepath->content);
-                break;
-
-            case OS_PATH_Is_Directory:
-                register_directory_to_parse(&cloc, filepath->content);
-                break;
-
-            case OS_PATH_Non_Existent:
+            if(path_kind == OS_PATH_Non_Existent) {
                 printf("[ERROR]: The file path '%s' doesn't exist.\n", filepath->content);
                 cloc.cli_valid = false;
-                break;
+            } else if(cloc.stream_output) {
+                // Streaming only starts the traversal once the workers are running.
+                stream_paths = append_string_list(&cloc.scratch, stream_paths, filepath->content);
+            } else {
+                register_path_to_parse(&cloc, filepath->content, path_kind);
             }
         }
+
+        if(cloc.cli_valid && (file_lists || compile_databases)) {
+            cloc.cli_valid = register_listed_files(&cloc, file_lists, compile_databases, include_depfiles);
+        }
+
+        if(cloc.cli_valid && cloc.stream_output && !stream_paths) {
+            printf("[ERROR]: Please specify at least one source file to cloc.\n");
+            cloc.cli_valid = false;
+        }
         
-        if(cloc.cli_valid && cloc.first_file == NULL) {
+        // Merged results and shards may legitimately be empty, since they are only a part of the whole.
+        if(cloc.cli_valid && !cloc.stream_output && cloc.first_file == NULL && cloc.first_diff_pair == NULL && cloc.git_repository == NULL && !merge_paths && !history_path && cloc.shard_count <= 1) {
             printf("[ERROR]: Please specify at least one source file to cloc.\n");
             cloc.cli_valid = false;
         }
         
 #undef EXPECT_ADDITIONAL_ARG
     }
+
+    //
+    // The sample is picked before anything is read, so that the workers only ever touch the sampled files.
+    //
+    if(cloc.cli_valid && (cloc.sample_fraction || cloc.sample_count)) cloc.sample = select_sample(&cloc, cloc.sample_fraction, cloc.sample_count);
+    if(cloc.cli_valid && !cloc.diff_mode && !merge_mode) sort_files_by_read_order(&cloc);
+    if(cloc.thread_counters) stop_thread_counters(&cloc.thread_counters[0]); // Everything up to here was discovery
     
-    if(cloc.cli_valid) {
+    if(cloc.cli_valid && history_path) {
+        cloc.cli_valid = print_history(&cloc, history_path, history_series, history_column, history_last_count);
+    } else if(cloc.cli_valid && cloc.stream_output) {
+        //
+        // Streaming prints the files while they are counted, so the table header comes first.
+        //
+        print_separator_line(&cloc, CLOC_VERSION_STRING);
+        print_table_header_line(&cloc);
+        print_separator_line(&cloc, "");
+
+        Stats sum_stats = run_stream(&cloc, stream_paths);
+
+        print_timing_line(&cloc, start, &sum_stats);
+    } else if(cloc.cli_valid) {
         //
         // Set up and spawn the thread workers
         //
         s64 cpu_cores = os_get_hardware_thread_count();
-        cloc.active_workers = cloc.no_jobs ? 1 : min(cpu_cores, cloc.file_count);
+        cloc.active_workers = cloc.no_jobs ? 1 : min(min(cpu_cores, MAX_WORKERS), cloc.file_count);
+        if(merge_mode) cloc.active_workers = 0;
         
-        for(int i = 0; i < cloc.active_workers; ++i) {
-            cloc.workers[i].cloc = &cloc;
-            cloc.workers[i].pid = os_spawn_thread((int(*)(void *)) worker_thread, &cloc.workers[i]);
+        int (*worker_procedure)(Worker *) = worker_thread;
+        if(cloc.diff_mode) worker_procedure = diff_worker_thread;
+        if(cloc.git_repository) worker_procedure = git_worker_thread;
+
+        if(cloc.duplicate_window) {
+            cloc.duplicates  = create_duplicates(&cloc, cloc.duplicate_window);
+            worker_procedure = duplicate_worker_thread;
         }
-        
+
+        if(cloc.collect_metrics) cloc.line_metrics = create_line_metrics(&cloc);
+        if(cloc.collect_complexity) cloc.code_complexity = create_code_complexity(&cloc);
+        if(cache_path) cloc.cache = load_cache(&cloc, cache_path);
+
         //
-        // Wait for all thread workers to complete
+        // A single worker, or a handful of small files like the ones that editors and commit hooks pass in, are
+        // counted right on the main thread. Spawning a thread and mapping a fresh file buffer would take longer
+        // than the counting itself, so the inline worker borrows its buffer from the scratch arena instead.
         //
+        b8 count_inline = (cloc.active_workers == 1 || (cloc.active_workers > 1 && worker_procedure == worker_thread && is_small_input(&cloc))) &&
+            cloc.scratch.reserved - cloc.scratch.committed >= INLINE_FILE_BUFFER_SIZE;
+        if(count_inline) cloc.active_workers = 1;
+
+        cloc.worker_totals = calloc(max(cloc.active_workers, 1), sizeof(Worker_Totals));
+        s64 inline_mark = mark_arena(&cloc.scratch);
+
         for(int i = 0; i < cloc.active_workers; ++i) {
-            os_join_thread(cloc.workers[i].pid);
+            if(count_inline) {
+                create_worker_with_buffer(&cloc.workers[i], &cloc, push_arena(&cloc.scratch, INLINE_FILE_BUFFER_SIZE), INLINE_FILE_BUFFER_SIZE);
+            } else {
+                create_worker(&cloc.workers[i], &cloc);
+            }
+
+            cloc.workers[i].totals = &cloc.worker_totals[i].totals;
+            if(cloc.thread_counters) cloc.workers[i].counters = &cloc.thread_counters[i + 1];
+            if(cloc.trace) cloc.workers[i].trace = &cloc.trace->buffers[i + 1];
+            if(!count_inline) cloc.workers[i].pid = os_spawn_thread((int(*)(void *)) worker_procedure, &cloc.workers[i]);
         }
+
+        if(cloc.progress) start_progress_counting(cloc.progress);
+        if(count_inline) worker_procedure(&cloc.workers[0]);
         
         //
-        // Finalize the result
+        // Wait for all thread workers to complete
         //
-        print_separator_line(&cloc, CLOC_VERSION_STRING);
-        print_table_header_line(&cloc);
-        print_separator_line(&cloc, "");
-        
-        Stats sum_stats = { 0 };
-        sum_stats.ident = "SUM:";
-
-        switch(cloc.output_mode) {
-        case OUTPUT_By_File: {
-            Stats *sorted_stats = push_arena(&cloc.scratch, cloc.file_count * sizeof(Stats));
-            memset(sorted_stats, 0, cloc.file_count * sizeof(Stats));
-
-            s64 index = 0;
-            for(File *file = cloc.first_file; file != NULL; file = file->next) {
-                combine_stats(&sum_stats, &file->stats);
-                sorted_stats[index] = file->stats;
-                ++index;
-            }
-
-            prepare_stats(&cloc, sorted_stats, cloc.file_count, true);
-            
-            for(s64 i = 0; i < cloc.file_count; ++i) {
-                print_table_entry_line(&cloc, &sorted_stats[i], false);
-            }
-        } break;
-
-        case OUTPUT_By_Language: {
-            Stats sorted_stats[LANGUAGE_COUNT];
-            memset(&sorted_stats, 0, LANGUAGE_COUNT * sizeof(Stats));
+        for(int i = 0; i < cloc.active_workers; ++i) {
+            if(!count_inline) os_join_thread(cloc.workers[i].pid);
+            combine_file_totals(&cloc.totals, &cloc.worker_totals[i].totals);
+            destroy_worker(&cloc.workers[i]);
+        }
 
-            for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
-                sorted_stats[i].ident = LANGUAGE_STRINGS[i];
-            }
+        reset_arena(&cloc.scratch, inline_mark);
 
-            for(File *file = cloc.first_file; file != NULL; file = file->next) {
-                combine_stats(&sum_stats, &file->stats);
-                combine_stats(&sorted_stats[file->language], &file->stats);
-            }
+        // Merged files were counted by other processes, so their totals are only known now.
+        if(merge_mode) {
+            for(File *file = cloc.first_file; file != NULL; file = file->next) add_file_to_totals(&cloc, &cloc.totals, file);
+        }
 
-            prepare_stats(&cloc, sorted_stats, LANGUAGE_COUNT, false);
-            
-            for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
-                if(sorted_stats[i].file_count > 0) print_table_entry_line(&cloc, &sorted_stats[i], true);
-            }
-        } break;
+        if(cloc.progress) {
+            stop_progress_reporter(cloc.progress); // Clears the status line before the tables are printed
+            cloc.progress = NULL;
         }
         
-        if(sum_stats.file_count > 1) {
-            cloc.common_prefix = NULL;
-            cloc.common_prefix_length = 0;
+        //
+        // Finalize the result
+        //
+        Stats sum_stats;
+        if(cloc.first_report) {
+            if(!run_reports(&cloc, &sum_stats)) cloc.cli_valid = false;
+        } else if(cloc.git_repository) {
+            print_separator_line(&cloc, CLOC_VERSION_STRING);
+            print_table_header_line(&cloc);
+            sum_stats = print_git_tables(&cloc); // Prints its own separator line with the name of each revision
+        } else {
+            print_separator_line(&cloc, CLOC_VERSION_STRING);
+            print_table_header_line(&cloc);
             print_separator_line(&cloc, "");
-            print_table_entry_line(&cloc, &sum_stats, cloc.output_mode != OUTPUT_By_File);
+            if(cloc.diff_mode) {
+                sum_stats = print_diff_table(&cloc);
+            } else if(cloc.sample) {
+                sum_stats = print_sample_tables(&cloc); // Returns what was actually counted, for the timing line
+            } else {
+                sum_stats = print_stats_table(&cloc);
+            }
         }
 
-        Hardware_Time end = os_get_hardware_time();
-        f64 seconds   = os_convert_hardware_time_to_seconds(end - start);
-        f64 lps       = (sum_stats.blank + sum_stats.comment + sum_stats.code) / seconds;
-        f64 megabytes = os_get_working_set_size() / 1000000;
-        print_separator_line(&cloc, aprint(&cloc.scratch, "%.2fs // %" PRId64 " l/s // %.1fmb", seconds, (s64) lps, megabytes));
+        if(cloc.line_metrics) print_metrics_tables(&cloc);
+        if(cloc.code_complexity) print_complexity_table(&cloc);
+        if(cloc.duplicates) print_duplicates_report(&cloc);
+        if(cloc.thread_counters) print_counter_tables(&cloc);
+
+        // Machine readable reports on the standard output shouldn't end in a line that their readers don't expect.
+        if(!reports_write_data_to_standard_output(&cloc)) print_timing_line(&cloc, start, &sum_stats);
+
+        if(partial_output_path && !write_partial_results(&cloc, partial_output_path)) cloc.cli_valid = false;
+        if(cloc.cache && !write_cache(&cloc, cloc.cache)) cloc.cli_valid = false;
+        if(cloc.trace && !write_trace(&cloc, cloc.trace)) cloc.cli_valid = false;
+        if(record_path && !record_history(&cloc, record_path, record_label, record_directories)) cloc.cli_valid = false;
+        if(cloc.watch_daemon) run_watch_daemon(cloc.watch_daemon);
     }
 
+    if(cloc.progress) stop_progress_reporter(cloc.progress);
+    if(cloc.watch_daemon) destroy_watch_daemon(cloc.watch_daemon);
+    if(cloc.git_repository) close_git_repository(cloc.git_repository);
+    if(cloc.duplicates) destroy_duplicates(cloc.duplicates);
+    if(cloc.sample) destroy_sample(cloc.sample);
+    if(cloc.cache) destroy_cache(cloc.cache);
+    if(cloc.trace) destroy_trace(cloc.trace);
+    if(cloc.first_report) destroy_reports(&cloc);
+    free(cloc.visited_identities.entries);
+    free(cloc.worker_totals);
+    free(cloc.line_metrics);
+    free(cloc.code_complexity);
+    free(cloc.thread_counters);
+
     destroy_arena(&cloc.perm);
     destroy_arena(&cloc.scratch);
     
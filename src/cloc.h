@@ -2,6 +2,10 @@
 #define OUTPUT_LINE_WIDTH 80
 #define CLOC_VERSION_STRING "cloc v0.1"
 
+#define PERM_ARENA_SIZE    (16LL * 1024 * 1024 * 1024)
+#define SCRATCH_ARENA_SIZE (4LL * 1024 * 1024 * 1024)
+#define ARENA_COMMIT_SIZE  (64 * 1024)
+
 #define USE_CAS true // IF THIS IS FALSE, WE ARE NOT THREAD-SAFE!
 
 #define FILE_COUNT_COLUMN_OFFSET    30
@@ -9,10 +13,16 @@
 #define COMMENT_LINES_COLUMN_OFFSET 65
 #define CODE_LINES_COLUMN_OFFSET    80
 
+//
+// Arenas only reserve their address range up front, and back it with memory as they grow. The reservation
+// can therefore be generous for arenas which grow with the input, like the permanent one holding every file
+// and directory.
+//
 typedef struct Arena {
     char *base;
     s64 reserved;
     s64 committed;
+    s64 backed;
 } Arena;
 
 void create_arena(Arena *arena, s64 reserved);
@@ -28,6 +38,10 @@ typedef struct String_Builder {
     s64 size_in_characters;
 } String_Builder;
 
+#define aprint(arena, format, ...) push_arena(arena, sprintf((arena)->base + (arena)->committed, format, ##__VA_ARGS__) + 1)
+#define sprint(builder, format, ...) push_string_builder(builder, sprintf((builder)->arena->base + (builder)->arena->committed, format, ##__VA_ARGS__))
+
+char *push_string_builder(String_Builder *builder, s64 characters);
 void create_string_builder(String_Builder *builder, Arena *arena);
 void append_string(String_Builder *builder, const char *data);
 void append_string_with_max_length(String_Builder *builder, const char *data, s64 max_length);
@@ -47,6 +61,29 @@ typedef struct String_List {
 String_List *append_string_list(Arena *arena, String_List *previous, char *content);
 b8 string_list_contains(String_List *list, char *needle);
 
+typedef struct String_Table_Entry {
+    u64 hash;
+    const char *key;
+    void *value;
+} String_Table_Entry;
+
+// Open-addressing hash table from strings to arbitrary pointers. The table does not copy the keys, so
+// they must outlive the table.
+typedef struct String_Table {
+    String_Table_Entry *entries;
+    s64 count;
+    s64 capacity; // Always a power of two
+} String_Table;
+
+#define STRING_HASH_SEED 0xcbf29ce484222325
+
+u64 hash_string(const char *string);
+u64 extend_string_hash(u64 hash, const char *string);
+void create_string_table(String_Table *table, s64 initial_capacity);
+void destroy_string_table(String_Table *table);
+void *string_table_query(String_Table *table, const char *key);
+void string_table_insert(String_Table *table, const char *key, void *value);
+
 typedef enum Language {
     LANGUAGE_C,
     LANGUAGE_C_Header,
@@ -62,6 +99,14 @@ typedef enum Output_Mode {
     OUTPUT_By_Language,
 } Output_Mode;
 
+// The order in which files are handed to the workers. On cold caches, reading files by inode or by their
+// position on disk turns random reads into mostly sequential ones.
+typedef enum Read_Order {
+    READ_ORDER_Traversal,
+    READ_ORDER_Inode,
+    READ_ORDER_Extent,
+} Read_Order;
+
 typedef struct Stats {
     const char *ident;
     s64 blank;
@@ -70,13 +115,110 @@ typedef struct Stats {
     s64 file_count;
 } Stats;
 
+#define LINE_LENGTH_BUCKET_COUNT 4 // Lines below 80, 100 and 120 characters, and all longer ones
+
+// Extends the Stats of a file or language with '--metrics'. Lengths are in bytes, without the line break, while
+// the bytes per category include it.
+typedef struct Line_Metrics {
+    s64 max_line_length;
+    s64 total_line_length; // For the average over all lines
+    s64 line_length_histogram[LINE_LENGTH_BUCKET_COUNT];
+    s64 trailing_whitespace_lines;
+    s64 tab_indented_lines;
+    s64 blank_bytes;
+    s64 comment_bytes;
+    s64 code_bytes;
+} Line_Metrics;
+
+// Extends the Stats of a file or language with '--complexity'. The cyclomatic complexity of a function is its
+// branches plus one, so the complexity of a file or language is its branches plus its functions.
+typedef struct Code_Complexity {
+    s64 functions;
+    s64 branches;                // Branch and loop keywords, '&&', '||' and '?'
+    s64 max_function_complexity;
+    s64 max_nesting_depth;       // Of the braces in a function, whose body is at depth 1
+} Code_Complexity;
+
+// Counts the lines of a file's content that is already in memory.
+void count_buffer(Stats *stats, Language language, char *data, s64 size);
+
+// Files are classified when their first block is read. Only source files are part of the regular tables,
+// binary files are always dropped, and generated files are only counted on request. Files of unknown
+// languages are only counted with '--lines-only', by their physical lines.
+typedef enum File_Status {
+    FILE_Source,
+    FILE_Binary,
+    FILE_Generated,
+    FILE_Raw,
+    FILE_STATUS_COUNT,
+} File_Status;
+
+// Paths are interned into a trie of directories during the traversal, so that every file only stores its own
+// name and the directory it lives in. Full paths are only put together when they are actually needed.
+typedef struct Directory_Node {
+    struct Directory_Node *parent; // NULL for the root of the trie, which has no name
+    struct Directory_Node *first_child;
+    struct Directory_Node *next_sibling;
+    char *name;
+    s64 path_length; // Length of the full path including the trailing separator
+    s64 depth;
+    s64 partial_index; // Only used while writing partial results
+} Directory_Node;
+
+#define FILE_IDENTITY_SET_INITIAL_CAPACITY 1024
+
+// With '--follow-symlinks', the same file or directory may be reachable through many paths. Everything that was
+// visited is remembered by its identity on disk, so that nothing is listed or counted twice.
+typedef struct File_Identity {
+    u64 device;
+    u64 inode; // 0 for empty slots
+} File_Identity;
+
+typedef struct File_Identity_Set {
+    File_Identity *entries;
+    s64 count;
+    s64 capacity; // Always a power of two
+} File_Identity_Set;
+
 typedef struct File {
     struct File *next;
-    char *file_path;
-    Language language;
-    Stats stats;
+    Directory_Node *directory;
+    char *name;
+    Language language; // LANGUAGE_COUNT for files that are only counted by their physical lines
+    File_Status status;
+    u32 index;         // In the order of registration, for the side tables of '--metrics', '--complexity' and '--cache'
+    u64 read_position; // The inode from the directory listing, 0 if unknown. '--read-order extent' replaces it with the physical offset
+    s64 bytes;         // Set once the file was read
+    Stats stats;       // For raw files, the physical lines are counted as code
 } File;
 
+// Running totals over all counted files. The workers fill their own while they count, so that the language
+// tables only need to add up one of these per worker in the end, instead of walking all files again.
+typedef struct File_Totals {
+    s64 status_counts[FILE_STATUS_COUNT];
+    Stats language_stats[FILE_STATUS_COUNT][LANGUAGE_COUNT]; // Raw files are only counted by their status
+    Line_Metrics language_metrics[FILE_STATUS_COUNT][LANGUAGE_COUNT];
+    Code_Complexity language_complexity[FILE_STATUS_COUNT][LANGUAGE_COUNT];
+} File_Totals;
+
+// Padded, so that no two workers ever write to the same cache line.
+typedef struct Worker_Totals {
+    File_Totals totals;
+    u8 padding[CACHE_LINE_SIZE];
+} Worker_Totals;
+
+//
+// The counted files with a known language and their paths relative to the deepest directory containing all of
+// them, for the per-file tables of the additional passes. The paths live in their own arena, which is sized
+// for them up front.
+//
+typedef struct Counted_Files {
+    Arena arena;
+    File **files;
+    char **paths;
+    s64 count;
+} Counted_Files;
+
 typedef struct Cloc {
     Arena perm;
     Arena scratch;
@@ -84,22 +226,116 @@ typedef struct Cloc {
     // --- CLI Options
     b8 cli_valid;
     b8 no_jobs;
+    b8 report_generated; // Generated files get a table of their own...
+    b8 skip_generated;   // ...or are dropped like binary files, by default they are just counted as sources
+    b8 stream_output;
+    b8 lines_only; // Also count files of unknown languages, by their physical lines only
+    b8 show_progress;
+    b8 follow_symlinks;
+    b8 collect_metrics;
+    b8 collect_complexity;
+    b8 count_hardware_events;
     Output_Mode output_mode;
+    Read_Order read_order;
     String_List *excluded_directories;
+    s64 shard_index; // Zero based, only files whose relative path hashes into this shard are registered
+    s64 shard_count;
+    s64 duplicate_window; // In code lines, 0 unless looking for duplicated code with '--duplicates'
+    f64 sample_fraction;  // Only one of these is set when sampling with '--sample'
+    s64 sample_count;
     
     // --- Files
+    Directory_Node root_directory;
     File *first_file;
     File *next_file;
     s64 file_count;
+    File_Identity_Set visited_identities; // Only filled when following symlinks
 
     // Over all outputted line table entries, we find the common prefix that we can then omit in the output table.
-    // This avoids having very long paths when all the files are in the same directory.
+    // This avoids having very long paths when all the files are in the same directory. Files from the directory
+    // trie don't need this, their idents are already built relative to their common directory.
     const char *common_prefix;
     s64 common_prefix_length;
 
     // --- Content
     Worker workers[MAX_WORKERS];
+    Worker_Totals *worker_totals; // One per active worker, allocated once their number is known
     s64 active_workers;
+    File_Totals totals; // Of all files once the workers are done, not filled in diff, git or sampling mode
+
+    // --- Diff Mode
+    b8 diff_mode;
+    struct Diff_Pair *first_diff_pair;
+    struct Diff_Pair *next_diff_pair;
+    s64 diff_pair_count;
+
+    // --- Git Mode
+    struct Git_Repository *git_repository; // Only set when running with '--rev'
+
+    // --- Watch Mode
+    struct Watch_Daemon *watch_daemon; // Only set when running with '--watch'
+    struct Stream *stream;             // Only set while streaming results with '--stream'
+
+    // --- Duplicates Mode
+    struct Duplicates *duplicates; // Only set when running with '--duplicates'
+
+    // --- Sampling Mode
+    struct Sample *sample; // Only set when running with '--sample'
+
+    // --- Metrics
+    Line_Metrics *line_metrics; // Indexed by File.index, only set when running with '--metrics'
+    Code_Complexity *code_complexity; // Indexed by File.index, only set when running with '--complexity'
+
+    // --- Incremental Counting
+    struct Cache *cache; // Only set when running with '--cache'
+
+    // --- Performance Counters
+    struct Thread_Counters *thread_counters; // The main thread's, then one per worker, only set with '--hw-counters'
+
+    // --- Tracing
+    struct Trace *trace; // Only set when running with '--trace'
+
+    // --- Reports
+    struct Report *first_report; // Only set with '--report', in the order of the command line
+
+    // --- Progress Reporting
+    struct Progress *progress; // Only set while reporting with '--progress'
 } Cloc;
 
 File *get_next_file_to_parse(Cloc *cloc);
+void combine_stats(Stats *dst, Stats *src);
+void combine_line_metrics(Line_Metrics *dst, Line_Metrics *src);
+void combine_code_complexity(Code_Complexity *dst, Code_Complexity *src);
+Line_Metrics *get_file_metrics(Cloc *cloc, File *file);
+Code_Complexity *get_file_complexity(Cloc *cloc, File *file);
+void add_file_to_totals(Cloc *cloc, File_Totals *totals, File *file);
+void combine_file_totals(File_Totals *dst, File_Totals *src);
+Language get_language_for_file_path(char *file_path);
+char *combine_file_paths(Cloc *cloc, char *directory_path, char *file_path);
+Directory_Node *get_or_create_child_directory(Arena *arena, Directory_Node *parent, char *name, s64 name_length);
+Directory_Node *intern_directory_path(Arena *arena, Directory_Node *root, char *directory_path);
+Directory_Node *find_common_directory(Directory_Node *lhs, Directory_Node *rhs);
+char *get_directory_path(Arena *arena, Directory_Node *directory);
+s64 get_file_path_length(File *file, Directory_Node *root);
+void write_file_path(char *buffer, File *file, Directory_Node *root);
+char *get_file_path(Arena *arena, File *file, Directory_Node *root);
+void collect_counted_files(Cloc *cloc, Counted_Files *counted);
+void destroy_counted_files(Counted_Files *counted);
+Directory_Node *intern_file_directory(Cloc *cloc, char *file_path, char **name);
+Directory_Node *intern_resolved_file_directory(Cloc *cloc, char *resolved_path, char **name);
+b8 is_in_shard(Cloc *cloc, u64 path_hash);
+File *register_file_to_parse(Cloc *cloc, Directory_Node *directory, char *name, u64 read_position);
+File *register_file_path_to_parse(Cloc *cloc, char *file_path);
+void register_directory_to_parse(Cloc *cloc, char *directory_path);
+void register_path_to_parse(Cloc *cloc, char *path, OS_Path_Kind kind);
+void sort_files_by_read_order(Cloc *cloc);
+
+void append_separator_line(String_Builder *builder, const char *content);
+void append_table_header(String_Builder *builder, const char *ident_header, b8 is_language_entries);
+void append_table_entry(String_Builder *builder, const char *ident, Stats *stats, b8 is_language_entries);
+void print_separator_line(Cloc *cloc, const char *content);
+void print_table_entry_line(Cloc *cloc, Stats *stats, b8 is_language_entries);
+Stats print_file_stats_table(Cloc *cloc, Stats *file_stats, s64 file_count, b8 set_common_prefix);
+Stats print_language_stats_table(Cloc *cloc, Stats language_stats[LANGUAGE_COUNT]);
+void print_skipped_files_line(Cloc *cloc, s64 status_counts[FILE_STATUS_COUNT]);
+Stats print_stats_table(Cloc *cloc);
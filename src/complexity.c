@@ -0,0 +1,107 @@
+/* -------------------------------------------------- Setup -------------------------------------------------- */
+
+Code_Complexity *create_code_complexity(Cloc *cloc) {
+    Code_Complexity *complexity = malloc(max(cloc->file_count, 1) * sizeof(Code_Complexity));
+    memset(complexity, 0, max(cloc->file_count, 1) * sizeof(Code_Complexity));
+    return complexity;
+}
+
+
+
+/* ------------------------------------------------- Output ------------------------------------------------- */
+
+static
+int compare_complexity_rows(const void *lhs, const void *rhs) {
+    const Complexity_Row *a = lhs, *b = rhs;
+    s64 a_complexity = a->complexity.functions + a->complexity.branches;
+    s64 b_complexity = b->complexity.functions + b->complexity.branches;
+    if(a_complexity != b_complexity) return a_complexity > b_complexity ? -1 : 1;
+    return strcmp(a->ident, b->ident);
+}
+
+static
+void print_complexity_entry_line(Cloc *cloc, Complexity_Row *row) {
+    Code_Complexity *complexity = &row->complexity;
+    s64 mark = mark_arena(&cloc->scratch);
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string_with_max_length(&builder, row->ident, FILE_COUNT_COLUMN_OFFSET - 3);
+    append_right_justified_integer_at_offset(&builder, complexity->functions,                        ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(&builder, complexity->functions + complexity->branches, ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(&builder, complexity->max_function_complexity,          ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(&builder, complexity->max_nesting_depth,                ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+    reset_arena(&cloc->scratch, mark);
+}
+
+static
+void print_complexity_rows(Cloc *cloc, Complexity_Row *rows, s64 row_count) {
+    Complexity_Row sum = { "SUM:", { 0 } };
+
+    qsort(rows, row_count, sizeof(Complexity_Row), compare_complexity_rows);
+    for(s64 i = 0; i < row_count; ++i) combine_code_complexity(&sum.complexity, &rows[i].complexity);
+
+    print_separator_line(cloc, "Complexity");
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string(&builder, cloc->output_mode == OUTPUT_By_File ? "File" : "Language");
+    append_right_justified_string_at_offset(&builder, "Functions",    ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Complexity",   ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Max function", ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Max depth",    ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+    print_separator_line(cloc, "");
+
+    for(s64 i = 0; i < row_count; ++i) print_complexity_entry_line(cloc, &rows[i]);
+
+    if(row_count > 1) {
+        print_separator_line(cloc, "");
+        print_complexity_entry_line(cloc, &sum);
+    }
+}
+
+void print_complexity_table(Cloc *cloc) {
+    //
+    // Like the metrics, one row per language or per counted file, including generated files only if they
+    // were reported.
+    //
+    Complexity_Row *rows = NULL;
+    s64 row_count = 0;
+    Counted_Files counted = { 0 };
+
+    switch(cloc->output_mode) {
+    case OUTPUT_By_File: {
+        collect_counted_files(cloc, &counted);
+        rows = malloc(max(counted.count, 1) * sizeof(Complexity_Row));
+        for(s64 i = 0; i < counted.count; ++i) {
+            Complexity_Row *row = &rows[row_count++];
+            row->ident      = counted.paths[i];
+            row->complexity = *get_file_complexity(cloc, counted.files[i]);
+        }
+    } break;
+
+    case OUTPUT_By_Language: {
+        rows = malloc(LANGUAGE_COUNT * sizeof(Complexity_Row));
+        for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+            s64 file_count = cloc->totals.language_stats[FILE_Source][i].file_count;
+            Code_Complexity complexity = cloc->totals.language_complexity[FILE_Source][i];
+            if(cloc->report_generated) {
+                file_count += cloc->totals.language_stats[FILE_Generated][i].file_count;
+                combine_code_complexity(&complexity, &cloc->totals.language_complexity[FILE_Generated][i]);
+            }
+
+            if(file_count == 0) continue;
+            Complexity_Row *row = &rows[row_count++];
+            row->ident      = LANGUAGE_STRINGS[i];
+            row->complexity = complexity;
+        }
+    } break;
+    }
+
+    if(row_count) print_complexity_rows(cloc, rows, row_count);
+
+    free(rows);
+    destroy_counted_files(&counted);
+}
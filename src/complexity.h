@@ -0,0 +1,17 @@
+struct Cloc;
+
+//
+// With '--complexity', a small token scanner runs over the code characters of every file while the lines are
+// classified, counting function definitions, branches and the nesting of braces. It doesn't really parse
+// anything: a block right after a parameter list is a function body, and every branch or loop keyword, '&&',
+// '||' and '?' adds one to the cyclomatic complexity. That is close enough for quality gates, without running
+// a compiler front end over the whole tree.
+//
+
+typedef struct Complexity_Row {
+    const char *ident;
+    Code_Complexity complexity;
+} Complexity_Row;
+
+Code_Complexity *create_code_complexity(struct Cloc *cloc);
+void print_complexity_table(struct Cloc *cloc);
@@ -0,0 +1,160 @@
+/* ------------------------------------------------- Counting ------------------------------------------------- */
+
+Thread_Counters *create_thread_counters(Cloc *cloc) {
+    (void) cloc; // Like the other create procedures, even though the counters don't need anything from it yet
+    Thread_Counters *counters = malloc((MAX_WORKERS + 1) * sizeof(Thread_Counters));
+    memset(counters, 0, (MAX_WORKERS + 1) * sizeof(Thread_Counters));
+    for(s64 i = 0; i < MAX_WORKERS + 1; ++i) {
+        for(s64 j = 0; j < OS_COUNTER_COUNT; ++j) counters[i].os.handles[j] = -1;
+    }
+
+    //
+    // The main thread opens its counters first. If that fails, perf events are not permitted (or not
+    // supported) at all, and the run just continues without them.
+    //
+    if(!start_thread_counters(&counters[0], COUNTER_PHASE_Discovery)) {
+        printf("[WARNING]: Performance counters are not available on this system (check perf_event_paranoid), ignoring '--hw-counters'.\n");
+        free(counters);
+        return NULL;
+    }
+
+    if(counters[0].os.available == (1 << OS_COUNTER_Cpu_Time)) {
+        printf("[WARNING]: The hardware events are not available on this system, only counting the CPU time.\n");
+    }
+
+    return counters;
+}
+
+b8 start_thread_counters(Thread_Counters *counters, Counter_Phase phase) {
+    if(!os_open_hardware_counters(&counters->os)) return false;
+
+    counters->phase = phase;
+    os_read_hardware_counters(&counters->os, counters->phase_start);
+    return true;
+}
+
+void switch_counter_phase(Thread_Counters *counters, Counter_Phase phase) {
+    if(phase == counters->phase || !counters->os.available) return;
+
+    u64 now[OS_COUNTER_COUNT];
+    os_read_hardware_counters(&counters->os, now);
+    for(s64 i = 0; i < OS_COUNTER_COUNT; ++i) {
+        counters->phases[counters->phase][i] += now[i] - counters->phase_start[i];
+        counters->phase_start[i] = now[i];
+    }
+
+    counters->phase = phase;
+}
+
+void stop_thread_counters(Thread_Counters *counters) {
+    switch_counter_phase(counters, COUNTER_PHASE_None);
+
+    // Remember what was available for the output, after the counters themselves are gone.
+    u32 available = counters->os.available;
+    os_close_hardware_counters(&counters->os);
+    counters->os.available = available;
+}
+
+
+
+/* ------------------------------------------------- Output ------------------------------------------------- */
+
+static
+void print_counter_header_line(Cloc *cloc, const char *columns[4]) {
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string(&builder, "Phase");
+    append_right_justified_string_at_offset(&builder, columns[0], ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, columns[1], ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, columns[2], ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, columns[3], ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+    print_separator_line(cloc, "");
+}
+
+static
+void print_counter_entry_line(Cloc *cloc, Counter_Row *row, u32 available, s64 table) {
+    const s64 OFFSETS[4] = { FILE_COUNT_COLUMN_OFFSET, EMPTY_LINES_COLUMN_OFFSET, COMMENT_LINES_COLUMN_OFFSET, CODE_LINES_COLUMN_OFFSET };
+
+    // The figures are formatted before the builder claims the rest of the scratch arena.
+    char *values[4];
+    if(table == 0) {
+        values[0] = aprint(&cloc->scratch, "%" PRId64, row->files);
+        values[1] = aprint(&cloc->scratch, "%" PRId64, row->bytes);
+        values[2] = aprint(&cloc->scratch, "%" PRId64, row->lines);
+        values[3] = aprint(&cloc->scratch, "%.1f", row->values[OS_COUNTER_Cpu_Time] / 1e6);
+    } else {
+        s64 divisor = table == 1 ? row->bytes : row->lines;
+        for(s64 i = 0; i < 4; ++i) {
+            OS_Hardware_Counter counter = (OS_Hardware_Counter) (OS_COUNTER_Cycles + i);
+            values[i] = "n/a";
+            if((available & (1 << counter)) && divisor > 0) values[i] = aprint(&cloc->scratch, "%.3f", (f64) row->values[counter] / divisor);
+        }
+    }
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string_with_max_length(&builder, row->ident, FILE_COUNT_COLUMN_OFFSET - 3);
+    for(s64 i = 0; i < 4; ++i) append_right_justified_string_at_offset(&builder, values[i], ' ', OFFSETS[i]);
+    print_string_builder_as_line(&builder);
+}
+
+void print_counter_tables(Cloc *cloc) {
+    Thread_Counters *counters = cloc->thread_counters;
+
+    //
+    // Every worker gets a row for reading and one for parsing, normalized by what that worker counted. The
+    // discovery is normalized by everything that was counted, since that is what it found.
+    //
+    s64 row_count = 1 + cloc->active_workers * 2;
+    Counter_Row *rows = push_arena(&cloc->scratch, row_count * sizeof(Counter_Row));
+    u64 sum_values[2][OS_COUNTER_COUNT] = { { 0 } };
+    Counter_Row sums[2] = { { "Read", 0, 0, 0, sum_values[0] }, { "Parse", 0, 0, 0, sum_values[1] } };
+
+    u32 available = counters[0].os.available;
+
+    for(s64 i = 0; i < cloc->active_workers; ++i) {
+        Thread_Counters *worker_counters = &counters[i + 1];
+        Worker_Progress *progress = &cloc->workers[i].progress;
+        available &= worker_counters->os.available;
+
+        for(s64 j = 0; j < 2; ++j) {
+            Counter_Row *row = &rows[1 + i * 2 + j];
+            row->ident  = aprint(&cloc->scratch, "Worker %" PRId64 " %s", i + 1, j == 0 ? "read" : "parse");
+            row->files  = progress->files_done;
+            row->bytes  = progress->bytes_done;
+            row->lines  = progress->lines_done;
+            row->values = worker_counters->phases[j == 0 ? COUNTER_PHASE_Read : COUNTER_PHASE_Parse];
+
+            sums[j].files += row->files;
+            sums[j].bytes += row->bytes;
+            sums[j].lines += row->lines;
+            for(s64 k = 0; k < OS_COUNTER_COUNT; ++k) sums[j].values[k] += row->values[k];
+        }
+    }
+
+    rows[0] = (Counter_Row) { "Discovery", sums[0].files, sums[0].bytes, sums[0].lines, counters[0].phases[COUNTER_PHASE_Discovery] };
+
+    const char *TABLE_NAMES[3] = { "Performance counters", "Per byte", "Per line" };
+    const char *TABLE_COLUMNS[3][4] = {
+        { "Files",  "Bytes",        "Lines",         "CPU ms" },
+        { "Cycles", "Instructions", "Branch misses", "Cache misses" },
+        { "Cycles", "Instructions", "Branch misses", "Cache misses" },
+    };
+
+    // Without any hardware events, the normalized tables would be nothing but 'n/a'.
+    s64 table_count = (available & ~(1 << OS_COUNTER_Cpu_Time)) ? 3 : 1;
+
+    for(s64 table = 0; table < table_count; ++table) {
+        print_separator_line(cloc, TABLE_NAMES[table]);
+        print_counter_header_line(cloc, TABLE_COLUMNS[table]);
+
+        for(s64 i = 0; i < row_count; ++i) print_counter_entry_line(cloc, &rows[i], available, table);
+
+        if(cloc->active_workers > 1) {
+            print_separator_line(cloc, "");
+            print_counter_entry_line(cloc, &sums[0], available, table);
+            print_counter_entry_line(cloc, &sums[1], available, table);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+struct Cloc;
+
+//
+// With '--hw-counters', every thread reads its own performance counters whenever it switches between the
+// phases of the run, and attributes the difference to the phase it is leaving. The main thread only ever
+// discovers files. The workers read while they dequeue, open and read a file, and parse while they classify
+// its lines. Reading the counters costs a system call, so this is only meant for tuning, not for normal runs.
+//
+
+typedef enum Counter_Phase {
+    COUNTER_PHASE_None,
+    COUNTER_PHASE_Discovery,
+    COUNTER_PHASE_Read,
+    COUNTER_PHASE_Parse,
+    COUNTER_PHASE_COUNT,
+} Counter_Phase;
+
+// Only ever touched by the thread that owns it, until that thread is done.
+typedef struct Thread_Counters {
+    OS_Hardware_Counters os;
+    Counter_Phase phase;
+    u64 phase_start[OS_COUNTER_COUNT];
+    u64 phases[COUNTER_PHASE_COUNT][OS_COUNTER_COUNT];
+    u8 padding[CACHE_LINE_SIZE];
+} Thread_Counters;
+
+typedef struct Counter_Row {
+    const char *ident;
+    s64 files;
+    s64 bytes;
+    s64 lines;
+    u64 *values;
+} Counter_Row;
+
+Thread_Counters *create_thread_counters(struct Cloc *cloc); // One for the main thread, and one per worker
+b8 start_thread_counters(Thread_Counters *counters, Counter_Phase phase);
+void switch_counter_phase(Thread_Counters *counters, Counter_Phase phase);
+void stop_thread_counters(Thread_Counters *counters);
+void print_counter_tables(struct Cloc *cloc);
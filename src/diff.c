@@ -0,0 +1,524 @@
+/*
+ * The diff mode counts the lines that are the same, modified, added or removed between two trees, split by
+ * blank, comment and code lines. Files are paired by their path relative to the tree root. Identical files
+ * are detected by their size and content without a line diff, and only the files that actually differ are
+ * diffed line by line (using Myers' algorithm over line hashes).
+ */
+
+typedef struct Diff_Line {
+    u64 hash;
+    Line_Result category;
+    b8 matched; // Set if this line is part of the longest common subsequence of both files
+} Diff_Line;
+
+typedef struct Diff_Lines {
+    Diff_Line *lines;
+    s64 count;
+    s64 capacity;
+} Diff_Lines;
+
+typedef struct Diff_Buffer {
+    char *data;
+    s64 size;
+    s64 capacity;
+} Diff_Buffer;
+
+// Every diff worker has one of these to avoid reallocating all buffers for every pair.
+typedef struct Diff_Context {
+    Diff_Buffer old_content;
+    Diff_Buffer new_content;
+    Diff_Lines old_lines;
+    Diff_Lines new_lines;
+    s64 *v;
+    s64 v_capacity;
+} Diff_Context;
+
+/* ---------------------------------------------- Line Handling ---------------------------------------------- */
+
+static
+b8 read_entire_file(Diff_Buffer *buffer, char *file_path) {
+    File_Handle handle = os_open_file(file_path);
+    s64 file_size = os_get_file_size(handle);
+
+    if(file_size > buffer->capacity) {
+        free(buffer->data);
+        buffer->capacity = file_size;
+        buffer->data     = malloc(buffer->capacity);
+    }
+
+    buffer->size = 0;
+    while(buffer->size < file_size) {
+        s64 read = os_read_file(handle, &buffer->data[buffer->size], buffer->size, min(FILE_BUFFER_SIZE, file_size - buffer->size));
+        if(read <= 0) break;
+        buffer->size += read;
+    }
+
+    os_close_file(handle);
+    return buffer->size == file_size;
+}
+
+static
+void narrow_diff_buffer(Diff_Buffer *buffer) {
+    //
+    // Lines are classified and hashed on the same text that the regular counting sees: Without a byte order
+    // mark, and with UTF-16 narrowed to one byte per code unit. Narrowing works in place, since every code
+    // unit is only written to an offset that was already read.
+    //
+    s64 bom_size;
+    Text_Encoding encoding = detect_text_encoding(buffer->data, buffer->size, &bom_size);
+
+    if(encoding == TEXT_ENCODING_Bytes) {
+        if(bom_size) memmove(buffer->data, &buffer->data[bom_size], buffer->size - bom_size);
+        buffer->size -= bom_size;
+    } else {
+        buffer->size = (buffer->size - bom_size) / 2;
+        narrow_utf16(buffer->data, &buffer->data[bom_size], buffer->size, encoding);
+    }
+}
+
+static
+void push_diff_line(Diff_Lines *lines, u64 hash, Line_Result category) {
+    if(lines->count == lines->capacity) {
+        lines->capacity = max(lines->capacity * 2, 1024);
+        lines->lines    = realloc(lines->lines, lines->capacity * sizeof(Diff_Line));
+    }
+
+    Diff_Line *line = &lines->lines[lines->count];
+    line->hash      = hash;
+    line->category  = category;
+    line->matched   = false;
+    ++lines->count;
+}
+
+static
+void classify_diff_lines(Diff_Lines *lines, Language language, Diff_Buffer *buffer) {
+    //
+    // Classify every line like the regular worker does, but also remember a hash of each line's content
+    // so that we can diff them afterwards.
+    //
+    Parser parser = get_parser_for_language(language);
+    parser.reset(parser.user_data);
+
+    lines->count = 0;
+    u64 hash = STRING_HASH_SEED;
+
+    for(s64 i = 0; i < buffer->size; ++i) {
+        char character = buffer->data[i];
+
+        switch(character) {
+        case '\r': break; // Ignore
+        case '\n':
+            push_diff_line(lines, hash, parser.finish_line(parser.user_data));
+            hash = STRING_HASH_SEED;
+            break;
+        default:
+            parser.eat_character(parser.user_data, character);
+            hash = (hash ^ (u8) character) * 0x100000001b3;
+            break;
+        }
+    }
+
+    if(buffer->size > 0 && buffer->data[buffer->size - 1] != '\n') push_diff_line(lines, hash, parser.finish_line(parser.user_data));
+}
+
+static inline
+void add_line_to_stats(Stats *stats, Line_Result category) {
+    switch(category) {
+    case LINE_RESULT_Blank:   ++stats->blank; break;
+    case LINE_RESULT_Comment: ++stats->comment; break;
+    case LINE_RESULT_Code:    ++stats->code; break;
+    }
+}
+
+
+
+/* ------------------------------------------------- Myers ------------------------------------------------- */
+
+static
+b8 bisect_diff_lines(Diff_Context *context, Diff_Line *a, s64 n, Diff_Line *b, s64 m, s64 *split_a, s64 *split_b) {
+    //
+    // Walk the edit graph from the front and from the back at the same time until both paths overlap.
+    // The overlap is a point on an optimal edit path, so both halves can then be diffed independently.
+    // This keeps the memory linear in the number of lines.
+    //
+    s64 max_d    = (n + m + 1) / 2;
+    s64 v_offset = max_d;
+    s64 v_length = 2 * max_d + 2;
+
+    if(context->v_capacity < 2 * v_length) {
+        free(context->v);
+        context->v_capacity = 2 * v_length;
+        context->v = malloc(context->v_capacity * sizeof(s64));
+    }
+
+    s64 *v1 = context->v;
+    s64 *v2 = context->v + v_length;
+    for(s64 i = 0; i < v_length; ++i) v1[i] = v2[i] = -1;
+    v1[v_offset + 1] = 0;
+    v2[v_offset + 1] = 0;
+
+    s64 delta = n - m;
+    b8 front  = (delta % 2) != 0; // If the delta is odd, the forward path will collide with the reverse path
+    s64 k1_start = 0, k1_end = 0, k2_start = 0, k2_end = 0;
+
+    for(s64 d = 0; d < max_d; ++d) {
+        for(s64 k1 = -d + k1_start; k1 <= d - k1_end; k1 += 2) {
+            s64 k1_offset = v_offset + k1;
+            s64 x1 = (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1])) ? v1[k1_offset + 1] : v1[k1_offset - 1] + 1;
+            s64 y1 = x1 - k1;
+            while(x1 < n && y1 < m && a[x1].hash == b[y1].hash) { ++x1; ++y1; }
+            v1[k1_offset] = x1;
+
+            if(x1 > n) {
+                k1_end += 2; // Ran off the right of the graph
+            } else if(y1 > m) {
+                k1_start += 2; // Ran off the bottom of the graph
+            } else if(front) {
+                s64 k2_offset = v_offset + delta - k1;
+                if(k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1 && x1 >= n - v2[k2_offset]) {
+                    *split_a = x1;
+                    *split_b = y1;
+                    return true;
+                }
+            }
+        }
+
+        for(s64 k2 = -d + k2_start; k2 <= d - k2_end; k2 += 2) {
+            s64 k2_offset = v_offset + k2;
+            s64 x2 = (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1])) ? v2[k2_offset + 1] : v2[k2_offset - 1] + 1;
+            s64 y2 = x2 - k2;
+            while(x2 < n && y2 < m && a[n - x2 - 1].hash == b[m - y2 - 1].hash) { ++x2; ++y2; }
+            v2[k2_offset] = x2;
+
+            if(x2 > n) {
+                k2_end += 2;
+            } else if(y2 > m) {
+                k2_start += 2;
+            } else if(!front) {
+                s64 k1_offset = v_offset + delta - k2;
+                if(k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1) {
+                    s64 x1 = v1[k1_offset];
+                    s64 y1 = v_offset + x1 - k1_offset;
+                    if(x1 >= n - x2) {
+                        *split_a = x1;
+                        *split_b = y1;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false; // Nothing in common
+}
+
+static
+void match_diff_lines(Diff_Context *context, Diff_Line *a, s64 n, Diff_Line *b, s64 m) {
+    //
+    // Strip the common prefix and suffix, which is where most of the matches are in the usual case of
+    // small edits in large files.
+    //
+    while(n > 0 && m > 0 && a[0].hash == b[0].hash) {
+        a->matched = b->matched = true;
+        ++a; ++b; --n; --m;
+    }
+
+    while(n > 0 && m > 0 && a[n - 1].hash == b[m - 1].hash) {
+        a[n - 1].matched = b[m - 1].matched = true;
+        --n; --m;
+    }
+
+    if(n == 0 || m == 0) return;
+
+    s64 split_a, split_b;
+    if(!bisect_diff_lines(context, a, n, b, m, &split_a, &split_b)) return;
+
+    match_diff_lines(context, a, split_a, b, split_b);
+    match_diff_lines(context, a + split_a, n - split_a, b + split_b, m - split_b);
+}
+
+static
+void count_diff_lines(Diff_Pair *pair, Diff_Lines *old_lines, Diff_Lines *new_lines) {
+    //
+    // Walk both files in parallel. The matched lines line up in order, and between two matches there is a
+    // hunk of removed and added lines. Inside such a hunk, we pair up removed and added lines as modified,
+    // and only count the remainder as truly added or removed.
+    //
+    s64 i = 0, j = 0;
+
+    while(i < old_lines->count || j < new_lines->count) {
+        if(i < old_lines->count && j < new_lines->count && old_lines->lines[i].matched && new_lines->lines[j].matched) {
+            add_line_to_stats(&pair->stats[DIFF_Same], new_lines->lines[j].category);
+            ++i;
+            ++j;
+            continue;
+        }
+
+        s64 old_end = i, new_end = j;
+        while(old_end < old_lines->count && !old_lines->lines[old_end].matched) ++old_end;
+        while(new_end < new_lines->count && !new_lines->lines[new_end].matched) ++new_end;
+
+        s64 modified = min(old_end - i, new_end - j);
+        for(s64 k = 0; k < modified; ++k) add_line_to_stats(&pair->stats[DIFF_Modified], new_lines->lines[j + k].category);
+        for(s64 k = i + modified; k < old_end; ++k) add_line_to_stats(&pair->stats[DIFF_Removed], old_lines->lines[k].category);
+        for(s64 k = j + modified; k < new_end; ++k) add_line_to_stats(&pair->stats[DIFF_Added], new_lines->lines[k].category);
+
+        i = old_end;
+        j = new_end;
+    }
+}
+
+
+
+/* ------------------------------------------------- Worker ------------------------------------------------- */
+
+static
+b8 read_diff_file(Worker *worker, Diff_Buffer *buffer, File *file) {
+    char *file_path = get_worker_file_path(worker, file);
+    if(read_entire_file(buffer, file_path)) return true;
+
+    printf("[WARNING]: Failed to read the file '%s'.\n", file_path);
+    return false;
+}
+
+static
+void diff_pair(Worker *worker, Diff_Context *context, Diff_Pair *pair) {
+    //
+    // A file that cannot be read (anymore) skips its pair, instead of being counted as if it was empty.
+    //
+    if(!pair->old_file) {
+        if(!read_diff_file(worker, &context->new_content, pair->new_file)) return;
+        count_buffer(&pair->stats[DIFF_Added], pair->language, context->new_content.data, context->new_content.size);
+        pair->stats[DIFF_Added].file_count = 1;
+        return;
+    }
+
+    if(!pair->new_file) {
+        if(!read_diff_file(worker, &context->old_content, pair->old_file)) return;
+        count_buffer(&pair->stats[DIFF_Removed], pair->language, context->old_content.data, context->old_content.size);
+        pair->stats[DIFF_Removed].file_count = 1;
+        return;
+    }
+
+    if(!read_diff_file(worker, &context->old_content, pair->old_file)) return;
+    if(!read_diff_file(worker, &context->new_content, pair->new_file)) return;
+
+    if(context->old_content.size == context->new_content.size && memcmp(context->old_content.data, context->new_content.data, context->new_content.size) == 0) {
+        //
+        // Identical files don't need a line diff, we only need to classify the lines once.
+        //
+        count_buffer(&pair->stats[DIFF_Same], pair->language, context->new_content.data, context->new_content.size);
+        pair->stats[DIFF_Same].file_count = 1;
+        return;
+    }
+
+    narrow_diff_buffer(&context->old_content);
+    narrow_diff_buffer(&context->new_content);
+    classify_diff_lines(&context->old_lines, pair->old_file->language, &context->old_content);
+    classify_diff_lines(&context->new_lines, pair->new_file->language, &context->new_content);
+    match_diff_lines(context, context->old_lines.lines, context->old_lines.count, context->new_lines.lines, context->new_lines.count);
+    count_diff_lines(pair, &context->old_lines, &context->new_lines);
+
+    // The content may only differ in line endings, in which case we still consider the file the same.
+    b8 changed = pair->stats[DIFF_Modified].blank + pair->stats[DIFF_Modified].comment + pair->stats[DIFF_Modified].code +
+        pair->stats[DIFF_Added].blank + pair->stats[DIFF_Added].comment + pair->stats[DIFF_Added].code +
+        pair->stats[DIFF_Removed].blank + pair->stats[DIFF_Removed].comment + pair->stats[DIFF_Removed].code > 0;
+    pair->stats[changed ? DIFF_Modified : DIFF_Same].file_count = 1;
+}
+
+Diff_Pair *get_next_diff_pair_to_parse(Cloc *cloc) {
+#if USE_CAS
+    Diff_Pair *current;
+
+    do {
+        current  = cloc->next_diff_pair;
+    } while(current != NULL && current != os_compare_and_swap((void *volatile *) &cloc->next_diff_pair, current->next, current));
+
+    return current;
+#else
+    if(cloc->next_diff_pair == NULL) return NULL;
+
+    Diff_Pair *current = cloc->next_diff_pair;
+    cloc->next_diff_pair = current->next;
+    return current;
+#endif
+}
+
+int diff_worker_thread(Worker *worker) {
+    Diff_Context context = { 0 };
+
+    Diff_Pair *pair;
+    while((pair = get_next_diff_pair_to_parse(worker->cloc))) {
+        diff_pair(worker, &context, pair);
+    }
+
+    free(context.old_content.data);
+    free(context.new_content.data);
+    free(context.old_lines.lines);
+    free(context.new_lines.lines);
+    free(context.v);
+    return 0;
+}
+
+
+
+/* ---------------------------------------------- Registration ---------------------------------------------- */
+
+static
+File *collect_diff_files(Cloc *cloc, char *path, OS_Path_Kind kind) {
+    cloc->first_file = NULL;
+
+    if(kind == OS_PATH_Is_File) {
+        register_file_path_to_parse(cloc, path);
+    } else {
+        register_directory_to_parse(cloc, path);
+    }
+
+    File *files = cloc->first_file;
+    cloc->first_file = NULL;
+    cloc->next_file  = NULL;
+    return files;
+}
+
+static
+Diff_Pair *create_diff_pair(Cloc *cloc, char *relative_path, Language language) {
+    Diff_Pair *pair = push_arena(&cloc->perm, sizeof(Diff_Pair));
+    memset(pair, 0, sizeof(Diff_Pair));
+    pair->relative_path = relative_path;
+    pair->language      = language;
+    pair->next          = cloc->first_diff_pair;
+    cloc->first_diff_pair = pair;
+    cloc->next_diff_pair  = pair;
+    ++cloc->diff_pair_count;
+    return pair;
+}
+
+b8 register_diff_trees(Cloc *cloc, char *old_path, char *new_path) {
+    OS_Path_Kind old_kind = os_resolve_path_kind(old_path);
+    OS_Path_Kind new_kind = os_resolve_path_kind(new_path);
+
+    if(old_kind == OS_PATH_Non_Existent || new_kind == OS_PATH_Non_Existent) {
+        printf("[ERROR]: The file path '%s' doesn't exist.\n", old_kind == OS_PATH_Non_Existent ? old_path : new_path);
+        return false;
+    }
+
+    if(old_kind != new_kind) {
+        printf("[ERROR]: Cannot diff the file against a directory.\n");
+        return false;
+    }
+
+    File *old_files = collect_diff_files(cloc, old_path, old_kind);
+    File *new_files = collect_diff_files(cloc, new_path, new_kind);
+
+    if(old_kind == OS_PATH_Is_File) {
+        //
+        // Two single files are always compared against each other, no matter their names.
+        //
+        if(old_files && new_files) {
+            Diff_Pair *pair = create_diff_pair(cloc, new_path, new_files->language);
+            pair->old_file  = old_files;
+            pair->new_file  = new_files;
+        }
+    } else {
+        // The trees were just registered, so this only looks up their existing nodes.
+        Directory_Node *old_root = intern_directory_path(&cloc->perm, &cloc->root_directory, os_make_absolute_path(&cloc->scratch, old_path));
+        Directory_Node *new_root = intern_directory_path(&cloc->perm, &cloc->root_directory, os_make_absolute_path(&cloc->scratch, new_path));
+
+        String_Table pairs_by_path;
+        create_string_table(&pairs_by_path, 1024);
+
+        for(File *file = old_files; file != NULL; file = file->next) {
+            Diff_Pair *pair = create_diff_pair(cloc, get_file_path(&cloc->perm, file, old_root), file->language);
+            pair->old_file  = file;
+            string_table_insert(&pairs_by_path, pair->relative_path, pair);
+        }
+
+        for(File *file = new_files; file != NULL; file = file->next) {
+            char *relative_path = get_file_path(&cloc->perm, file, new_root);
+            Diff_Pair *pair = string_table_query(&pairs_by_path, relative_path);
+            if(!pair) pair = create_diff_pair(cloc, relative_path, file->language);
+            pair->new_file = file;
+        }
+
+        destroy_string_table(&pairs_by_path);
+    }
+
+    cloc->file_count = cloc->diff_pair_count;
+    return true;
+}
+
+
+
+/* ------------------------------------------------- Output ------------------------------------------------- */
+
+static
+int compare_diff_pairs_by_path(const void *lhs, const void *rhs) {
+    return strcmp((*(Diff_Pair **) lhs)->relative_path, (*(Diff_Pair **) rhs)->relative_path);
+}
+
+static
+void print_diff_section(Cloc *cloc, const char *ident, Stats stats[DIFF_KIND_COUNT], b8 is_language_entries, b8 skip_empty_kinds) {
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string_with_max_length(&builder, ident, OUTPUT_LINE_WIDTH);
+    print_string_builder_as_line(&builder);
+
+    for(s64 i = 0; i < DIFF_KIND_COUNT; ++i) {
+        if(skip_empty_kinds && stats[i].blank + stats[i].comment + stats[i].code == 0) continue;
+
+        Stats entry = stats[i];
+        entry.ident = aprint(&cloc->scratch, " %s", DIFF_KIND_STRINGS[i]);
+        print_table_entry_line(cloc, &entry, is_language_entries);
+    }
+}
+
+Stats print_diff_table(Cloc *cloc) {
+    Stats sum_stats[DIFF_KIND_COUNT];
+    memset(sum_stats, 0, sizeof(sum_stats));
+
+    switch(cloc->output_mode) {
+    case OUTPUT_By_File: {
+        //
+        // Only list the files that actually changed, identical files are only part of the sum.
+        //
+        Diff_Pair **sorted_pairs = push_arena(&cloc->scratch, cloc->diff_pair_count * sizeof(Diff_Pair *));
+        s64 sorted_pair_count = 0;
+
+        for(Diff_Pair *pair = cloc->first_diff_pair; pair != NULL; pair = pair->next) {
+            for(s64 i = 0; i < DIFF_KIND_COUNT; ++i) combine_stats(&sum_stats[i], &pair->stats[i]);
+            if(!pair->stats[DIFF_Same].file_count) sorted_pairs[sorted_pair_count++] = pair;
+        }
+
+        qsort(sorted_pairs, sorted_pair_count, sizeof(Diff_Pair *), compare_diff_pairs_by_path);
+
+        for(s64 i = 0; i < sorted_pair_count; ++i) {
+            print_diff_section(cloc, sorted_pairs[i]->relative_path, sorted_pairs[i]->stats, false, true);
+        }
+    } break;
+
+    case OUTPUT_By_Language: {
+        Stats language_stats[LANGUAGE_COUNT][DIFF_KIND_COUNT];
+        memset(language_stats, 0, sizeof(language_stats));
+
+        for(Diff_Pair *pair = cloc->first_diff_pair; pair != NULL; pair = pair->next) {
+            for(s64 i = 0; i < DIFF_KIND_COUNT; ++i) {
+                combine_stats(&language_stats[pair->language][i], &pair->stats[i]);
+                combine_stats(&sum_stats[i], &pair->stats[i]);
+            }
+        }
+
+        for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+            s64 file_count = 0;
+            for(s64 j = 0; j < DIFF_KIND_COUNT; ++j) file_count += language_stats[i][j].file_count;
+            if(file_count > 0) print_diff_section(cloc, LANGUAGE_STRINGS[i], language_stats[i], true, false);
+        }
+    } break;
+    }
+
+    print_separator_line(cloc, "");
+    print_diff_section(cloc, "SUM:", sum_stats, cloc->output_mode != OUTPUT_By_File, false);
+
+    Stats total_stats = { 0 };
+    for(s64 i = 0; i < DIFF_KIND_COUNT; ++i) combine_stats(&total_stats, &sum_stats[i]);
+    return total_stats;
+}
@@ -0,0 +1,27 @@
+typedef enum Diff_Kind {
+    DIFF_Same,
+    DIFF_Modified,
+    DIFF_Added,
+    DIFF_Removed,
+    DIFF_KIND_COUNT,
+} Diff_Kind;
+
+const char *DIFF_KIND_STRINGS[DIFF_KIND_COUNT] = { "same", "modified", "added", "removed" };
+
+// Two files from the old and the new tree that share the same path relative to their tree's root.
+typedef struct Diff_Pair {
+    struct Diff_Pair *next;
+    char *relative_path;
+    File *old_file; // NULL if the file was added
+    File *new_file; // NULL if the file was removed
+    Language language;
+
+    // The line counts of each kind, split by category. The file count is set for the one kind that describes
+    // the file as a whole.
+    Stats stats[DIFF_KIND_COUNT];
+} Diff_Pair;
+
+b8 register_diff_trees(Cloc *cloc, char *old_path, char *new_path);
+Diff_Pair *get_next_diff_pair_to_parse(Cloc *cloc);
+int diff_worker_thread(Worker *worker);
+Stats print_diff_table(Cloc *cloc);
@@ -0,0 +1,444 @@
+/* -------------------------------------------------- Index -------------------------------------------------- */
+
+#define DUPLICATE_HASH_BASE 0x100000001b3
+
+typedef struct Duplicate_Window {
+    u64 hash;
+    u32 line;
+} Duplicate_Window;
+
+// Worker local buffers for the windows of one file, reused across files.
+typedef struct Duplicate_Batch {
+    Duplicate_Window *windows;
+    Duplicate_Window *sorted_windows; // Grouped by shard
+    s64 capacity;
+} Duplicate_Batch;
+
+static inline
+u64 finalize_window_hash(u64 hash) {
+    //
+    // The rolling hash is a polynomial, so its top bits (which pick the shard) are poorly mixed. Scramble it
+    // before using it, and reserve 0 for empty slots.
+    //
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    return hash ? hash : 1;
+}
+
+static
+s64 compute_window_hashes(Duplicates *duplicates, Line_Hashes *lines, Duplicate_Window *windows) {
+    //
+    // The hash of a window is the polynomial sum of its line hashes, so moving the window by one line only
+    // removes the oldest line and adds the newest one.
+    //
+    s64 window = duplicates->window;
+    if(lines->count < window) return 0;
+
+    u64 oldest_line_factor = 1;
+    for(s64 i = 1; i < window; ++i) oldest_line_factor *= DUPLICATE_HASH_BASE;
+
+    u64 hash = 0;
+    for(s64 i = 0; i < lines->count; ++i) {
+        if(i >= window) hash -= lines->hashes[i - window] * oldest_line_factor;
+        hash = hash * DUPLICATE_HASH_BASE + lines->hashes[i];
+
+        if(i >= window - 1) {
+            windows[i - window + 1].hash = finalize_window_hash(hash);
+            windows[i - window + 1].line = lines->lines[i - window + 1];
+        }
+    }
+
+    return lines->count - window + 1;
+}
+
+static
+void grow_duplicate_shard(Duplicate_Shard *shard) {
+    s64 new_capacity = max(shard->capacity * 2, 1024);
+    Duplicate_Entry *new_entries = malloc(new_capacity * sizeof(Duplicate_Entry));
+    memset(new_entries, 0, new_capacity * sizeof(Duplicate_Entry));
+
+    for(s64 i = 0; i < shard->capacity; ++i) {
+        if(!shard->entries[i].hash) continue;
+
+        s64 index = shard->entries[i].hash & (new_capacity - 1);
+        while(new_entries[index].hash) index = (index + 1) & (new_capacity - 1);
+        new_entries[index] = shard->entries[i];
+    }
+
+    free(shard->entries);
+    shard->entries  = new_entries;
+    shard->capacity = new_capacity;
+}
+
+static
+void insert_duplicate_windows(Duplicate_Shard *shard, u32 file_index, Duplicate_Window *windows, s64 count) {
+    os_lock_mutex(&shard->mutex);
+
+    for(s64 i = 0; i < count; ++i) {
+        if((shard->count + 1) * 4 > shard->capacity * 3) grow_duplicate_shard(shard);
+
+        s64 index = windows[i].hash & (shard->capacity - 1);
+        while(shard->entries[index].hash && shard->entries[index].hash != windows[i].hash) index = (index + 1) & (shard->capacity - 1);
+
+        Duplicate_Entry *entry = &shard->entries[index];
+        if(!entry->hash) {
+            entry->hash       = windows[i].hash;
+            entry->file_index = file_index;
+            entry->line       = windows[i].line;
+            ++shard->count;
+        } else if(file_index < entry->file_index || (file_index == entry->file_index && windows[i].line < entry->line)) {
+            entry->file_index = file_index;
+            entry->line       = windows[i].line;
+        }
+    }
+
+    os_unlock_mutex(&shard->mutex);
+}
+
+static
+Duplicate_Entry *query_duplicate_window(Duplicates *duplicates, u64 hash) {
+    // Only called once all windows were inserted, so the index doesn't change anymore.
+    Duplicate_Shard *shard = &duplicates->shards[hash >> (64 - DUPLICATE_SHARD_BITS)];
+    s64 index = hash & (shard->capacity - 1);
+    while(shard->entries[index].hash != hash) index = (index + 1) & (shard->capacity - 1);
+    return &shard->entries[index];
+}
+
+
+
+/* -------------------------------------------------- Worker -------------------------------------------------- */
+
+static
+Duplicate_File *get_next_duplicate_file(Duplicate_File *volatile *queue) {
+#if USE_CAS
+    Duplicate_File *current;
+
+    do {
+        current  = *queue;
+    } while(current != NULL && current != os_compare_and_swap((void *volatile *) queue, current->next, current));
+
+    return current;
+#else
+    if(*queue == NULL) return NULL;
+
+    Duplicate_File *current = *queue;
+    *queue = current->next;
+    return current;
+#endif
+}
+
+static
+void reserve_duplicate_batch(Duplicate_Batch *batch, s64 window_count) {
+    if(window_count <= batch->capacity) return;
+
+    batch->capacity       = max(window_count, batch->capacity * 2);
+    batch->windows        = realloc(batch->windows, batch->capacity * sizeof(Duplicate_Window));
+    batch->sorted_windows = realloc(batch->sorted_windows, batch->capacity * sizeof(Duplicate_Window));
+}
+
+static
+void hash_duplicate_file(Worker *worker, Duplicates *duplicates, Duplicate_File *entry, Duplicate_Batch *batch) {
+    count_file_with_line_hashes(worker, entry->file, &entry->lines);
+    note_file_done(worker, entry->file);
+    if(entry->file->status != FILE_Source || entry->lines.count < duplicates->window) return;
+
+    reserve_duplicate_batch(batch, entry->lines.count);
+
+    //
+    // Group the windows by shard first, so that every shard is only locked once per file.
+    //
+    s64 window_count = compute_window_hashes(duplicates, &entry->lines, batch->windows);
+
+    s64 shard_offsets[DUPLICATE_SHARD_COUNT + 1] = { 0 };
+    for(s64 i = 0; i < window_count; ++i) ++shard_offsets[(batch->windows[i].hash >> (64 - DUPLICATE_SHARD_BITS)) + 1];
+    for(s64 i = 0; i < DUPLICATE_SHARD_COUNT; ++i) shard_offsets[i + 1] += shard_offsets[i];
+
+    s64 shard_cursors[DUPLICATE_SHARD_COUNT];
+    memcpy(shard_cursors, shard_offsets, sizeof(shard_cursors));
+    for(s64 i = 0; i < window_count; ++i) {
+        s64 shard = batch->windows[i].hash >> (64 - DUPLICATE_SHARD_BITS);
+        batch->sorted_windows[shard_cursors[shard]++] = batch->windows[i];
+    }
+
+    for(s64 i = 0; i < DUPLICATE_SHARD_COUNT; ++i) {
+        s64 count = shard_offsets[i + 1] - shard_offsets[i];
+        if(count) insert_duplicate_windows(&duplicates->shards[i], entry->index, &batch->sorted_windows[shard_offsets[i]], count);
+    }
+}
+
+static
+b8 is_better_duplicate_region(Duplicate_Region *lhs, Duplicate_Region *rhs) {
+    // A total order, so that the top regions don't depend on which worker found them first.
+    if(lhs->code_lines != rhs->code_lines) return lhs->code_lines > rhs->code_lines;
+    if(lhs->file->index != rhs->file->index) return lhs->file->index < rhs->file->index;
+    return lhs->first_line < rhs->first_line;
+}
+
+static
+void offer_duplicate_region(Duplicates *duplicates, Duplicate_Region *region) {
+    os_lock_mutex(&duplicates->mutex);
+
+    if(duplicates->top_region_count < DUPLICATE_TOP_REGIONS) {
+        duplicates->top_regions[duplicates->top_region_count++] = *region;
+    } else {
+        s64 worst = 0;
+        for(s64 i = 1; i < DUPLICATE_TOP_REGIONS; ++i) {
+            if(is_better_duplicate_region(&duplicates->top_regions[worst], &duplicates->top_regions[i])) worst = i;
+        }
+
+        if(is_better_duplicate_region(region, &duplicates->top_regions[worst])) duplicates->top_regions[worst] = *region;
+    }
+
+    os_unlock_mutex(&duplicates->mutex);
+}
+
+static
+void check_duplicate_file(Duplicates *duplicates, Duplicate_File *entry, Duplicate_Batch *batch) {
+    if(entry->file->status != FILE_Source || entry->lines.count < duplicates->window) return;
+
+    reserve_duplicate_batch(batch, entry->lines.count);
+
+    s64 window_count = compute_window_hashes(duplicates, &entry->lines, batch->windows);
+    s64 covered_until = 0; // Code line index up to which lines were already counted as duplicated
+    s64 run_start     = -1;
+    Duplicate_Entry *run_original = NULL;
+
+    for(s64 i = 0; i <= window_count; ++i) {
+        b8 is_copy = false;
+        Duplicate_Entry *original = NULL;
+        if(i < window_count) {
+            original = query_duplicate_window(duplicates, batch->windows[i].hash);
+            is_copy  = original->file_index != entry->index || original->line != batch->windows[i].line;
+        }
+
+        if(is_copy) {
+            entry->duplicated_lines += i + duplicates->window - max(i, covered_until);
+            covered_until = i + duplicates->window;
+
+            if(run_start < 0) {
+                run_start    = i;
+                run_original = original;
+            }
+        } else if(run_start >= 0) {
+            Duplicate_Region region;
+            region.file                = entry;
+            region.first_line          = entry->lines.lines[run_start];
+            region.last_line           = entry->lines.lines[i - 1 + duplicates->window - 1];
+            region.code_lines          = i - run_start + duplicates->window - 1;
+            region.original_file_index = run_original->file_index;
+            region.original_line       = run_original->line;
+            offer_duplicate_region(duplicates, &region);
+            run_start = -1;
+        }
+    }
+}
+
+int duplicate_worker_thread(Worker *worker) {
+    Cloc *cloc = worker->cloc;
+    Duplicates *duplicates = cloc->duplicates;
+    Duplicate_Batch batch = { 0 };
+
+    Duplicate_File *entry;
+    while((entry = get_next_duplicate_file(&duplicates->next_file_to_hash))) {
+        hash_duplicate_file(worker, duplicates, entry, &batch);
+    }
+
+    //
+    // Wait until every window of every file is in the index, before any copies can be identified.
+    //
+    os_lock_mutex(&duplicates->mutex);
+    ++duplicates->workers_hashing;
+    if(duplicates->workers_hashing == cloc->active_workers) {
+        os_broadcast_condition(&duplicates->all_hashed);
+    } else {
+        while(duplicates->workers_hashing < cloc->active_workers) os_wait_condition(&duplicates->all_hashed, &duplicates->mutex);
+    }
+    os_unlock_mutex(&duplicates->mutex);
+
+    while((entry = get_next_duplicate_file(&duplicates->next_file_to_check))) {
+        check_duplicate_file(duplicates, entry, &batch);
+        free(entry->lines.hashes);
+        free(entry->lines.lines);
+        entry->lines.hashes = NULL;
+        entry->lines.lines  = NULL;
+    }
+
+    free(batch.windows);
+    free(batch.sorted_windows);
+    return 0;
+}
+
+
+
+/* -------------------------------------------------- Setup -------------------------------------------------- */
+
+Duplicates *create_duplicates(Cloc *cloc, s64 window) {
+    Duplicates *duplicates = malloc(sizeof(Duplicates));
+    memset(duplicates, 0, sizeof(Duplicates));
+    duplicates->cloc   = cloc;
+    duplicates->window = window;
+    os_create_mutex(&duplicates->mutex);
+    os_create_condition(&duplicates->all_hashed);
+
+    for(s64 i = 0; i < DUPLICATE_SHARD_COUNT; ++i) {
+        os_create_mutex(&duplicates->shards[i].mutex);
+        grow_duplicate_shard(&duplicates->shards[i]);
+    }
+
+    //
+    // Both phases walk the same list of files, each with its own queue head.
+    //
+    duplicates->file_count = cloc->file_count;
+    duplicates->files = malloc(max(cloc->file_count, 1) * sizeof(Duplicate_File));
+    memset(duplicates->files, 0, max(cloc->file_count, 1) * sizeof(Duplicate_File));
+
+    s64 index = 0;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        Duplicate_File *entry = &duplicates->files[index];
+        entry->next  = index + 1 < cloc->file_count ? &duplicates->files[index + 1] : NULL;
+        entry->file  = file;
+        entry->index = (u32) index;
+        ++index;
+    }
+
+    duplicates->next_file_to_hash  = cloc->file_count ? &duplicates->files[0] : NULL;
+    duplicates->next_file_to_check = duplicates->next_file_to_hash;
+    return duplicates;
+}
+
+void destroy_duplicates(Duplicates *duplicates) {
+    for(s64 i = 0; i < DUPLICATE_SHARD_COUNT; ++i) {
+        free(duplicates->shards[i].entries);
+        os_destroy_mutex(&duplicates->shards[i].mutex);
+    }
+
+    for(s64 i = 0; i < duplicates->file_count; ++i) {
+        free(duplicates->files[i].lines.hashes);
+        free(duplicates->files[i].lines.lines);
+    }
+
+    free(duplicates->files);
+    os_destroy_condition(&duplicates->all_hashed);
+    os_destroy_mutex(&duplicates->mutex);
+    free(duplicates);
+}
+
+
+
+/* -------------------------------------------------- Output -------------------------------------------------- */
+
+static
+void print_duplicates_entry_line(Cloc *cloc, const char *ident, s64 file_count, s64 code_lines, s64 duplicated_lines) {
+    char *share = aprint(&cloc->scratch, "%.1f%%", code_lines ? 100. * duplicated_lines / code_lines : 0.);
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string_with_max_length(&builder, ident, FILE_COUNT_COLUMN_OFFSET - 3);
+    append_right_justified_integer_at_offset(&builder, file_count,       ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(&builder, code_lines,       ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_integer_at_offset(&builder, duplicated_lines, ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, share, ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+}
+
+void print_duplicates_report(Cloc *cloc) {
+    Duplicates *duplicates = cloc->duplicates;
+
+    //
+    // Per language totals. The file count is the number of files that contain duplicated lines.
+    //
+    s64 file_counts[LANGUAGE_COUNT] = { 0 };
+    s64 code_lines[LANGUAGE_COUNT] = { 0 };
+    s64 duplicated_lines[LANGUAGE_COUNT] = { 0 };
+    s64 sum_file_count = 0, sum_code_lines = 0, sum_duplicated_lines = 0;
+
+    for(s64 i = 0; i < duplicates->file_count; ++i) {
+        Duplicate_File *entry = &duplicates->files[i];
+        if(entry->file->status != FILE_Source) continue;
+
+        Language language = entry->file->language;
+        file_counts[language]      += entry->duplicated_lines > 0;
+        code_lines[language]       += entry->file->stats.code;
+        duplicated_lines[language] += entry->duplicated_lines;
+        sum_file_count       += entry->duplicated_lines > 0;
+        sum_code_lines       += entry->file->stats.code;
+        sum_duplicated_lines += entry->duplicated_lines;
+    }
+
+    print_separator_line(cloc, aprint(&cloc->scratch, "Duplicates (%" PRId64 "+ code lines)", duplicates->window));
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string(&builder, "Language");
+    append_right_justified_string_at_offset(&builder, "Files",      ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Code",       ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Duplicated", ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Share",      ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+    print_separator_line(cloc, "");
+
+    s64 language_count = 0;
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+        if(!code_lines[i]) continue;
+        print_duplicates_entry_line(cloc, LANGUAGE_STRINGS[i], file_counts[i], code_lines[i], duplicated_lines[i]);
+        ++language_count;
+    }
+
+    if(language_count > 1) {
+        print_separator_line(cloc, "");
+        print_duplicates_entry_line(cloc, "SUM:", sum_file_count, sum_code_lines, sum_duplicated_lines);
+    }
+
+    if(!duplicates->top_region_count) return;
+
+    //
+    // The largest copied regions, printed relative to the deepest directory containing all of them and their
+    // originals.
+    //
+    Duplicate_Region *regions = duplicates->top_regions;
+    for(s64 i = 0; i < duplicates->top_region_count; ++i) {
+        for(s64 j = i + 1; j < duplicates->top_region_count; ++j) {
+            if(is_better_duplicate_region(&regions[j], &regions[i])) {
+                Duplicate_Region tmp = regions[i];
+                regions[i] = regions[j];
+                regions[j] = tmp;
+            }
+        }
+    }
+
+    Directory_Node *common_directory = NULL;
+    for(s64 i = 0; i < duplicates->top_region_count; ++i) {
+        File *copy     = regions[i].file->file;
+        File *original = duplicates->files[regions[i].original_file_index].file;
+        common_directory = common_directory ? find_common_directory(common_directory, copy->directory) : copy->directory;
+        common_directory = find_common_directory(common_directory, original->directory);
+    }
+
+    print_separator_line(cloc, "Largest duplicated regions");
+
+    const s64 ORIGINAL_COLUMN_OFFSET = EMPTY_LINES_COLUMN_OFFSET - 10;
+
+    create_string_builder(&builder, &cloc->scratch);
+    append_string(&builder, "Region");
+    append_repeated_char(&builder, ' ', ORIGINAL_COLUMN_OFFSET - builder.size_in_characters);
+    append_string(&builder, "Original");
+    append_right_justified_string_at_offset(&builder, "Lines", ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+    print_separator_line(cloc, "");
+
+    for(s64 i = 0; i < duplicates->top_region_count; ++i) {
+        Duplicate_Region *region = &regions[i];
+        File *original = duplicates->files[region->original_file_index].file;
+
+        char *copy_location     = aprint(&cloc->scratch, "%s:%" PRId64 "-%" PRId64, get_file_path(&cloc->scratch, region->file->file, common_directory), region->first_line, region->last_line);
+        char *original_location = aprint(&cloc->scratch, "%s:%u", get_file_path(&cloc->scratch, original, common_directory), region->original_line);
+
+        create_string_builder(&builder, &cloc->scratch);
+        append_string_with_max_length(&builder, copy_location, ORIGINAL_COLUMN_OFFSET - 2);
+        append_repeated_char(&builder, ' ', ORIGINAL_COLUMN_OFFSET - builder.size_in_characters);
+        append_string_with_max_length(&builder, original_location, CODE_LINES_COLUMN_OFFSET - ORIGINAL_COLUMN_OFFSET - 8);
+        append_right_justified_integer_at_offset(&builder, region->code_lines, ' ', CODE_LINES_COLUMN_OFFSET);
+        print_string_builder_as_line(&builder);
+    }
+}
@@ -0,0 +1,73 @@
+struct Cloc;
+
+#define DUPLICATE_DEFAULT_WINDOW 6
+#define DUPLICATE_SHARD_BITS 6
+#define DUPLICATE_SHARD_COUNT (1 << DUPLICATE_SHARD_BITS)
+#define DUPLICATE_TOP_REGIONS 10
+
+//
+// Duplicated code is found by hashing every window of N consecutive code lines, after stripping whitespace and
+// comments from each line. The first occurrence of every window hash is stored in an index, and every later
+// window with the same hash is considered a copy of it. The first occurrence is the one with the lowest file
+// index and line, so that the result doesn't depend on the order in which the workers happen to get there.
+//
+// This runs in two phases: First, all workers hash their files and fill the index. Once every worker is done,
+// they check all windows of their files against the now complete index again.
+//
+
+typedef struct Duplicate_Entry {
+    u64 hash; // 0 for empty slots
+    u32 file_index;
+    u32 line; // The line the first occurrence of this window starts on
+} Duplicate_Entry;
+
+// The index is split into shards by the top bits of the window hash, so that workers only contend for a lock
+// when they insert into the same shard at the same time.
+typedef struct Duplicate_Shard {
+    OS_Mutex mutex;
+    Duplicate_Entry *entries;
+    s64 count;
+    s64 capacity; // Always a power of two
+    u8 padding[64]; // Keep the locks of different shards on different cache lines
+} Duplicate_Shard;
+
+typedef struct Duplicate_File {
+    struct Duplicate_File *next;
+    File *file;
+    u32 index;
+    Line_Hashes lines;    // Released once this file was checked against the index
+    s64 duplicated_lines; // Code lines that are part of at least one copied window
+} Duplicate_File;
+
+// A run of consecutive copied windows in one file.
+typedef struct Duplicate_Region {
+    Duplicate_File *file;
+    s64 first_line;
+    s64 last_line;
+    s64 code_lines;
+    u32 original_file_index;
+    u32 original_line;
+} Duplicate_Region;
+
+typedef struct Duplicates {
+    struct Cloc *cloc;
+    s64 window; // In code lines
+    Duplicate_Shard shards[DUPLICATE_SHARD_COUNT];
+
+    Duplicate_File *files; // Indexed by the file index
+    s64 file_count;
+    Duplicate_File *next_file_to_hash;
+    Duplicate_File *next_file_to_check;
+
+    // --- Protected by the mutex
+    OS_Mutex mutex;
+    OS_Condition all_hashed;
+    s64 workers_hashing;
+    Duplicate_Region top_regions[DUPLICATE_TOP_REGIONS];
+    s64 top_region_count;
+} Duplicates;
+
+Duplicates *create_duplicates(struct Cloc *cloc, s64 window);
+void destroy_duplicates(Duplicates *duplicates);
+int duplicate_worker_thread(Worker *worker);
+void print_duplicates_report(struct Cloc *cloc);
@@ -0,0 +1,1259 @@
+/*
+ * The git mode counts the files of any revision straight from the object database of a repository, without
+ * needing a working tree, the git binary or network access. Both loose objects and packfiles (including
+ * delta-compressed objects) are supported.
+ *
+ * All trees and blobs are memoized by their object id. Scanning many revisions therefore only walks the
+ * trees that changed between them, and only counts each distinct blob once.
+ */
+
+/* ------------------------------------------------- Buffers ------------------------------------------------- */
+
+static
+void reserve_git_buffer(Git_Buffer *buffer, s64 size) {
+    if(size <= buffer->capacity) return;
+    buffer->capacity = max(size, buffer->capacity * 2);
+    buffer->data     = realloc(buffer->data, buffer->capacity);
+}
+
+static
+void free_git_buffer(Git_Buffer *buffer) {
+    free(buffer->data);
+    buffer->data     = NULL;
+    buffer->size     = 0;
+    buffer->capacity = 0;
+}
+
+static
+u32 read_big_endian_u32(u8 *data) {
+    return ((u32) data[0] << 24) | ((u32) data[1] << 16) | ((u32) data[2] << 8) | (u32) data[3];
+}
+
+
+
+/* ------------------------------------------------- Inflate ------------------------------------------------- */
+
+#define INFLATE_FAST_BITS 10
+
+typedef struct Inflate_Table {
+    u16 counts[16];
+    u16 symbols[320];
+    u16 fast[1 << INFLATE_FAST_BITS]; // (code length << 9) | symbol for all codes that fit into the fast bits, 0 otherwise
+} Inflate_Table;
+
+typedef struct Inflate_Stream {
+    u8 *input;
+    s64 input_size;
+    s64 input_position;
+    u64 bits;
+    s64 bit_count;
+    s64 padding; // The number of zero bytes we had to feed after the end of the input
+} Inflate_Stream;
+
+static const u16 INFLATE_LENGTH_BASE[29]    = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const u8  INFLATE_LENGTH_EXTRA[29]   = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const u16 INFLATE_DISTANCE_BASE[30]  = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const u8  INFLATE_DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const u8  INFLATE_CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static inline
+void refill_inflate_stream(Inflate_Stream *stream) {
+    while(stream->bit_count <= 56) {
+        u64 byte = 0;
+        if(stream->input_position < stream->input_size) {
+            byte = stream->input[stream->input_position++];
+        } else {
+            ++stream->padding;
+        }
+        stream->bits |= byte << stream->bit_count;
+        stream->bit_count += 8;
+    }
+}
+
+static inline
+u32 read_inflate_bits(Inflate_Stream *stream, s64 count) {
+    if(stream->bit_count < count) refill_inflate_stream(stream);
+    u32 value = (u32) (stream->bits & ((1ull << count) - 1));
+    stream->bits >>= count;
+    stream->bit_count -= count;
+    return value;
+}
+
+static
+void build_inflate_table(Inflate_Table *table, u8 *lengths, s64 symbol_count) {
+    memset(table->counts, 0, sizeof(table->counts));
+    memset(table->fast, 0, sizeof(table->fast));
+
+    for(s64 i = 0; i < symbol_count; ++i) ++table->counts[lengths[i]];
+    table->counts[0] = 0;
+
+    u16 offsets[16];
+    offsets[1] = 0;
+    for(s64 length = 1; length < 15; ++length) offsets[length + 1] = offsets[length] + table->counts[length];
+
+    for(s64 i = 0; i < symbol_count; ++i) {
+        if(lengths[i]) table->symbols[offsets[lengths[i]]++] = (u16) i;
+    }
+
+    //
+    // Codes are stored with their bits reversed in the stream, so fill every fast table slot whose lowest
+    // bits match the reversed code.
+    //
+    u32 code  = 0;
+    s64 index = 0;
+    for(s64 length = 1; length < 16; ++length) {
+        for(s64 i = 0; i < table->counts[length]; ++i) {
+            if(length <= INFLATE_FAST_BITS) {
+                u32 reversed = 0;
+                for(s64 bit = 0; bit < length; ++bit) reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+
+                for(u32 slot = reversed; slot < (1 << INFLATE_FAST_BITS); slot += (1 << length)) {
+                    table->fast[slot] = (u16) ((length << 9) | table->symbols[index]);
+                }
+            }
+
+            ++code;
+            ++index;
+        }
+
+        code <<= 1;
+    }
+}
+
+static inline
+s32 decode_inflate_symbol(Inflate_Stream *stream, Inflate_Table *table) {
+    if(stream->bit_count < 16) refill_inflate_stream(stream);
+
+    u16 entry = table->fast[stream->bits & ((1 << INFLATE_FAST_BITS) - 1)];
+    if(entry) {
+        stream->bits >>= entry >> 9;
+        stream->bit_count -= entry >> 9;
+        return entry & 511;
+    }
+
+    //
+    // The code is longer than the fast table, decode it bit by bit.
+    //
+    s32 code = 0, first = 0, index = 0;
+    for(s64 length = 1; length < 16; ++length) {
+        code |= stream->bits & 1;
+        stream->bits >>= 1;
+        --stream->bit_count;
+
+        s32 count = table->counts[length];
+        if(code - count < first) return table->symbols[index + (code - first)];
+        index += count;
+        first += count;
+        first <<= 1;
+        code  <<= 1;
+    }
+
+    return -1;
+}
+
+static
+b8 inflate_block(Inflate_Stream *stream, Git_Buffer *output, Inflate_Table *literals, Inflate_Table *distances) {
+    while(true) {
+        if(stream->padding > 8) return false; // We are reading garbage after the end of the input
+
+        s32 symbol = decode_inflate_symbol(stream, literals);
+
+        if(symbol < 256) {
+            if(symbol < 0) return false;
+            reserve_git_buffer(output, output->size + 1);
+            output->data[output->size++] = (u8) symbol;
+        } else if(symbol == 256) {
+            return true;
+        } else {
+            symbol -= 257;
+            if(symbol >= 29) return false;
+            s64 length = INFLATE_LENGTH_BASE[symbol] + read_inflate_bits(stream, INFLATE_LENGTH_EXTRA[symbol]);
+
+            s32 distance_symbol = decode_inflate_symbol(stream, distances);
+            if(distance_symbol < 0 || distance_symbol >= 30) return false;
+            s64 distance = INFLATE_DISTANCE_BASE[distance_symbol] + read_inflate_bits(stream, INFLATE_DISTANCE_EXTRA[distance_symbol]);
+            if(distance > output->size) return false;
+
+            reserve_git_buffer(output, output->size + length);
+            u8 *destination = &output->data[output->size];
+            u8 *source      = destination - distance;
+            for(s64 i = 0; i < length; ++i) destination[i] = source[i]; // The ranges may overlap, so don't memcpy
+            output->size += length;
+        }
+    }
+}
+
+// Decompresses a complete zlib stream into the output buffer. The expected size is only a hint for the
+// initial allocation.
+static
+b8 inflate_zlib_stream(u8 *input, s64 input_size, Git_Buffer *output, s64 expected_size) {
+    output->size = 0;
+    reserve_git_buffer(output, max(expected_size, 64));
+
+    if(input_size < 2 || (input[0] & 0x0f) != 8 || ((input[0] << 8) | input[1]) % 31 != 0 || (input[1] & 0x20)) return false;
+
+    Inflate_Stream stream = { 0 };
+    stream.input          = input;
+    stream.input_size     = input_size;
+    stream.input_position = 2;
+
+    Inflate_Table literals, distances;
+    b8 final_block = false;
+
+    while(!final_block) {
+        final_block = read_inflate_bits(&stream, 1);
+        u32 block_type = read_inflate_bits(&stream, 2);
+
+        switch(block_type) {
+        case 0: { // Stored
+            read_inflate_bits(&stream, stream.bit_count % 8);
+            u32 length = read_inflate_bits(&stream, 16);
+            u32 inverted_length = read_inflate_bits(&stream, 16);
+            if((length ^ 0xffff) != inverted_length) return false;
+
+            reserve_git_buffer(output, output->size + length);
+
+            // Some of the bytes may already be in our bit buffer.
+            while(length > 0 && stream.bit_count >= 8) {
+                output->data[output->size++] = (u8) read_inflate_bits(&stream, 8);
+                --length;
+            }
+
+            if(length > stream.input_size - stream.input_position) return false;
+            memcpy(&output->data[output->size], &stream.input[stream.input_position], length);
+            output->size += length;
+            stream.input_position += length;
+        } break;
+
+        case 1: { // Fixed Huffman codes
+            u8 lengths[288 + 30];
+            for(s64 i = 0;   i < 144; ++i) lengths[i] = 8;
+            for(s64 i = 144; i < 256; ++i) lengths[i] = 9;
+            for(s64 i = 256; i < 280; ++i) lengths[i] = 7;
+            for(s64 i = 280; i < 288; ++i) lengths[i] = 8;
+            for(s64 i = 288; i < 288 + 30; ++i) lengths[i] = 5;
+            build_inflate_table(&literals, lengths, 288);
+            build_inflate_table(&distances, &lengths[288], 30);
+            if(!inflate_block(&stream, output, &literals, &distances)) return false;
+        } break;
+
+        case 2: { // Dynamic Huffman codes
+            s64 literal_count  = read_inflate_bits(&stream, 5) + 257;
+            s64 distance_count = read_inflate_bits(&stream, 5) + 1;
+            s64 code_length_count = read_inflate_bits(&stream, 4) + 4;
+
+            u8 code_lengths[19] = { 0 };
+            for(s64 i = 0; i < code_length_count; ++i) code_lengths[INFLATE_CODE_LENGTH_ORDER[i]] = (u8) read_inflate_bits(&stream, 3);
+
+            Inflate_Table code_length_table;
+            build_inflate_table(&code_length_table, code_lengths, 19);
+
+            u8 lengths[288 + 32];
+            s64 index = 0;
+            while(index < literal_count + distance_count) {
+                s32 symbol = decode_inflate_symbol(&stream, &code_length_table);
+                s64 repeat = 0;
+                u8 value   = 0;
+
+                if(symbol < 0) {
+                    return false;
+                } else if(symbol < 16) {
+                    lengths[index++] = (u8) symbol;
+                    continue;
+                } else if(symbol == 16) {
+                    if(index == 0) return false;
+                    value  = lengths[index - 1];
+                    repeat = 3 + read_inflate_bits(&stream, 2);
+                } else if(symbol == 17) {
+                    repeat = 3 + read_inflate_bits(&stream, 3);
+                } else {
+                    repeat = 11 + read_inflate_bits(&stream, 7);
+                }
+
+                if(index + repeat > literal_count + distance_count) return false;
+                while(repeat--) lengths[index++] = value;
+            }
+
+            build_inflate_table(&literals, lengths, literal_count);
+            build_inflate_table(&distances, &lengths[literal_count], distance_count);
+            if(!inflate_block(&stream, output, &literals, &distances)) return false;
+        } break;
+
+        default: return false;
+        }
+    }
+
+    return stream.padding * 8 <= stream.bit_count; // Make sure we didn't consume bits that were never in the input
+}
+
+
+
+/* ---------------------------------------------- Object Table ---------------------------------------------- */
+
+static
+void create_git_object_table(Git_Object_Table *table) {
+    table->capacity = 1024;
+    table->count    = 0;
+    table->entries  = calloc(table->capacity, sizeof(Git_Object_Table_Entry));
+}
+
+static
+void destroy_git_object_table(Git_Object_Table *table) {
+    free(table->entries);
+    table->entries  = NULL;
+    table->count    = 0;
+    table->capacity = 0;
+}
+
+static
+Git_Object_Table_Entry *find_git_object_table_entry(Git_Object_Table_Entry *entries, s64 capacity, Git_Object_Id *id, u8 tag) {
+    // Object ids are already uniformly distributed, so we can just use their first bytes as the hash.
+    u64 hash;
+    memcpy(&hash, id->bytes, sizeof(hash));
+
+    s64 index = (hash ^ tag) & (capacity - 1);
+    while(entries[index].value != NULL && (entries[index].tag != tag || memcmp(&entries[index].id, id, sizeof(Git_Object_Id)) != 0)) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &entries[index];
+}
+
+static
+void *git_object_table_query(Git_Object_Table *table, Git_Object_Id *id, u8 tag) {
+    return find_git_object_table_entry(table->entries, table->capacity, id, tag)->value;
+}
+
+static
+void git_object_table_insert(Git_Object_Table *table, Git_Object_Id *id, u8 tag, void *value) {
+    if((table->count + 1) * 4 > table->capacity * 3) {
+        s64 new_capacity = table->capacity * 2;
+        Git_Object_Table_Entry *new_entries = calloc(new_capacity, sizeof(Git_Object_Table_Entry));
+
+        for(s64 i = 0; i < table->capacity; ++i) {
+            if(table->entries[i].value == NULL) continue;
+            *find_git_object_table_entry(new_entries, new_capacity, &table->entries[i].id, table->entries[i].tag) = table->entries[i];
+        }
+
+        free(table->entries);
+        table->entries  = new_entries;
+        table->capacity = new_capacity;
+    }
+
+    Git_Object_Table_Entry *entry = find_git_object_table_entry(table->entries, table->capacity, id, tag);
+    if(entry->value == NULL) ++table->count;
+    entry->id    = *id;
+    entry->tag   = tag;
+    entry->value = value;
+}
+
+
+
+/* ------------------------------------------------ Object Ids ------------------------------------------------ */
+
+static
+s32 parse_hex_digit(char character) {
+    if(character >= '0' && character <= '9') return character - '0';
+    if(character >= 'a' && character <= 'f') return character - 'a' + 10;
+    if(character >= 'A' && character <= 'F') return character - 'A' + 10;
+    return -1;
+}
+
+static
+b8 parse_git_object_id(char *hex, Git_Object_Id *id) {
+    for(s64 i = 0; i < GIT_OBJECT_ID_SIZE; ++i) {
+        s32 high = parse_hex_digit(hex[i * 2]);
+        s32 low  = high >= 0 ? parse_hex_digit(hex[i * 2 + 1]) : -1;
+        if(low < 0) return false;
+        id->bytes[i] = (u8) ((high << 4) | low);
+    }
+    return true;
+}
+
+static
+void format_git_object_id(Git_Object_Id *id, char hex[GIT_OBJECT_ID_SIZE * 2 + 1]) {
+    for(s64 i = 0; i < GIT_OBJECT_ID_SIZE; ++i) sprintf(&hex[i * 2], "%02x", id->bytes[i]);
+}
+
+
+
+/* ------------------------------------------------- Objects ------------------------------------------------- */
+
+static
+b8 find_packed_git_object(Git_Repository *repository, Git_Object_Id *id, Git_Pack **found_pack, s64 *found_offset) {
+    for(Git_Pack *pack = repository->first_pack; pack != NULL; pack = pack->next) {
+        //
+        // Version 2 index layout: header, 256 fanout entries, the sorted object ids, their crc32 checksums,
+        // their 31-bit offsets, and finally 64-bit offsets for large packs.
+        //
+        u8 *fanout  = pack->index + 8;
+        u8 *ids     = fanout + 256 * 4;
+        u8 *offsets = ids + (s64) pack->object_count * (GIT_OBJECT_ID_SIZE + 4);
+
+        s64 low  = id->bytes[0] ? read_big_endian_u32(fanout + (id->bytes[0] - 1) * 4) : 0;
+        s64 high = read_big_endian_u32(fanout + id->bytes[0] * 4);
+
+        while(low < high) {
+            s64 middle = low + (high - low) / 2;
+            s32 order  = memcmp(ids + middle * GIT_OBJECT_ID_SIZE, id->bytes, GIT_OBJECT_ID_SIZE);
+
+            if(order == 0) {
+                u32 offset = read_big_endian_u32(offsets + middle * 4);
+                if(offset & 0x80000000) {
+                    u8 *large_offset = offsets + (s64) pack->object_count * 4 + (s64) (offset & 0x7fffffff) * 8;
+                    *found_offset = ((s64) read_big_endian_u32(large_offset) << 32) | read_big_endian_u32(large_offset + 4);
+                } else {
+                    *found_offset = offset;
+                }
+
+                *found_pack = pack;
+                return true;
+            } else if(order < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+    }
+
+    return false;
+}
+
+static
+b8 apply_git_delta(u8 *base, s64 base_size, u8 *delta, s64 delta_size, Git_Buffer *output) {
+    u8 *end = delta + delta_size;
+
+    // The delta starts with the size of the base and the size of the result.
+    s64 sizes[2] = { 0, 0 };
+    for(s64 i = 0; i < 2; ++i) {
+        s64 shift = 0;
+        u8 byte;
+        do {
+            if(delta == end || shift > 56) return false; // Truncated, or more than fits into a size
+            byte = *delta++;
+            sizes[i] |= (s64) (byte & 0x7f) << shift;
+            shift += 7;
+        } while(byte & 0x80);
+    }
+
+    if(sizes[0] != base_size) return false;
+
+    output->size = 0;
+    reserve_git_buffer(output, sizes[1]);
+
+    while(delta < end) {
+        u8 instruction = *delta++;
+
+        if(instruction & 0x80) {
+            //
+            // Copy a range from the base. The bits of the instruction tell us which bytes of the offset
+            // and size are present.
+            //
+            if(end - delta < os_count_set_bits(instruction & 0x7f)) return false; // The instruction was cut off
+
+            s64 offset = 0, size = 0;
+            for(s64 i = 0; i < 4; ++i) if(instruction & (1 << i))       offset |= (s64) *delta++ << (i * 8);
+            for(s64 i = 0; i < 3; ++i) if(instruction & (1 << (4 + i))) size   |= (s64) *delta++ << (i * 8);
+            if(size == 0) size = 0x10000;
+
+            if(offset > base_size - size || output->size + size > sizes[1]) return false;
+            memcpy(&output->data[output->size], &base[offset], size);
+            output->size += size;
+        } else if(instruction) {
+            // Insert the literal bytes that follow.
+            if(end - delta < instruction || output->size + instruction > sizes[1]) return false;
+            memcpy(&output->data[output->size], delta, instruction);
+            output->size += instruction;
+            delta += instruction;
+        } else {
+            return false; // Reserved
+        }
+    }
+
+    return output->size == sizes[1];
+}
+
+static b8 read_git_object(Git_Reader *reader, Git_Object_Id *id, Git_Object_Type *type, Git_Buffer *output);
+
+static
+b8 read_packed_git_object(Git_Reader *reader, Git_Pack *pack, s64 offset, Git_Object_Type *type, Git_Buffer *output, b8 is_delta_base) {
+    //
+    // Delta chains often share their bases, so we keep the recently resolved bases around.
+    //
+    Git_Delta_Cache_Entry *cache_entry = &reader->delta_cache[(offset ^ ((u64) pack >> 4)) & (GIT_DELTA_CACHE_SIZE - 1)];
+    if(cache_entry->pack == pack && cache_entry->offset == offset) {
+        output->size = 0;
+        reserve_git_buffer(output, cache_entry->content.size);
+        memcpy(output->data, cache_entry->content.data, cache_entry->content.size);
+        output->size = cache_entry->content.size;
+        *type = cache_entry->type;
+        return true;
+    }
+
+    if(offset < 12 || offset >= pack->pack_size) return false;
+
+    u8 *pointer = pack->pack + offset;
+    u8 *end     = pack->pack + pack->pack_size;
+
+    //
+    // Parse the object header: 3 bits of type, and the variable-length size of the (inflated) object.
+    //
+    u8 byte = *pointer++;
+    Git_Object_Type object_type = (byte >> 4) & 7;
+    s64 size  = byte & 0x0f;
+    s64 shift = 4;
+    while((byte & 0x80) && pointer < end && shift <= 56) {
+        byte = *pointer++;
+        size |= (s64) (byte & 0x7f) << shift;
+        shift += 7;
+    }
+
+    b8 success = false;
+
+    switch(object_type) {
+    case GIT_OBJECT_Commit:
+    case GIT_OBJECT_Tree:
+    case GIT_OBJECT_Blob:
+    case GIT_OBJECT_Tag:
+        success = inflate_zlib_stream(pointer, end - pointer, output, size) && output->size == size;
+        *type   = object_type;
+        break;
+
+    case GIT_OBJECT_Ofs_Delta:
+    case GIT_OBJECT_Ref_Delta: {
+        Git_Buffer base  = { 0 };
+        Git_Buffer delta = { 0 };
+
+        if(object_type == GIT_OBJECT_Ofs_Delta) {
+            // The base is stored in this pack at a negative offset to this object.
+            s64 base_distance = 0;
+            s64 distance_bytes = 0;
+            do {
+                if(pointer == end || ++distance_bytes > 8) break;
+                byte = *pointer++;
+                base_distance = distance_bytes > 1 ? ((base_distance + 1) << 7) | (byte & 0x7f) : byte & 0x7f;
+            } while(byte & 0x80);
+
+            // A base that doesn't lie before this object would be a cycle.
+            success = !(byte & 0x80) && base_distance > 0 && base_distance <= offset && read_packed_git_object(reader, pack, offset - base_distance, type, &base, true);
+        } else if(end - pointer > GIT_OBJECT_ID_SIZE) {
+            // The base is referenced by its id, and may live anywhere.
+            Git_Object_Id base_id;
+            memcpy(base_id.bytes, pointer, GIT_OBJECT_ID_SIZE);
+            pointer += GIT_OBJECT_ID_SIZE;
+            success = read_git_object(reader, &base_id, type, &base);
+        }
+
+        success = success && inflate_zlib_stream(pointer, end - pointer, &delta, size) && delta.size == size;
+        success = success && apply_git_delta(base.data, base.size, delta.data, delta.size, output);
+        free_git_buffer(&base);
+        free_git_buffer(&delta);
+    } break;
+
+    default: break;
+    }
+
+    if(success && is_delta_base && output->size <= 256 * 1024) {
+        cache_entry->pack   = pack;
+        cache_entry->offset = offset;
+        cache_entry->type   = *type;
+        reserve_git_buffer(&cache_entry->content, output->size);
+        memcpy(cache_entry->content.data, output->data, output->size);
+        cache_entry->content.size = output->size;
+    }
+
+    return success;
+}
+
+static
+b8 read_loose_git_object(Git_Reader *reader, Git_Object_Id *id, Git_Object_Type *type, Git_Buffer *output) {
+    char hex[GIT_OBJECT_ID_SIZE * 2 + 1];
+    format_git_object_id(id, hex);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/objects/%.2s/%s", reader->repository->common_directory, hex, &hex[2]);
+
+    s64 compressed_size;
+    u8 *compressed = os_map_file(path, &compressed_size);
+    if(!compressed) return false;
+
+    b8 success = inflate_zlib_stream(compressed, compressed_size, output, compressed_size * 4);
+    os_unmap_file(compressed, compressed_size);
+    if(!success) return false;
+
+    //
+    // Loose objects start with a "<type> <size>\0" header, which we strip here.
+    //
+    u8 *header_end = memchr(output->data, 0, output->size);
+    if(!header_end) return false;
+
+    if(strncmp((char *) output->data, "blob ", 5) == 0) {
+        *type = GIT_OBJECT_Blob;
+    } else if(strncmp((char *) output->data, "tree ", 5) == 0) {
+        *type = GIT_OBJECT_Tree;
+    } else if(strncmp((char *) output->data, "commit ", 7) == 0) {
+        *type = GIT_OBJECT_Commit;
+    } else if(strncmp((char *) output->data, "tag ", 4) == 0) {
+        *type = GIT_OBJECT_Tag;
+    } else {
+        return false;
+    }
+
+    s64 header_size = header_end + 1 - output->data;
+    memmove(output->data, header_end + 1, output->size - header_size);
+    output->size -= header_size;
+    return true;
+}
+
+static
+b8 read_git_object(Git_Reader *reader, Git_Object_Id *id, Git_Object_Type *type, Git_Buffer *output) {
+    Git_Pack *pack;
+    s64 offset;
+
+    if(find_packed_git_object(reader->repository, id, &pack, &offset)) {
+        return read_packed_git_object(reader, pack, offset, type, output, false);
+    } else {
+        return read_loose_git_object(reader, id, type, output);
+    }
+}
+
+static
+void create_git_reader(Git_Reader *reader, Git_Repository *repository) {
+    memset(reader, 0, sizeof(Git_Reader));
+    reader->repository = repository;
+    for(s64 i = 0; i < GIT_DELTA_CACHE_SIZE; ++i) reader->delta_cache[i].offset = -1;
+}
+
+static
+void destroy_git_reader(Git_Reader *reader) {
+    free_git_buffer(&reader->compressed);
+    for(s64 i = 0; i < GIT_DELTA_CACHE_SIZE; ++i) free_git_buffer(&reader->delta_cache[i].content);
+}
+
+
+
+/* ------------------------------------------------ Revisions ------------------------------------------------ */
+
+static
+b8 find_git_object_by_prefix(Git_Repository *repository, char *prefix, Git_Object_Id *id) {
+    //
+    // Abbreviated object ids have to be unique over all packs and loose objects.
+    //
+    s64 prefix_length = strlen(prefix);
+    if(prefix_length < 4 || prefix_length >= GIT_OBJECT_ID_SIZE * 2) return false;
+
+    for(s64 i = 0; i < prefix_length; ++i) {
+        if(parse_hex_digit(prefix[i]) < 0) return false;
+    }
+
+    s64 match_count = 0;
+    Git_Object_Id match;
+
+    char padded[GIT_OBJECT_ID_SIZE * 2 + 1];
+    memset(padded, '0', GIT_OBJECT_ID_SIZE * 2);
+    padded[GIT_OBJECT_ID_SIZE * 2] = 0;
+    memcpy(padded, prefix, prefix_length);
+
+    Git_Object_Id lower_bound;
+    parse_git_object_id(padded, &lower_bound);
+
+    for(Git_Pack *pack = repository->first_pack; pack != NULL; pack = pack->next) {
+        u8 *ids = pack->index + 8 + 256 * 4;
+        for(s64 i = 0; i < pack->object_count; ++i) {
+            if(memcmp(ids + i * GIT_OBJECT_ID_SIZE, lower_bound.bytes, GIT_OBJECT_ID_SIZE) < 0) continue;
+
+            char hex[GIT_OBJECT_ID_SIZE * 2 + 1];
+            format_git_object_id((Git_Object_Id *) (ids + i * GIT_OBJECT_ID_SIZE), hex);
+            if(strncmp(hex, prefix, prefix_length) != 0) break;
+
+            if(match_count == 0 || memcmp(&match, ids + i * GIT_OBJECT_ID_SIZE, GIT_OBJECT_ID_SIZE) != 0) ++match_count;
+            memcpy(&match, ids + i * GIT_OBJECT_ID_SIZE, GIT_OBJECT_ID_SIZE);
+        }
+    }
+
+    s64 mark = mark_arena(&repository->cloc->scratch);
+    char *directory = aprint(&repository->cloc->scratch, "%s/objects/%.2s", repository->common_directory, prefix);
+    File_Iterator iterator = find_first_file(&repository->cloc->scratch, directory, false);
+
+    while(iterator.valid) {
+        if(iterator.kind == OS_PATH_Is_File && strlen(iterator.path) == GIT_OBJECT_ID_SIZE * 2 - 2 && strncmp(iterator.path, &prefix[2], prefix_length - 2) == 0) {
+            char hex[GIT_OBJECT_ID_SIZE * 2 + 1];
+            memcpy(hex, prefix, 2);
+            strcpy(&hex[2], iterator.path);
+
+            Git_Object_Id loose_id;
+            if(parse_git_object_id(hex, &loose_id) && (match_count == 0 || memcmp(&match, &loose_id, sizeof(Git_Object_Id)) != 0)) {
+                ++match_count;
+                match = loose_id;
+            }
+        }
+
+        find_next_file(&repository->cloc->scratch, &iterator);
+    }
+
+    close_file_iterator(&iterator);
+    reset_arena(&repository->cloc->scratch, mark);
+
+    if(match_count > 1) printf("[ERROR]: The abbreviated object id '%s' is ambiguous.\n", prefix);
+    if(match_count == 1) *id = match;
+    return match_count == 1;
+}
+
+static
+b8 resolve_git_ref_name(Git_Repository *repository, char *ref_name, Git_Object_Id *id, s64 depth) {
+    if(depth > 8) return false; // Symbolic ref loop
+
+    Cloc *cloc = repository->cloc;
+    s64 mark   = mark_arena(&cloc->scratch);
+    b8 success = false;
+
+    //
+    // Loose refs are plain files containing either an object id, or a reference to another ref.
+    // Linked worktrees have their own HEAD, but share all other refs with the main repository.
+    //
+    s64 content_size;
+    char *path = aprint(&cloc->scratch, "%s/%s", repository->git_directory, ref_name);
+    if(os_resolve_path_kind(path) != OS_PATH_Is_File) path = aprint(&cloc->scratch, "%s/%s", repository->common_directory, ref_name);
+    char *content = os_resolve_path_kind(path) == OS_PATH_Is_File ? os_map_file(path, &content_size) : NULL;
+
+    if(content) {
+        if(content_size > 5 && strncmp(content, "ref: ", 5) == 0) {
+            s64 target_length = 0;
+            while(5 + target_length < content_size && content[5 + target_length] != '\n' && content[5 + target_length] != '\r') ++target_length;
+            char *target = push_arena(&cloc->scratch, target_length + 1);
+            memcpy(target, &content[5], target_length);
+            target[target_length] = 0;
+            success = resolve_git_ref_name(repository, target, id, depth + 1);
+        } else if(content_size >= GIT_OBJECT_ID_SIZE * 2) {
+            success = parse_git_object_id(content, id);
+        }
+
+        os_unmap_file(content, content_size);
+    }
+
+    //
+    // Otherwise the ref may have been packed, in which case it's a "<id> <name>" line in the packed-refs.
+    //
+    if(!success && (content = os_map_file(aprint(&cloc->scratch, "%s/packed-refs", repository->common_directory), &content_size))) {
+        s64 ref_name_length = strlen(ref_name);
+        char *line = content;
+        char *end  = content + content_size;
+
+        while(line < end && !success) {
+            char *line_end = memchr(line, '\n', end - line);
+            if(!line_end) line_end = end;
+
+            s64 name_offset = GIT_OBJECT_ID_SIZE * 2 + 1;
+            if(line[0] != '#' && line[0] != '^' && line_end - line >= name_offset + ref_name_length && strncmp(&line[name_offset], ref_name, ref_name_length) == 0) {
+                char *name_end = &line[name_offset + ref_name_length];
+                if(name_end == line_end || *name_end == '\r') success = parse_git_object_id(line, id);
+            }
+
+            line = line_end + 1;
+        }
+
+        os_unmap_file(content, content_size);
+    }
+
+    reset_arena(&cloc->scratch, mark);
+    return success;
+}
+
+static
+b8 resolve_git_revision_base(Git_Repository *repository, char *name, Git_Object_Id *id) {
+    if(strlen(name) == GIT_OBJECT_ID_SIZE * 2 && parse_git_object_id(name, id)) return true;
+
+    //
+    // Try the same ref locations that git itself would try, in the same order.
+    //
+    const char *CANDIDATES[] = { "%s", "refs/%s", "refs/tags/%s", "refs/heads/%s", "refs/remotes/%s", "refs/remotes/%s/HEAD" };
+    const s64 CANDIDATE_COUNT = sizeof(CANDIDATES) / sizeof(CANDIDATES[0]);
+
+    for(s64 i = 0; i < CANDIDATE_COUNT; ++i) {
+        s64 mark = mark_arena(&repository->cloc->scratch);
+        b8 found = resolve_git_ref_name(repository, aprint(&repository->cloc->scratch, CANDIDATES[i], name), id, 0);
+        reset_arena(&repository->cloc->scratch, mark);
+        if(found) return true;
+    }
+
+    return find_git_object_by_prefix(repository, name, id);
+}
+
+static
+b8 find_git_object_header_id(Git_Buffer *content, const char *key, s64 index, Git_Object_Id *id) {
+    //
+    // Commits and tags start with "<key> <id>" header lines. Returns the id of the index-th line with
+    // the given key.
+    //
+    s64 key_length = strlen(key);
+    char *line = (char *) content->data;
+    char *end  = line + content->size;
+
+    while(line < end && *line != '\n') {
+        char *line_end = memchr(line, '\n', end - line);
+        if(!line_end) line_end = end;
+
+        if(line_end - line >= key_length + 1 + GIT_OBJECT_ID_SIZE * 2 && strncmp(line, key, key_length) == 0 && line[key_length] == ' ') {
+            if(index == 0) return parse_git_object_id(&line[key_length + 1], id);
+            --index;
+        }
+
+        line = line_end + 1;
+    }
+
+    return false;
+}
+
+static
+b8 peel_git_object(Git_Repository *repository, Git_Object_Id *id, Git_Object_Type wanted_type, Git_Buffer *content) {
+    //
+    // Follow tags (and commits, if we want a tree) until we arrive at an object of the wanted type.
+    //
+    for(s64 depth = 0; depth < 16; ++depth) {
+        Git_Object_Type type;
+        if(!read_git_object(&repository->reader, id, &type, content)) return false;
+
+        if(type == wanted_type) return true;
+
+        if(type == GIT_OBJECT_Tag) {
+            if(!find_git_object_header_id(content, "object", 0, id)) return false;
+        } else if(type == GIT_OBJECT_Commit && wanted_type == GIT_OBJECT_Tree) {
+            if(!find_git_object_header_id(content, "tree", 0, id)) return false;
+        } else {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+static
+b8 resolve_git_revision(Git_Repository *repository, char *revision, Git_Object_Id *id) {
+    //
+    // A revision is a ref name or an (abbreviated) object id, followed by any number of "~<n>" (n-th
+    // first-parent ancestor) and "^<n>" (n-th parent) suffixes.
+    //
+    s64 base_length = strcspn(revision, "~^");
+    char *base = push_arena(&repository->cloc->scratch, base_length + 1);
+    memcpy(base, revision, base_length);
+    base[base_length] = 0;
+
+    if(!resolve_git_revision_base(repository, base, id)) return false;
+
+    Git_Buffer content = { 0 };
+    b8 success = true;
+    char *suffix = &revision[base_length];
+
+    while(*suffix && success) {
+        char operator = *suffix++;
+        s64 count = 1;
+        if(*suffix >= '0' && *suffix <= '9') count = strtol(suffix, &suffix, 10);
+
+        if(operator == '~') {
+            for(s64 i = 0; i < count && success; ++i) {
+                success = peel_git_object(repository, id, GIT_OBJECT_Commit, &content) && find_git_object_header_id(&content, "parent", 0, id);
+            }
+        } else if(operator == '^' && count > 0) {
+            success = peel_git_object(repository, id, GIT_OBJECT_Commit, &content) && find_git_object_header_id(&content, "parent", count - 1, id);
+        } else if(operator != '^') {
+            success = false;
+        }
+    }
+
+    free_git_buffer(&content);
+    return success;
+}
+
+
+
+/* -------------------------------------------------- Trees -------------------------------------------------- */
+
+static
+Git_Blob *get_or_create_git_blob(Git_Repository *repository, Git_Object_Id *id, Language language) {
+    Git_Blob *blob = git_object_table_query(&repository->blobs, id, (u8) language);
+    if(blob) return blob;
+
+    blob = push_arena(&repository->arena, sizeof(Git_Blob));
+    memset(blob, 0, sizeof(Git_Blob));
+    blob->id       = *id;
+    blob->language = language;
+    blob->next     = repository->first_blob;
+    repository->first_blob = blob;
+    repository->next_blob  = blob;
+    ++repository->blob_count;
+
+    git_object_table_insert(&repository->blobs, id, (u8) language, blob);
+    return blob;
+}
+
+static
+Git_Tree *load_git_tree(Git_Repository *repository, Git_Object_Id *id) {
+    Git_Tree *tree = git_object_table_query(&repository->trees, id, 0);
+    if(tree) return tree;
+
+    Git_Buffer content = { 0 };
+    Git_Object_Type type;
+    if(!read_git_object(&repository->reader, id, &type, &content) || type != GIT_OBJECT_Tree) {
+        char hex[GIT_OBJECT_ID_SIZE * 2 + 1];
+        format_git_object_id(id, hex);
+        printf("[WARNING]: Failed to read the tree '%s'.\n", hex);
+        free_git_buffer(&content);
+        return NULL;
+    }
+
+    tree = push_arena(&repository->arena, sizeof(Git_Tree));
+    memset(tree, 0, sizeof(Git_Tree));
+    tree->id = *id;
+    git_object_table_insert(&repository->trees, id, 0, tree);
+
+    //
+    // Every entry is "<octal mode> <name>\0<binary id>". We only care about directories and regular files,
+    // and skip symlinks and submodules.
+    //
+    Git_Tree_Entry **next_entry = &tree->first_entry;
+    u8 *pointer = content.data;
+    u8 *end     = content.data + content.size;
+
+    while(pointer < end) {
+        u32 mode = 0;
+        while(pointer < end && *pointer != ' ') mode = (mode << 3) | (*pointer++ - '0');
+        char *name = (char *) ++pointer;
+        while(pointer < end && *pointer) ++pointer;
+        if(end - pointer < 1 + GIT_OBJECT_ID_SIZE) break;
+        Git_Object_Id *entry_id = (Git_Object_Id *) ++pointer;
+        pointer += GIT_OBJECT_ID_SIZE;
+
+        b8 is_directory = (mode >> 12) == 004;
+        b8 is_file      = (mode >> 12) == 010;
+        if(!is_directory && !is_file) continue;
+        if(is_directory && string_list_contains(repository->cloc->excluded_directories, name)) continue;
+
+        Language language = is_file ? get_language_for_file_path(name) : LANGUAGE_COUNT;
+        if(is_file && language == LANGUAGE_COUNT) continue; // Unrecognized language, ignore
+
+        Git_Tree_Entry *entry = push_arena(&repository->arena, sizeof(Git_Tree_Entry));
+        memset(entry, 0, sizeof(Git_Tree_Entry));
+        entry->id   = *entry_id;
+        entry->name = push_string(&repository->arena, name);
+        if(is_file) entry->blob = get_or_create_git_blob(repository, entry_id, language);
+
+        *next_entry = entry;
+        next_entry  = &entry->next;
+    }
+
+    free_git_buffer(&content);
+
+    // Subtrees are only loaded now, since we were still parsing this tree's content.
+    for(Git_Tree_Entry *entry = tree->first_entry; entry != NULL; entry = entry->next) {
+        if(!entry->blob) entry->tree = load_git_tree(repository, &entry->id);
+    }
+
+    return tree;
+}
+
+static
+void compute_git_tree_stats(Git_Tree *tree) {
+    if(tree->stats_computed) return;
+
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) tree->language_stats[i].ident = LANGUAGE_STRINGS[i];
+
+    for(Git_Tree_Entry *entry = tree->first_entry; entry != NULL; entry = entry->next) {
+        if(entry->tree) {
+            compute_git_tree_stats(entry->tree);
+            for(s64 i = 0; i < LANGUAGE_COUNT; ++i) combine_stats(&tree->language_stats[i], &entry->tree->language_stats[i]);
+        } else if(entry->blob) {
+            combine_stats(&tree->language_stats[entry->blob->language], &entry->blob->stats);
+        }
+    }
+
+    tree->stats_computed = true;
+}
+
+
+
+/* ------------------------------------------------ Repository ------------------------------------------------ */
+
+static
+char *find_git_directory(Cloc *cloc, char *path) {
+    //
+    // Walk up from the given path until we find a '.git' directory (or a '.git' file pointing to one, as
+    // used by worktrees), or a bare repository.
+    //
+    if(os_resolve_path_kind(path) != OS_PATH_Is_Directory) return NULL;
+
+    char *directory = os_make_absolute_path(&cloc->scratch, path);
+
+    while(true) {
+        char *candidate = combine_file_paths(cloc, directory, ".git");
+        OS_Path_Kind kind = os_resolve_path_kind(candidate);
+
+        if(kind == OS_PATH_Is_Directory) return candidate;
+
+        if(kind == OS_PATH_Is_File) {
+            s64 size;
+            char *content = os_map_file(candidate, &size);
+            if(content && size > 8 && strncmp(content, "gitdir: ", 8) == 0) {
+                s64 length = 0;
+                while(8 + length < size && content[8 + length] != '\n' && content[8 + length] != '\r') ++length;
+                char *target = push_arena(&cloc->scratch, length + 1);
+                memcpy(target, &content[8], length);
+                target[length] = 0;
+                os_unmap_file(content, size);
+
+                b8 is_absolute = target[0] == '/' || target[0] == '\\' || (target[0] && target[1] == ':');
+                return is_absolute ? target : combine_file_paths(cloc, directory, target);
+            }
+
+            if(content) os_unmap_file(content, size);
+        }
+
+        if(os_resolve_path_kind(combine_file_paths(cloc, directory, "objects")) == OS_PATH_Is_Directory &&
+           os_resolve_path_kind(combine_file_paths(cloc, directory, "HEAD")) == OS_PATH_Is_File) {
+            return directory; // Bare repository
+        }
+
+        s64 length = strlen(directory);
+        while(length > 0 && directory[length - 1] != '/' && directory[length - 1] != '\\') --length;
+        if(length <= 1) return NULL;
+        directory[length - 1] = 0;
+    }
+}
+
+static
+void load_git_packs(Git_Repository *repository) {
+    Cloc *cloc = repository->cloc;
+    s64 mark   = mark_arena(&cloc->scratch);
+
+    char *pack_directory = aprint(&cloc->scratch, "%s/objects/pack", repository->common_directory);
+    File_Iterator iterator = find_first_file(&cloc->scratch, pack_directory, false);
+
+    while(iterator.valid) {
+        s64 length = strlen(iterator.path);
+
+        if(iterator.kind == OS_PATH_Is_File && length > 4 && strcmp(&iterator.path[length - 4], ".idx") == 0) {
+            char *index_path = combine_file_paths(cloc, pack_directory, iterator.path);
+            char *pack_path  = push_string(&cloc->scratch, index_path);
+            strcpy(&pack_path[strlen(pack_path) - 4], ".pack");
+
+            Git_Pack pack = { 0 };
+            pack.index = os_map_file(index_path, &pack.index_size);
+            pack.pack  = os_map_file(pack_path, &pack.pack_size);
+
+            b8 valid = pack.index && pack.pack && pack.index_size >= 8 + 256 * 4 && memcmp(pack.index, "\377tOc", 4) == 0 && read_big_endian_u32(pack.index + 4) == 2;
+            if(valid) {
+                pack.object_count = read_big_endian_u32(pack.index + 8 + 255 * 4);
+                Git_Pack *entry   = push_arena(&repository->arena, sizeof(Git_Pack));
+                *entry = pack;
+                entry->next = repository->first_pack;
+                repository->first_pack = entry;
+            } else {
+                printf("[WARNING]: Ignoring the unsupported pack index '%s'.\n", index_path);
+                if(pack.index) os_unmap_file(pack.index, pack.index_size);
+                if(pack.pack)  os_unmap_file(pack.pack, pack.pack_size);
+            }
+        }
+
+        find_next_file(&cloc->scratch, &iterator);
+    }
+
+    close_file_iterator(&iterator);
+    reset_arena(&cloc->scratch, mark);
+}
+
+Git_Repository *open_git_repository(Cloc *cloc, char *path) {
+    s64 mark = mark_arena(&cloc->scratch);
+    char *git_directory = find_git_directory(cloc, path);
+
+    if(!git_directory) {
+        printf("[ERROR]: The path '%s' is not inside a git repository.\n", path);
+        reset_arena(&cloc->scratch, mark);
+        return NULL;
+    }
+
+    Git_Repository *repository = calloc(1, sizeof(Git_Repository));
+    repository->cloc = cloc;
+    create_arena(&repository->arena, GIT_ARENA_SIZE);
+    create_git_object_table(&repository->trees);
+    create_git_object_table(&repository->blobs);
+    create_git_reader(&repository->reader, repository);
+    repository->git_directory    = push_string(&repository->arena, git_directory);
+    repository->common_directory = repository->git_directory;
+
+    //
+    // Linked worktrees keep their objects and shared refs in the common directory of the main repository.
+    //
+    s64 size;
+    char *common_directory = os_map_file(combine_file_paths(cloc, git_directory, "commondir"), &size);
+    if(common_directory) {
+        s64 length = size;
+        while(length > 0 && (common_directory[length - 1] == '\n' || common_directory[length - 1] == '\r')) --length;
+        char *target = push_arena(&cloc->scratch, length + 1);
+        memcpy(target, common_directory, length);
+        target[length] = 0;
+        os_unmap_file(common_directory, size);
+
+        b8 is_absolute = target[0] == '/' || target[0] == '\\' || (target[0] && target[1] == ':');
+        repository->common_directory = push_string(&repository->arena, is_absolute ? target : combine_file_paths(cloc, git_directory, target));
+    }
+
+    reset_arena(&cloc->scratch, mark);
+    load_git_packs(repository);
+    return repository;
+}
+
+b8 register_git_revision(Git_Repository *repository, char *name) {
+    Cloc *cloc = repository->cloc;
+    s64 mark   = mark_arena(&cloc->scratch);
+
+    Git_Revision *revision = push_arena(&repository->arena, sizeof(Git_Revision));
+    memset(revision, 0, sizeof(Git_Revision));
+    revision->name = name;
+
+    Git_Object_Id tree_id;
+    Git_Buffer content = { 0 };
+    b8 success = resolve_git_revision(repository, name, &revision->commit_id);
+    tree_id = revision->commit_id;
+    success = success && peel_git_object(repository, &tree_id, GIT_OBJECT_Tree, &content);
+    free_git_buffer(&content);
+
+    if(success) revision->tree = load_git_tree(repository, &tree_id);
+
+    reset_arena(&cloc->scratch, mark);
+
+    if(!revision->tree) {
+        printf("[ERROR]: Failed to resolve the revision '%s'.\n", name);
+        return false;
+    }
+
+    if(repository->last_revision) {
+        repository->last_revision->next = revision;
+    } else {
+        repository->first_revision = revision;
+    }
+    repository->last_revision = revision;
+
+    cloc->file_count = repository->blob_count;
+    return true;
+}
+
+void close_git_repository(Git_Repository *repository) {
+    for(Git_Pack *pack = repository->first_pack; pack != NULL; pack = pack->next) {
+        os_unmap_file(pack->index, pack->index_size);
+        os_unmap_file(pack->pack, pack->pack_size);
+    }
+
+    destroy_git_reader(&repository->reader);
+    destroy_git_object_table(&repository->trees);
+    destroy_git_object_table(&repository->blobs);
+    destroy_arena(&repository->arena);
+    free(repository);
+}
+
+
+
+/* ------------------------------------------------- Worker ------------------------------------------------- */
+
+static
+Git_Blob *get_next_git_blob_to_parse(Git_Repository *repository) {
+#if USE_CAS
+    Git_Blob *current;
+
+    do {
+        current  = repository->next_blob;
+    } while(current != NULL && current != os_compare_and_swap((void *volatile *) &repository->next_blob, current->next, current));
+
+    return current;
+#else
+    if(repository->next_blob == NULL) return NULL;
+
+    Git_Blob *current = repository->next_blob;
+    repository->next_blob = current->next;
+    return current;
+#endif
+}
+
+int git_worker_thread(Worker *worker) {
+    Git_Repository *repository = worker->cloc->git_repository;
+
+    Git_Reader reader;
+    create_git_reader(&reader, repository);
+
+    Git_Buffer content = { 0 };
+
+    Git_Blob *blob;
+    while((blob = get_next_git_blob_to_parse(repository))) {
+        Git_Object_Type type;
+        if(read_git_object(&reader, &blob->id, &type, &content) && type == GIT_OBJECT_Blob) {
+            count_buffer(&blob->stats, blob->language, (char *) content.data, content.size);
+        } else {
+            char hex[GIT_OBJECT_ID_SIZE * 2 + 1];
+            format_git_object_id(&blob->id, hex);
+            printf("[WARNING]: Failed to read the blob '%s'.\n", hex);
+        }
+
+        blob->stats.file_count = 1;
+    }
+
+    free_git_buffer(&content);
+    destroy_git_reader(&reader);
+    return 0;
+}
+
+
+
+/* ------------------------------------------------- Output ------------------------------------------------- */
+
+static
+void collect_git_file_stats(Git_Repository *repository, Git_Tree *tree, char *directory_path, Stats *stats, s64 *stat_count) {
+    for(Git_Tree_Entry *entry = tree->first_entry; entry != NULL; entry = entry->next) {
+        char *path = directory_path ? aprint(&repository->arena, "%s/%s", directory_path, entry->name) : entry->name;
+
+        if(entry->tree) {
+            collect_git_file_stats(repository, entry->tree, path, stats, stat_count);
+        } else if(entry->blob) {
+            stats[*stat_count] = entry->blob->stats;
+            stats[*stat_count].ident = path;
+            ++*stat_count;
+        }
+    }
+}
+
+static
+s64 count_git_tree_files(Git_Tree *tree) {
+    s64 count = 0;
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) count += tree->language_stats[i].file_count;
+    return count;
+}
+
+Stats print_git_tables(Cloc *cloc) {
+    Git_Repository *repository = cloc->git_repository;
+
+    for(Git_Revision *revision = repository->first_revision; revision != NULL; revision = revision->next) {
+        char hex[GIT_OBJECT_ID_SIZE * 2 + 1];
+        format_git_object_id(&revision->commit_id, hex);
+        print_separator_line(cloc, aprint(&cloc->scratch, "%s (%.10s)", revision->name, hex));
+
+        compute_git_tree_stats(revision->tree);
+
+        switch(cloc->output_mode) {
+        case OUTPUT_By_File: {
+            s64 arena_mark = mark_arena(&repository->arena);
+            s64 stat_count = 0;
+            Stats *stats   = push_arena(&repository->arena, count_git_tree_files(revision->tree) * sizeof(Stats));
+            collect_git_file_stats(repository, revision->tree, NULL, stats, &stat_count);
+            print_file_stats_table(cloc, stats, stat_count, true);
+            reset_arena(&repository->arena, arena_mark);
+        } break;
+
+        case OUTPUT_By_Language:
+            print_language_stats_table(cloc, revision->tree->language_stats);
+            break;
+        }
+    }
+
+    //
+    // The throughput is measured over the work we actually did, which is every distinct blob once.
+    //
+    Stats total_stats = { 0 };
+    for(Git_Blob *blob = repository->first_blob; blob != NULL; blob = blob->next) combine_stats(&total_stats, &blob->stats);
+    return total_stats;
+}
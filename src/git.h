@@ -0,0 +1,115 @@
+#define GIT_OBJECT_ID_SIZE 20
+#define GIT_ARENA_SIZE 256 * 1024 * 1024
+#define GIT_DELTA_CACHE_SIZE 256
+
+typedef enum Git_Object_Type {
+    GIT_OBJECT_None      = 0,
+    GIT_OBJECT_Commit    = 1,
+    GIT_OBJECT_Tree      = 2,
+    GIT_OBJECT_Blob      = 3,
+    GIT_OBJECT_Tag       = 4,
+    GIT_OBJECT_Ofs_Delta = 6,
+    GIT_OBJECT_Ref_Delta = 7,
+} Git_Object_Type;
+
+typedef struct Git_Object_Id {
+    u8 bytes[GIT_OBJECT_ID_SIZE];
+} Git_Object_Id;
+
+typedef struct Git_Buffer {
+    u8 *data;
+    s64 size;
+    s64 capacity;
+} Git_Buffer;
+
+typedef struct Git_Pack {
+    struct Git_Pack *next;
+    u8 *index;
+    s64 index_size;
+    u8 *pack;
+    s64 pack_size;
+    u32 object_count;
+} Git_Pack;
+
+typedef struct Git_Delta_Cache_Entry {
+    Git_Pack *pack;
+    s64 offset;
+    Git_Object_Type type;
+    Git_Buffer content;
+} Git_Delta_Cache_Entry;
+
+// Every thread that reads objects needs its own reader, since decompressing objects needs scratch buffers
+// and a cache of recently used delta bases.
+typedef struct Git_Reader {
+    struct Git_Repository *repository;
+    Git_Buffer compressed;
+    Git_Delta_Cache_Entry delta_cache[GIT_DELTA_CACHE_SIZE];
+} Git_Reader;
+
+// Blobs are memoized by their object id (and the language we parse them with), so that a blob that appears
+// in many revisions or under many paths is only counted once.
+typedef struct Git_Blob {
+    Git_Object_Id id;
+    Language language;
+    struct Git_Blob *next;
+    Stats stats;
+} Git_Blob;
+
+typedef struct Git_Tree_Entry {
+    struct Git_Tree_Entry *next;
+    Git_Object_Id id;
+    char *name;
+    struct Git_Tree *tree; // Set for subdirectories
+    Git_Blob *blob;        // Set for files
+} Git_Tree_Entry;
+
+// Trees are memoized the same way, so that unchanged subdirectories are only walked once over all revisions.
+typedef struct Git_Tree {
+    Git_Object_Id id;
+    Git_Tree_Entry *first_entry;
+    Stats language_stats[LANGUAGE_COUNT];
+    b8 stats_computed;
+} Git_Tree;
+
+typedef struct Git_Revision {
+    struct Git_Revision *next;
+    char *name;
+    Git_Object_Id commit_id;
+    Git_Tree *tree;
+} Git_Revision;
+
+typedef struct Git_Object_Table_Entry {
+    Git_Object_Id id;
+    u8 tag;
+    void *value;
+} Git_Object_Table_Entry;
+
+typedef struct Git_Object_Table {
+    Git_Object_Table_Entry *entries;
+    s64 count;
+    s64 capacity; // Always a power of two
+} Git_Object_Table;
+
+typedef struct Git_Repository {
+    struct Cloc *cloc;
+    Arena arena;
+    char *git_directory;
+    char *common_directory; // Differs from the git directory for linked worktrees
+    Git_Pack *first_pack;
+    Git_Reader reader; // Used on the main thread for commits and trees
+
+    Git_Object_Table trees;
+    Git_Object_Table blobs;
+
+    Git_Revision *first_revision;
+    Git_Revision *last_revision;
+    Git_Blob *first_blob;
+    Git_Blob *next_blob;
+    s64 blob_count;
+} Git_Repository;
+
+Git_Repository *open_git_repository(struct Cloc *cloc, char *path);
+b8 register_git_revision(Git_Repository *repository, char *revision);
+void close_git_repository(Git_Repository *repository);
+int git_worker_thread(Worker *worker);
+Stats print_git_tables(struct Cloc *cloc);
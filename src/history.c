@@ -0,0 +1,410 @@
+static const char *HISTORY_COLUMN_NAMES[HISTORY_COLUMN_COUNT]   = { "files", "empty", "comment", "code" };
+static const char *HISTORY_COLUMN_HEADERS[HISTORY_COLUMN_COUNT] = { "Files", "Empty", "Comment", "Code" };
+
+static
+s64 get_history_column(Stats *stats, s64 column) {
+    switch(column) {
+    case 0:  return stats->file_count;
+    case 1:  return stats->blank;
+    case 2:  return stats->comment;
+    default: return stats->code;
+    }
+}
+
+static
+s64 find_history_series(char *catalog, s64 size, const char *name) {
+    s64 index = 0;
+    s64 name_length = strlen(name);
+
+    for(s64 offset = 0; offset < size; ++index) {
+        char *end = memchr(&catalog[offset], '\n', size - offset);
+        s64 length = end ? end - &catalog[offset] : size - offset;
+        if(length == name_length && memcmp(&catalog[offset], name, length) == 0) return index;
+        offset += length + 1;
+    }
+
+    return -1;
+}
+
+static
+s64 count_history_runs(char *runs_path, b8 *valid) {
+    s64 size;
+    u8 *data = os_map_file(runs_path, &size);
+    if(!data) {
+        *valid = true; // A new store
+        return 0;
+    }
+
+    Partial_Reader reader = { data, size, HISTORY_MAGIC_SIZE, size >= HISTORY_MAGIC_SIZE && memcmp(data, HISTORY_MAGIC, HISTORY_MAGIC_SIZE) == 0 };
+    u32 version     = read_partial_u32(&reader);
+    u32 record_size = read_partial_u32(&reader);
+    os_unmap_file(data, size);
+
+    *valid = reader.valid && version == HISTORY_VERSION && record_size == HISTORY_RECORD_SIZE;
+    return (size - HISTORY_HEADER_SIZE) / HISTORY_RECORD_SIZE; // An interrupted append may leave half a record
+}
+
+
+
+/* ------------------------------------------------- Recording ------------------------------------------------- */
+
+static
+s64 collect_history_series(Cloc *cloc, History_Series *series, b8 include_directories) {
+    //
+    // The same totals that the language table prints: sources, and generated files if they are reported.
+    //
+    s64 count = 0;
+    Stats sum = { 0 };
+
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+        Stats stats = cloc->totals.language_stats[FILE_Source][i];
+        if(cloc->report_generated) combine_stats(&stats, &cloc->totals.language_stats[FILE_Generated][i]);
+        series[count++] = (History_Series) { LANGUAGE_STRINGS[i], stats };
+        combine_stats(&sum, &stats);
+    }
+
+    series[count++] = (History_Series) { "SUM", sum };
+
+    if(!include_directories) return count;
+
+    //
+    // Every file is added to the top level directory it lives in, below the directory that all of them share.
+    //
+    Directory_Node *common_directory = NULL;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        common_directory = common_directory ? find_common_directory(common_directory, file->directory) : file->directory;
+    }
+
+    String_Table series_by_directory;
+    create_string_table(&series_by_directory, 64);
+
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        if(file->stats.file_count == 0 || (file->status != FILE_Source && !(file->status == FILE_Generated && cloc->report_generated))) continue;
+
+        Directory_Node *top = file->directory;
+        while(top != common_directory && top->parent != common_directory) top = top->parent;
+
+        char *name = "./";
+        if(top != common_directory) {
+            char *path = get_directory_path(&cloc->scratch, top);
+            name = aprint(&cloc->scratch, "%s/", &path[common_directory->path_length]);
+        }
+
+        s64 index = (s64) string_table_query(&series_by_directory, name);
+        if(!index) {
+            series[count] = (History_Series) { name, { 0 } };
+            index = ++count;
+            string_table_insert(&series_by_directory, name, (void *) index);
+        }
+
+        combine_stats(&series[index - 1].stats, &file->stats);
+    }
+
+    destroy_string_table(&series_by_directory);
+    return count;
+}
+
+static
+b8 read_latest_history_values(char *latest_path, s64 run_index, s64 *values, s64 value_count) {
+    //
+    // The snapshot can only be trusted if it describes exactly the committed runs. Every append invalidates it
+    // before touching any column, so an interrupted append always leaves it behind as stale.
+    //
+    s64 size;
+    u8 *data = os_map_file(latest_path, &size);
+    if(!data) return run_index == 0 && value_count == 0; // A new store
+
+    Partial_Reader reader = { data, size, 0, true };
+    b8 valid = read_partial_u64(&reader) == (u64) run_index && size == (s64) sizeof(u64) + value_count * (s64) sizeof(s64);
+    for(s64 i = 0; valid && i < value_count; ++i) values[i] = (s64) read_partial_u64(&reader);
+
+    os_unmap_file(data, size);
+    return valid;
+}
+
+static
+b8 invalidate_latest_history_values(char *latest_path) {
+    FILE *latest = fopen(latest_path, "r+b");
+    if(!latest) return true; // Nothing to invalidate
+
+    write_partial_u64(latest, ~(u64) 0);
+    b8 success = !ferror(latest);
+    if(fclose(latest) != 0) success = false;
+    return success;
+}
+
+static
+b8 write_history_value(char *column_path, s64 run_index, s64 value, s64 previous, b8 clean) {
+    //
+    // In a clean store the previous value is known, and only columns that changed are touched at all. Otherwise
+    // the last committed value is read from the column itself, and whatever an interrupted append left behind
+    // (at most one entry for this run, possibly cut off) is overwritten.
+    //
+    if(clean && value == previous) return true;
+
+    FILE *column = fopen(column_path, "r+b");
+    if(!column) column = fopen(column_path, "w+b");
+    if(!column) return false;
+
+    fseek(column, 0, SEEK_END);
+    s64 size     = ftell(column);
+    s64 position = size / HISTORY_ENTRY_SIZE * HISTORY_ENTRY_SIZE;
+
+    if(!clean) {
+        u8 tail[2 * HISTORY_ENTRY_SIZE];
+        s64 tail_size = min(position, 2 * HISTORY_ENTRY_SIZE);
+        fseek(column, position - tail_size, SEEK_SET);
+        Partial_Reader reader = { tail, tail_size, 0, (s64) fread(tail, 1, tail_size, column) == tail_size };
+
+        s64 tail_start = position - tail_size;
+        for(s64 offset = 0; reader.valid && offset < tail_size; offset += HISTORY_ENTRY_SIZE) {
+            s64 run   = (s64) read_partial_u64(&reader);
+            s64 entry = (s64) read_partial_u64(&reader);
+            if(run >= run_index) {
+                position = tail_start + offset;
+                break;
+            }
+
+            previous = entry;
+        }
+
+        if(value == previous && size == position) {
+            fclose(column);
+            return true;
+        }
+    }
+
+    fseek(column, position, SEEK_SET);
+    write_partial_u64(column, run_index);
+    write_partial_u64(column, value);
+
+    b8 success = !ferror(column);
+    if(fclose(column) != 0) success = false;
+    return success;
+}
+
+b8 record_history(Cloc *cloc, char *store_path, char *label, b8 include_directories) {
+    s64 mark = mark_arena(&cloc->scratch);
+    char *runs_path    = aprint(&cloc->scratch, "%s/runs", store_path);
+    char *catalog_path = aprint(&cloc->scratch, "%s/series", store_path);
+    char *latest_path  = aprint(&cloc->scratch, "%s/latest", store_path);
+
+    b8 valid;
+    s64 run_index = count_history_runs(runs_path, &valid);
+    if(!os_create_directory(store_path) || !valid) {
+        printf("[ERROR]: The history store '%s' cannot be created, or is not a valid store.\n", store_path);
+        reset_arena(&cloc->scratch, mark);
+        return false;
+    }
+
+    History_Series *series = push_arena(&cloc->scratch, (LANGUAGE_COUNT + 1 + (include_directories ? cloc->file_count : 0)) * sizeof(History_Series));
+    s64 series_count = collect_history_series(cloc, series, include_directories);
+
+    //
+    // Look up the series by name in a copy of the catalog, in which every name is terminated.
+    //
+    s64 catalog_size = 0;
+    char *catalog = os_map_file(catalog_path, &catalog_size);
+    char *names   = push_arena(&cloc->scratch, catalog_size + 1);
+    if(catalog) memcpy(names, catalog, catalog_size);
+    if(catalog) os_unmap_file(catalog, catalog_size);
+
+    String_Table series_by_name;
+    create_string_table(&series_by_name, 64);
+
+    s64 catalog_count = 0;
+    for(s64 offset = 0; offset < catalog_size; ) {
+        char *end = memchr(&names[offset], '\n', catalog_size - offset);
+        s64 length = end ? end - &names[offset] : catalog_size - offset;
+        names[offset + length] = 0;
+        string_table_insert(&series_by_name, &names[offset], (void *) ++catalog_count);
+        offset += length + 1;
+    }
+
+    s64 value_capacity = (catalog_count + series_count) * HISTORY_COLUMN_COUNT;
+    s64 *values   = push_arena(&cloc->scratch, value_capacity * sizeof(s64));
+    s64 *previous = push_arena(&cloc->scratch, value_capacity * sizeof(s64));
+    memset(values, 0, value_capacity * sizeof(s64));
+    memset(previous, 0, value_capacity * sizeof(s64));
+
+    b8 clean   = read_latest_history_values(latest_path, run_index, previous, catalog_count * HISTORY_COLUMN_COUNT);
+    b8 success = invalidate_latest_history_values(latest_path);
+
+    //
+    // Register the new series, then write every column whose value differs from the last run, including the
+    // ones of series that didn't show up in this run and went back to zero.
+    //
+    FILE *catalog_file = NULL;
+
+    for(s64 i = 0; success && i < series_count; ++i) {
+        s64 index = (s64) string_table_query(&series_by_name, series[i].name) - 1;
+        if(index < 0) {
+            if(!catalog_file) catalog_file = fopen(catalog_path, "ab");
+            if(!catalog_file) {
+                success = false;
+                break;
+            }
+
+            fprintf(catalog_file, "%s\n", series[i].name);
+            index = catalog_count++;
+            string_table_insert(&series_by_name, series[i].name, (void *) catalog_count);
+        }
+
+        for(s64 j = 0; j < HISTORY_COLUMN_COUNT; ++j) values[index * HISTORY_COLUMN_COUNT + j] = get_history_column(&series[i].stats, j);
+    }
+
+    destroy_string_table(&series_by_name);
+    if(catalog_file && fclose(catalog_file) != 0) success = false;
+
+    for(s64 i = 0; success && i < catalog_count; ++i) {
+        for(s64 j = 0; success && j < HISTORY_COLUMN_COUNT; ++j) {
+            s64 k = i * HISTORY_COLUMN_COUNT + j;
+            if(clean && values[k] == previous[k]) continue; // Don't even build the path
+
+            char *column_path = aprint(&cloc->scratch, "%s/%" PRId64 ".%s", store_path, i, HISTORY_COLUMN_NAMES[j]);
+            success = write_history_value(column_path, run_index, values[k], previous[k], clean);
+        }
+    }
+
+    //
+    // The snapshot for the next run, and then the record of the run, which comes last so that readers never
+    // see a run whose columns are incomplete.
+    //
+    FILE *latest = success ? fopen(latest_path, "wb") : NULL;
+    if(latest) {
+        write_partial_u64(latest, run_index + 1);
+        for(s64 i = 0; i < catalog_count * HISTORY_COLUMN_COUNT; ++i) write_partial_u64(latest, values[i]);
+
+        success = !ferror(latest);
+        if(fclose(latest) != 0) success = false;
+    } else {
+        success = false;
+    }
+
+    FILE *runs = success ? fopen(runs_path, run_index ? "r+b" : "wb") : NULL;
+    if(runs) {
+        if(run_index == 0) {
+            fwrite(HISTORY_MAGIC, 1, HISTORY_MAGIC_SIZE, runs);
+            write_partial_u32(runs, HISTORY_VERSION);
+            write_partial_u32(runs, HISTORY_RECORD_SIZE);
+        }
+
+        char label_bytes[HISTORY_LABEL_SIZE] = { 0 };
+        if(label) memcpy(label_bytes, label, min(strlen(label), HISTORY_LABEL_SIZE));
+
+        fseek(runs, HISTORY_HEADER_SIZE + run_index * HISTORY_RECORD_SIZE, SEEK_SET);
+        write_partial_u64(runs, (u64) time(NULL));
+        fwrite(label_bytes, 1, HISTORY_LABEL_SIZE, runs);
+
+        success = !ferror(runs);
+        if(fclose(runs) != 0) success = false;
+    } else {
+        success = false;
+    }
+
+    if(!success) printf("[ERROR]: Failed to append this run to the history store '%s'.\n", store_path);
+    reset_arena(&cloc->scratch, mark);
+    return success;
+}
+
+
+
+/* -------------------------------------------------- Queries -------------------------------------------------- */
+
+b8 print_history(Cloc *cloc, char *store_path, char *series_name, char *column_name, s64 last_count) {
+    s64 column = -1;
+    for(s64 i = 0; i < HISTORY_COLUMN_COUNT; ++i) {
+        if(strcmp(column_name, HISTORY_COLUMN_NAMES[i]) == 0) column = i;
+    }
+
+    if(column < 0) {
+        printf("[ERROR]: Unknown history column '%s', expected 'files', 'empty', 'comment' or 'code'.\n", column_name);
+        return false;
+    }
+
+    char *runs_path    = aprint(&cloc->scratch, "%s/runs", store_path);
+    char *catalog_path = aprint(&cloc->scratch, "%s/series", store_path);
+
+    b8 valid;
+    s64 run_count = count_history_runs(runs_path, &valid);
+    if(!valid || run_count == 0) {
+        printf("[ERROR]: The history store '%s' doesn't exist, is empty, or is not a valid store.\n", store_path);
+        return false;
+    }
+
+    s64 catalog_size;
+    char *catalog = os_map_file(catalog_path, &catalog_size);
+    s64 series_index = catalog ? find_history_series(catalog, catalog_size, series_name) : -1;
+    if(catalog) os_unmap_file(catalog, catalog_size);
+
+    if(series_index < 0) {
+        printf("[ERROR]: The history store '%s' has no series '%s'.\n", store_path, series_name);
+        return false;
+    }
+
+    s64 runs_size, column_size;
+    char *column_path = aprint(&cloc->scratch, "%s/%" PRId64 ".%s", store_path, series_index, HISTORY_COLUMN_NAMES[column]);
+    u8 *runs_data     = os_map_file(runs_path, &runs_size);
+    u8 *column_data   = os_map_file(column_path, &column_size);
+
+    Partial_Reader runs   = { runs_data, runs_size, 0, runs_data != NULL };
+    Partial_Reader values = { column_data, column_size, 0, column_data != NULL };
+
+    print_separator_line(cloc, CLOC_VERSION_STRING);
+    print_separator_line(cloc, aprint(&cloc->scratch, "%s %s, %" PRId64 " of %" PRId64 " runs", series_name, HISTORY_COLUMN_NAMES[column], last_count ? min(last_count, run_count) : run_count, run_count));
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string(&builder, "Label");
+    append_right_justified_string_at_offset(&builder, "Run", ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Date", ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, "Change", ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, HISTORY_COLUMN_HEADERS[column], ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+    print_separator_line(cloc, "");
+
+    s64 first = last_count ? max(run_count - last_count, 0) : 0;
+    s64 previous = 0;
+    s64 value    = 0; // Until the first entry of the column
+    s64 entry_count = column_data ? column_size / HISTORY_ENTRY_SIZE : 0;
+    s64 next_entry  = 0;
+
+    for(s64 i = max(first - 1, 0); i < run_count; ++i) {
+        // A value holds until the run of the next entry.
+        for(; next_entry < entry_count; ++next_entry) {
+            values.offset = next_entry * HISTORY_ENTRY_SIZE;
+            s64 run = (s64) read_partial_u64(&values);
+            if(run > i) break;
+            value = (s64) read_partial_u64(&values);
+        }
+
+        if(i >= first) {
+            runs.offset = HISTORY_HEADER_SIZE + i * HISTORY_RECORD_SIZE;
+            time_t timestamp = (time_t) read_partial_u64(&runs);
+            char *label_bytes = (char *) read_partial_bytes(&runs, HISTORY_LABEL_SIZE);
+
+            s64 mark = mark_arena(&cloc->scratch);
+            char date[32] = "";
+            struct tm *local_time = localtime(&timestamp);
+            if(local_time) strftime(date, sizeof(date), "%Y-%m-%d %H:%M", local_time);
+
+            char *label  = aprint(&cloc->scratch, "%.*s", HISTORY_LABEL_SIZE, label_bytes ? label_bytes : "");
+            char *change = i > 0 ? aprint(&cloc->scratch, "%+" PRId64, value - previous) : "";
+
+            create_string_builder(&builder, &cloc->scratch);
+            append_string_with_max_length(&builder, label, FILE_COUNT_COLUMN_OFFSET - 8);
+            append_right_justified_integer_at_offset(&builder, i + 1, ' ', FILE_COUNT_COLUMN_OFFSET);
+            append_right_justified_string_at_offset(&builder, date, ' ', EMPTY_LINES_COLUMN_OFFSET);
+            append_right_justified_string_at_offset(&builder, change, ' ', COMMENT_LINES_COLUMN_OFFSET);
+            append_right_justified_integer_at_offset(&builder, value, ' ', CODE_LINES_COLUMN_OFFSET);
+            print_string_builder_as_line(&builder);
+            reset_arena(&cloc->scratch, mark);
+        }
+
+        previous = value;
+    }
+
+    if(runs_data) os_unmap_file(runs_data, runs_size);
+    if(column_data) os_unmap_file(column_data, column_size);
+    return true;
+}
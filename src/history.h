@@ -0,0 +1,36 @@
+struct Cloc;
+
+#define HISTORY_MAGIC "CLOCHIST"
+#define HISTORY_MAGIC_SIZE 8
+#define HISTORY_VERSION 2
+#define HISTORY_HEADER_SIZE 16      // Magic, u32 version, u32 record size
+#define HISTORY_LABEL_SIZE 56       // Longer labels are cut off
+#define HISTORY_RECORD_SIZE 64      // s64 timestamp, char label[HISTORY_LABEL_SIZE]
+#define HISTORY_COLUMN_COUNT 4
+#define HISTORY_ENTRY_SIZE 16      // u64 run, s64 value
+
+//
+// The history store keeps the results of many runs (e.g. one per mainline commit), so that trends can be
+// queried without counting anything again. It is a directory of append-only files:
+//
+//   runs:           Header, then one fixed size record per run. Appending a record commits the run.
+//   series:         The name of every series, one per line. A series is a language, 'SUM', or a directory
+//                   relative to the common directory of the counted files, which always ends in '/'.
+//   latest:         u64 run count, then the values of every series and metric after that run, in the order
+//                   of the catalog. Appending only needs this, instead of opening every column.
+//   <index>.<name>: One column per series and metric ('files', 'empty', 'comment' or 'code'), holding an entry
+//                   for every run in which the value changed. A value holds until the next entry, and is zero
+//                   before the first one.
+//
+// A query only maps the runs and the one column it needs, no matter how many series there are, and a run only
+// writes the columns that changed. Entries past the last run, left behind by an interrupted append, are
+// ignored by queries and overwritten by the next append, which notices them since the snapshot is stale.
+//
+
+typedef struct History_Series {
+    const char *name;
+    Stats stats;
+} History_Series;
+
+b8 record_history(struct Cloc *cloc, char *store_path, char *label, b8 include_directories);
+b8 print_history(struct Cloc *cloc, char *store_path, char *series_name, char *column_name, s64 last_count);
@@ -0,0 +1,604 @@
+/* ------------------------------------------------- File Set ------------------------------------------------- */
+
+static
+u64 hash_file_set_key(Directory_Node *directory, char *name) {
+    // Directories are interned, so their address identifies them.
+    return extend_string_hash(STRING_HASH_SEED ^ ((u64) directory * 0x9e3779b97f4a7c15), name);
+}
+
+static
+void create_file_set(File_Set *set) {
+    set->count    = 0;
+    set->capacity = FILE_SET_INITIAL_CAPACITY;
+    set->files    = malloc(set->capacity * sizeof(File *));
+    memset(set->files, 0, set->capacity * sizeof(File *));
+    create_string_table(&set->listed_paths, FILE_SET_INITIAL_CAPACITY);
+}
+
+static
+void destroy_file_set(File_Set *set) {
+    for(s64 i = 0; i < set->listed_paths.capacity; ++i) free((char *) set->listed_paths.entries[i].key);
+    destroy_string_table(&set->listed_paths);
+    free(set->files);
+    set->files    = NULL;
+    set->count    = 0;
+    set->capacity = 0;
+}
+
+static
+b8 file_set_contains(File_Set *set, Directory_Node *directory, char *name) {
+    s64 index = hash_file_set_key(directory, name) & (set->capacity - 1);
+    while(set->files[index]) {
+        if(set->files[index]->directory == directory && strcmp(set->files[index]->name, name) == 0) return true;
+        index = (index + 1) & (set->capacity - 1);
+    }
+
+    return false;
+}
+
+static
+void file_set_insert(File_Set *set, File *file) {
+    if((set->count + 1) * 4 > set->capacity * 3) {
+        File_Set grown;
+        grown.count    = set->count;
+        grown.capacity = set->capacity * 2;
+        grown.files    = malloc(grown.capacity * sizeof(File *));
+        memset(grown.files, 0, grown.capacity * sizeof(File *));
+
+        for(s64 i = 0; i < set->capacity; ++i) {
+            if(!set->files[i]) continue;
+            s64 index = hash_file_set_key(set->files[i]->directory, set->files[i]->name) & (grown.capacity - 1);
+            while(grown.files[index]) index = (index + 1) & (grown.capacity - 1);
+            grown.files[index] = set->files[i];
+        }
+
+        free(set->files);
+        *set = grown;
+    }
+
+    s64 index = hash_file_set_key(file->directory, file->name) & (set->capacity - 1);
+    while(set->files[index]) index = (index + 1) & (set->capacity - 1);
+    set->files[index] = file;
+    ++set->count;
+}
+
+
+
+/* ------------------------------------------------ File Lists ------------------------------------------------ */
+
+static
+char *get_listed_path_key(Arena *arena, char *path) {
+    //
+    // Drop '.' components and repeated separators, which build systems like to leave in depfiles. Parent
+    // components stay, since 'link/..' doesn't have to be where the path started.
+    //
+    char *key  = push_arena(arena, strlen(path) + 1);
+    s64 length = 0;
+
+    if(path[0] == '/' || path[0] == '\\') key[length++] = '/';
+
+    for(char *cursor = path; *cursor;) {
+        while(*cursor == '/' || *cursor == '\\') ++cursor;
+        char *start = cursor;
+        while(*cursor && *cursor != '/' && *cursor != '\\') ++cursor;
+
+        s64 size = cursor - start;
+        if(size == 0 || (size == 1 && start[0] == '.')) continue;
+
+        if(length > 0 && key[length - 1] != '/') key[length++] = '/';
+        memcpy(&key[length], start, size);
+        length += size;
+    }
+
+    key[length] = 0;
+    return key;
+}
+
+static
+void register_listed_path(Cloc *cloc, File_Set *set, char *path, s64 *missing_count) {
+    // Listed files are sharded by the path as it was given, just like files on the command line.
+    if(!is_in_shard(cloc, hash_string(path))) return;
+
+    //
+    // Only resolve paths we haven't seen yet, of files we would actually count.
+    //
+    char *name = path;
+    for(char *cursor = path; *cursor; ++cursor) {
+        if(*cursor == '/' || *cursor == '\\') name = cursor + 1;
+    }
+
+    if(get_language_for_file_path(name) == LANGUAGE_COUNT && !cloc->lines_only) return;
+
+    s64 mark  = mark_arena(&cloc->scratch);
+    char *key = get_listed_path_key(&cloc->scratch, path);
+
+    if(!string_table_query(&set->listed_paths, key)) {
+        string_table_insert(&set->listed_paths, strcpy(malloc(strlen(key) + 1), key), (void *) 1);
+
+        char *resolved_path = os_make_absolute_path(&cloc->scratch, path);
+        if(resolved_path) {
+            Directory_Node *directory = intern_resolved_file_directory(cloc, resolved_path, &name);
+            if(!file_set_contains(set, directory, name)) {
+                File *file = register_file_to_parse(cloc, directory, name, 0);
+                if(file) file_set_insert(set, file);
+            }
+        } else {
+            ++*missing_count;
+        }
+    }
+
+    reset_arena(&cloc->scratch, mark);
+}
+
+static
+char *read_standard_input(s64 *size) {
+    s64 capacity = 64 * 1024;
+    char *data   = malloc(capacity);
+    *size = 0;
+
+    s64 read;
+    while((read = fread(&data[*size], 1, capacity - *size, stdin)) > 0) {
+        *size += read;
+        if(*size == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+
+    return data;
+}
+
+static
+b8 register_file_list(Cloc *cloc, File_Set *set, char *list_path, s64 *missing_count) {
+    b8 from_standard_input = strcmp(list_path, "-") == 0;
+
+    s64 size = 0;
+    char *data = from_standard_input ? read_standard_input(&size) : os_map_file(list_path, &size);
+    if(!data && os_resolve_path_kind(list_path) != OS_PATH_Is_File) {
+        printf("[ERROR]: Failed to read the file list '%s'.\n", list_path);
+        return false;
+    }
+
+    //
+    // Lists from 'find -print0' and friends are separated by NUL characters, which is the only safe choice for
+    // arbitrary file names. Otherwise, every line is one path.
+    //
+    b8 nul_separated = size > 0 && memchr(data, 0, size) != NULL;
+    char separator   = nul_separated ? 0 : '\n';
+
+    s64 start = 0;
+    for(s64 i = 0; i <= size; ++i) {
+        if(i < size && data[i] != separator) continue;
+
+        s64 end = i;
+        if(!nul_separated) while(end > start && data[end - 1] == '\r') --end;
+
+        if(end > start) {
+            s64 mark   = mark_arena(&cloc->scratch);
+            char *path = push_arena(&cloc->scratch, end - start + 1);
+            memcpy(path, &data[start], end - start);
+            path[end - start] = 0;
+            register_listed_path(cloc, set, path, missing_count);
+            reset_arena(&cloc->scratch, mark);
+        }
+
+        start = i + 1;
+    }
+
+    if(from_standard_input) {
+        free(data);
+    } else if(data) {
+        os_unmap_file(data, size);
+    }
+
+    return true;
+}
+
+
+
+/* --------------------------------------------- Compile Commands --------------------------------------------- */
+
+static
+void skip_json_whitespace(Json_Reader *reader) {
+    while(reader->offset < reader->size) {
+        char character = reader->data[reader->offset];
+        if(character != ' ' && character != '\t' && character != '\n' && character != '\r') break;
+        ++reader->offset;
+    }
+}
+
+static
+b8 consume_json_character(Json_Reader *reader, char character) {
+    skip_json_whitespace(reader);
+    if(reader->offset >= reader->size || reader->data[reader->offset] != character) return false;
+
+    ++reader->offset;
+    return true;
+}
+
+static
+void expect_json_character(Json_Reader *reader, char character) {
+    if(reader->valid && !consume_json_character(reader, character)) reader->valid = false;
+}
+
+static
+void skip_json_string(Json_Reader *reader) {
+    //
+    // Most of a compilation database are long command strings we don't care about, so jump from quote to
+    // quote. A quote only ends the string if it is preceded by an even number of backslashes.
+    //
+    ++reader->offset; // Opening quote
+
+    while(true) {
+        char *quote = memchr(&reader->data[reader->offset], '"', reader->size - reader->offset);
+        if(!quote) {
+            reader->offset = reader->size;
+            reader->valid  = false;
+            return;
+        }
+
+        s64 quote_offset = quote - reader->data;
+        s64 backslashes  = 0;
+        while(quote_offset - backslashes - 1 >= reader->offset && reader->data[quote_offset - backslashes - 1] == '\\') ++backslashes;
+
+        reader->offset = quote_offset + 1;
+        if(backslashes % 2 == 0) return;
+    }
+}
+
+static
+s64 parse_json_hex_digits(Json_Reader *reader, s64 offset) {
+    if(offset + 4 > reader->size) return -1;
+
+    s64 value = 0;
+    for(s64 i = offset; i < offset + 4; ++i) {
+        char character = reader->data[i];
+        value <<= 4;
+        if(character >= '0' && character <= '9') {
+            value |= character - '0';
+        } else if(character >= 'a' && character <= 'f') {
+            value |= character - 'a' + 10;
+        } else if(character >= 'A' && character <= 'F') {
+            value |= character - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+
+    return value;
+}
+
+static
+char *read_json_string(Json_Reader *reader, Arena *arena) {
+    skip_json_whitespace(reader);
+    if(!reader->valid || reader->offset >= reader->size || reader->data[reader->offset] != '"') {
+        reader->valid = false;
+        return NULL;
+    }
+
+    s64 start = reader->offset + 1;
+    skip_json_string(reader);
+    if(!reader->valid) return NULL;
+    s64 end = reader->offset - 1;
+
+    //
+    // The decoded string is never longer than its escaped form.
+    //
+    char *string = push_arena(arena, end - start + 1);
+    s64 length   = 0;
+
+    for(s64 i = start; i < end; ++i) {
+        if(reader->data[i] != '\\') {
+            string[length++] = reader->data[i];
+            continue;
+        }
+
+        char escaped = reader->data[++i];
+        switch(escaped) {
+        case 'b': string[length++] = '\b'; break;
+        case 'f': string[length++] = '\f'; break;
+        case 'n': string[length++] = '\n'; break;
+        case 'r': string[length++] = '\r'; break;
+        case 't': string[length++] = '\t'; break;
+        case 'u': {
+            s64 code_point = parse_json_hex_digits(reader, i + 1);
+            if(code_point < 0) {
+                reader->valid = false;
+                return NULL;
+            }
+            i += 4;
+
+            if(code_point >= 0xd800 && code_point < 0xdc00 && i + 6 < end && reader->data[i + 1] == '\\' && reader->data[i + 2] == 'u') {
+                s64 low_surrogate = parse_json_hex_digits(reader, i + 3);
+                if(low_surrogate >= 0xdc00 && low_surrogate < 0xe000) {
+                    code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low_surrogate - 0xdc00);
+                    i += 6;
+                }
+            }
+
+            if(code_point < 0x80) {
+                string[length++] = (char) code_point;
+            } else if(code_point < 0x800) {
+                string[length++] = (char) (0xc0 | (code_point >> 6));
+                string[length++] = (char) (0x80 | (code_point & 0x3f));
+            } else if(code_point < 0x10000) {
+                string[length++] = (char) (0xe0 | (code_point >> 12));
+                string[length++] = (char) (0x80 | ((code_point >> 6) & 0x3f));
+                string[length++] = (char) (0x80 | (code_point & 0x3f));
+            } else {
+                string[length++] = (char) (0xf0 | (code_point >> 18));
+                string[length++] = (char) (0x80 | ((code_point >> 12) & 0x3f));
+                string[length++] = (char) (0x80 | ((code_point >> 6) & 0x3f));
+                string[length++] = (char) (0x80 | (code_point & 0x3f));
+            }
+        } break;
+        default: string[length++] = escaped; break; // '"', '\\' and '/'
+        }
+    }
+
+    string[length] = 0;
+    return string;
+}
+
+static
+void skip_json_value(Json_Reader *reader) {
+    s64 depth = 0;
+
+    do {
+        skip_json_whitespace(reader);
+        if(reader->offset >= reader->size) {
+            reader->valid = false;
+            return;
+        }
+
+        char character = reader->data[reader->offset];
+        if(character == '"') {
+            skip_json_string(reader);
+        } else if(character == '{' || character == '[') {
+            ++depth;
+            ++reader->offset;
+        } else if(character == '}' || character == ']') {
+            --depth;
+            ++reader->offset;
+        } else if(character == ',' || character == ':') {
+            ++reader->offset;
+        } else {
+            // Numbers and literals
+            while(reader->offset < reader->size && !strchr(",:]} \t\r\n", reader->data[reader->offset])) ++reader->offset;
+        }
+    } while(depth > 0 && reader->valid);
+}
+
+static
+void note_compile_argument(Compile_Command *command, char *argument) {
+    if(command->expect_output) {
+        if(!command->output) command->output = argument;
+        command->expect_output = false;
+    } else if(command->expect_depfile) {
+        command->depfile = argument;
+        command->expect_depfile = false;
+    } else if(strcmp(argument, "-o") == 0) {
+        command->expect_output = true;
+    } else if(strcmp(argument, "-MF") == 0) {
+        command->expect_depfile = true;
+    } else if(strncmp(argument, "-o", 2) == 0) {
+        if(!command->output) command->output = &argument[2];
+    } else if(strncmp(argument, "-MF", 3) == 0) {
+        command->depfile = &argument[3];
+    }
+}
+
+static
+void split_compile_command(Arena *arena, Compile_Command *command, char *line) {
+    //
+    // Split a shell command line into its arguments, honoring quotes and backslashes.
+    //
+    char *argument = push_arena(arena, strlen(line) + 1);
+    s64 length     = 0;
+    b8 in_argument = false;
+    char quote     = 0;
+
+    for(char *cursor = line; ; ++cursor) {
+        char character = *cursor;
+
+        if(character == 0 || (!quote && (character == ' ' || character == '\t' || character == '\n'))) {
+            if(in_argument) {
+                argument[length] = 0;
+                note_compile_argument(command, argument);
+                argument = &argument[length + 1];
+                length   = 0;
+            }
+
+            in_argument = false;
+            if(character == 0) break;
+        } else if(character == quote) {
+            quote = 0;
+        } else if(!quote && (character == '"' || character == '\'')) {
+            quote       = character;
+            in_argument = true;
+        } else if(character == '\\' && quote != '\'' && cursor[1] != 0) {
+            argument[length++] = *++cursor;
+            in_argument = true;
+        } else {
+            argument[length++] = character;
+            in_argument = true;
+        }
+    }
+}
+
+static
+void read_compile_command(Cloc *cloc, Json_Reader *reader, Compile_Command *command, b8 include_depfiles) {
+    expect_json_character(reader, '{');
+    if(!reader->valid || consume_json_character(reader, '}')) return;
+
+    do {
+        char *key = read_json_string(reader, &cloc->scratch);
+        expect_json_character(reader, ':');
+        if(!reader->valid) return;
+
+        if(strcmp(key, "directory") == 0) {
+            command->directory = read_json_string(reader, &cloc->scratch);
+        } else if(strcmp(key, "file") == 0) {
+            command->file = read_json_string(reader, &cloc->scratch);
+        } else if(strcmp(key, "output") == 0) {
+            command->output = read_json_string(reader, &cloc->scratch);
+        } else if(include_depfiles && strcmp(key, "arguments") == 0) {
+            expect_json_character(reader, '[');
+            if(reader->valid && !consume_json_character(reader, ']')) {
+                do {
+                    char *argument = read_json_string(reader, &cloc->scratch);
+                    if(argument) note_compile_argument(command, argument);
+                } while(reader->valid && consume_json_character(reader, ','));
+
+                expect_json_character(reader, ']');
+            }
+        } else if(include_depfiles && strcmp(key, "command") == 0) {
+            char *line = read_json_string(reader, &cloc->scratch);
+            if(line) split_compile_command(&cloc->scratch, command, line);
+        } else {
+            skip_json_value(reader);
+        }
+    } while(reader->valid && consume_json_character(reader, ','));
+
+    expect_json_character(reader, '}');
+}
+
+static
+char *resolve_compile_command_path(Cloc *cloc, Compile_Command *command, char *path) {
+    b8 is_absolute = path[0] == '/' || path[0] == '\\' || (path[0] != 0 && path[1] == ':');
+    return is_absolute || !command->directory ? path : combine_file_paths(cloc, command->directory, path);
+}
+
+static
+void register_depfile_dependencies(Cloc *cloc, File_Set *set, Compile_Command *command, s64 *missing_count) {
+    //
+    // Without an explicit '-MF', the compiler puts the depfile next to the output, with a '.d' extension.
+    //
+    char *depfile = command->depfile;
+    if(!depfile && command->output) {
+        s64 extension_offset = strlen(command->output);
+        while(extension_offset > 0 && command->output[extension_offset - 1] != '.' && command->output[extension_offset - 1] != '/' && command->output[extension_offset - 1] != '\\') --extension_offset;
+        if(extension_offset == 0 || command->output[extension_offset - 1] != '.') extension_offset = strlen(command->output) + 1;
+
+        depfile = aprint(&cloc->scratch, "%.*s.d", (int) (extension_offset - 1), command->output);
+    }
+
+    if(!depfile) return;
+
+    s64 size;
+    char *data = os_map_file(resolve_compile_command_path(cloc, command, depfile), &size);
+    if(!data) return; // Not every command writes a depfile
+
+    //
+    // Depfiles are Makefile rules. Every word that doesn't end with a colon is a dependency, words are separated
+    // by whitespace, and lines are continued with a backslash.
+    //
+    char *token = malloc(size + 1);
+    s64 offset  = 0;
+
+    while(offset < size) {
+        s64 length = 0;
+
+        while(offset < size) {
+            char character = data[offset];
+            if(character == ' ' || character == '\t' || character == '\n' || character == '\r') {
+                ++offset;
+                if(length) break;
+            } else if(character == '\\' && offset + 1 < size && (data[offset + 1] == '\n' || data[offset + 1] == '\r')) {
+                offset += 2;
+                if(length) break;
+            } else if(character == '\\' && offset + 1 < size && (data[offset + 1] == ' ' || data[offset + 1] == '#')) {
+                token[length++] = data[offset + 1];
+                offset += 2;
+            } else if(character == '$' && offset + 1 < size && data[offset + 1] == '$') {
+                token[length++] = '$';
+                offset += 2;
+            } else {
+                token[length++] = character;
+                ++offset;
+            }
+        }
+
+        if(length == 0 || token[length - 1] == ':') continue; // Targets
+
+        token[length] = 0;
+        s64 mark = mark_arena(&cloc->scratch);
+        register_listed_path(cloc, set, resolve_compile_command_path(cloc, command, token), missing_count);
+        reset_arena(&cloc->scratch, mark);
+    }
+
+    free(token);
+    os_unmap_file(data, size);
+}
+
+static
+b8 register_compile_database(Cloc *cloc, File_Set *set, char *database_path, b8 include_depfiles, s64 *missing_count) {
+    s64 mark = mark_arena(&cloc->scratch);
+
+    // A build directory can be given instead of the database itself.
+    if(os_resolve_path_kind(database_path) == OS_PATH_Is_Directory) database_path = combine_file_paths(cloc, database_path, "compile_commands.json");
+
+    //
+    // Databases of large builds can be hundreds of megabytes, so they are read straight from the mapping, and
+    // only the strings we actually need are decoded.
+    //
+    s64 size;
+    char *data = os_map_file(database_path, &size);
+    if(!data) {
+        printf("[ERROR]: Failed to read the compilation database '%s'.\n", database_path);
+        reset_arena(&cloc->scratch, mark);
+        return false;
+    }
+
+    Json_Reader reader = { data, size, 0, true };
+    expect_json_character(&reader, '[');
+
+    if(reader.valid && !consume_json_character(&reader, ']')) {
+        do {
+            s64 command_mark = mark_arena(&cloc->scratch);
+
+            Compile_Command command = { 0 };
+            read_compile_command(cloc, &reader, &command, include_depfiles);
+
+            if(reader.valid && command.file) {
+                register_listed_path(cloc, set, resolve_compile_command_path(cloc, &command, command.file), missing_count);
+                if(include_depfiles) register_depfile_dependencies(cloc, set, &command, missing_count);
+            }
+
+            reset_arena(&cloc->scratch, command_mark);
+        } while(reader.valid && consume_json_character(&reader, ','));
+
+        expect_json_character(&reader, ']');
+    }
+
+    if(!reader.valid) printf("[ERROR]: The compilation database '%s' is malformed near byte %" PRId64 ".\n", database_path, reader.offset);
+
+    os_unmap_file(data, size);
+    reset_arena(&cloc->scratch, mark);
+    return reader.valid;
+}
+
+
+
+/* -------------------------------------------------- Driver -------------------------------------------------- */
+
+b8 register_listed_files(Cloc *cloc, String_List *file_lists, String_List *compile_databases, b8 include_depfiles) {
+    File_Set set;
+    create_file_set(&set);
+
+    b8 success = true;
+    s64 missing_count = 0;
+
+    for(String_List *list = file_lists; list && success; list = list->next) {
+        success = register_file_list(cloc, &set, list->content, &missing_count);
+    }
+
+    for(String_List *database = compile_databases; database && success; database = database->next) {
+        success = register_compile_database(cloc, &set, database->content, include_depfiles, &missing_count);
+    }
+
+    if(missing_count) printf("[WARNING]: Skipped %" PRId64 " listed files that don't exist.\n", missing_count);
+
+    destroy_file_set(&set);
+    return success;
+}
@@ -0,0 +1,39 @@
+struct Cloc;
+
+#define FILE_SET_INITIAL_CAPACITY 1024
+
+//
+// Instead of traversing directories, the files to count can come from lists that the build system already
+// knows: Plain file lists (separated by newlines or NUL characters), and compilation databases in the
+// compile_commands.json format, optionally including the headers from the depfiles of every command.
+// Listed files are registered straight away, without asking the file system about their kind first.
+//
+
+// The same file may be listed many times (e.g. a header that many depfiles mention, or a translation unit
+// that is compiled in multiple configurations), but is only registered once. Every spelling of a path is
+// also only resolved once, since that asks the file system about each of its components.
+typedef struct File_Set {
+    File **files; // NULL for empty slots
+    s64 count;
+    s64 capacity; // Always a power of two
+    String_Table listed_paths; // Every path that was already looked at, as listed. Owns its keys.
+} File_Set;
+
+typedef struct Json_Reader {
+    char *data;
+    s64 size;
+    s64 offset;
+    b8 valid; // Cleared as soon as the content doesn't look like what we expect
+} Json_Reader;
+
+// What we care about in one entry of a compilation database. Strings live in the scratch arena.
+typedef struct Compile_Command {
+    char *directory;
+    char *file;
+    char *output;  // From '-o'
+    char *depfile; // From '-MF'
+    b8 expect_output;
+    b8 expect_depfile;
+} Compile_Command;
+
+b8 register_listed_files(struct Cloc *cloc, String_List *file_lists, String_List *compile_databases, b8 include_depfiles);
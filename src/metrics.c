@@ -0,0 +1,144 @@
+/* -------------------------------------------------- Setup -------------------------------------------------- */
+
+Line_Metrics *create_line_metrics(Cloc *cloc) {
+    Line_Metrics *metrics = malloc(max(cloc->file_count, 1) * sizeof(Line_Metrics));
+    memset(metrics, 0, max(cloc->file_count, 1) * sizeof(Line_Metrics));
+    return metrics;
+}
+
+
+
+/* ------------------------------------------------- Output ------------------------------------------------- */
+
+static
+int compare_metrics_rows(const void *lhs, const void *rhs) {
+    const Metrics_Row *a = lhs, *b = rhs;
+    if(a->metrics.max_line_length != b->metrics.max_line_length) return a->metrics.max_line_length > b->metrics.max_line_length ? -1 : 1;
+    return strcmp(a->ident, b->ident);
+}
+
+static
+void print_metrics_header_line(Cloc *cloc, const char *columns[4]) {
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string(&builder, cloc->output_mode == OUTPUT_By_File ? "File" : "Language");
+    if(columns[0]) append_right_justified_string_at_offset(&builder, columns[0], ' ', FILE_COUNT_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, columns[1], ' ', EMPTY_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, columns[2], ' ', COMMENT_LINES_COLUMN_OFFSET);
+    append_right_justified_string_at_offset(&builder, columns[3], ' ', CODE_LINES_COLUMN_OFFSET);
+    print_string_builder_as_line(&builder);
+    print_separator_line(cloc, "");
+}
+
+static
+void print_metrics_entry_line(Cloc *cloc, Metrics_Row *row, s64 table) {
+    Line_Metrics *metrics = &row->metrics;
+    s64 mark = mark_arena(&cloc->scratch);
+    char *average = aprint(&cloc->scratch, "%.1f", row->lines ? (f64) metrics->total_line_length / row->lines : 0.);
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+    append_string_with_max_length(&builder, row->ident, (table == 2 ? EMPTY_LINES_COLUMN_OFFSET : FILE_COUNT_COLUMN_OFFSET) - 3);
+
+    switch(table) {
+    case 0:
+        append_right_justified_integer_at_offset(&builder, metrics->max_line_length,           ' ', FILE_COUNT_COLUMN_OFFSET);
+        append_right_justified_string_at_offset(&builder, average,                             ' ', EMPTY_LINES_COLUMN_OFFSET);
+        append_right_justified_integer_at_offset(&builder, metrics->trailing_whitespace_lines, ' ', COMMENT_LINES_COLUMN_OFFSET);
+        append_right_justified_integer_at_offset(&builder, metrics->tab_indented_lines,        ' ', CODE_LINES_COLUMN_OFFSET);
+        break;
+
+    case 1:
+        append_right_justified_integer_at_offset(&builder, metrics->line_length_histogram[0], ' ', FILE_COUNT_COLUMN_OFFSET);
+        append_right_justified_integer_at_offset(&builder, metrics->line_length_histogram[1], ' ', EMPTY_LINES_COLUMN_OFFSET);
+        append_right_justified_integer_at_offset(&builder, metrics->line_length_histogram[2], ' ', COMMENT_LINES_COLUMN_OFFSET);
+        append_right_justified_integer_at_offset(&builder, metrics->line_length_histogram[3], ' ', CODE_LINES_COLUMN_OFFSET);
+        break;
+
+    case 2:
+        append_right_justified_integer_at_offset(&builder, metrics->blank_bytes,   ' ', EMPTY_LINES_COLUMN_OFFSET);
+        append_right_justified_integer_at_offset(&builder, metrics->comment_bytes, ' ', COMMENT_LINES_COLUMN_OFFSET);
+        append_right_justified_integer_at_offset(&builder, metrics->code_bytes,    ' ', CODE_LINES_COLUMN_OFFSET);
+        break;
+    }
+
+    print_string_builder_as_line(&builder);
+    reset_arena(&cloc->scratch, mark);
+}
+
+static
+void print_metrics_rows(Cloc *cloc, Metrics_Row *rows, s64 row_count) {
+    Metrics_Row sum = { "SUM:", 0, { 0 } };
+
+    qsort(rows, row_count, sizeof(Metrics_Row), compare_metrics_rows);
+    for(s64 i = 0; i < row_count; ++i) {
+        sum.lines += rows[i].lines;
+        combine_line_metrics(&sum.metrics, &rows[i].metrics);
+    }
+
+    const char *TABLE_NAMES[3] = { "Line metrics", "Line lengths", "Bytes" };
+    const char *TABLE_COLUMNS[3][4] = {
+        { "Max length", "Avg length", "Trailing ws", "Tab indent" },
+        { "< 80",       "80-99",      "100-119",     ">= 120" },
+        { NULL,         "Empty",      "Comment",     "Code" },
+    };
+
+    for(s64 table = 0; table < 3; ++table) {
+        print_separator_line(cloc, TABLE_NAMES[table]);
+        print_metrics_header_line(cloc, TABLE_COLUMNS[table]);
+
+        for(s64 i = 0; i < row_count; ++i) print_metrics_entry_line(cloc, &rows[i], table);
+
+        if(row_count > 1) {
+            print_separator_line(cloc, "");
+            print_metrics_entry_line(cloc, &sum, table);
+        }
+    }
+}
+
+void print_metrics_tables(Cloc *cloc) {
+    //
+    // One row per language or per counted file, just like the line counts. Generated files are only included
+    // if they were reported.
+    //
+    Metrics_Row *rows = NULL;
+    s64 row_count = 0;
+    Counted_Files counted = { 0 };
+
+    switch(cloc->output_mode) {
+    case OUTPUT_By_File: {
+        collect_counted_files(cloc, &counted);
+        rows = malloc(max(counted.count, 1) * sizeof(Metrics_Row));
+        for(s64 i = 0; i < counted.count; ++i) {
+            File *file = counted.files[i];
+            Metrics_Row *row = &rows[row_count++];
+            row->ident   = counted.paths[i];
+            row->lines   = file->stats.blank + file->stats.comment + file->stats.code;
+            row->metrics = *get_file_metrics(cloc, file);
+        }
+    } break;
+
+    case OUTPUT_By_Language: {
+        rows = malloc(LANGUAGE_COUNT * sizeof(Metrics_Row));
+        for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+            Stats stats = cloc->totals.language_stats[FILE_Source][i];
+            Line_Metrics metrics = cloc->totals.language_metrics[FILE_Source][i];
+            if(cloc->report_generated) {
+                combine_stats(&stats, &cloc->totals.language_stats[FILE_Generated][i]);
+                combine_line_metrics(&metrics, &cloc->totals.language_metrics[FILE_Generated][i]);
+            }
+
+            if(stats.file_count == 0) continue;
+            Metrics_Row *row = &rows[row_count++];
+            row->ident   = LANGUAGE_STRINGS[i];
+            row->lines   = stats.blank + stats.comment + stats.code;
+            row->metrics = metrics;
+        }
+    } break;
+    }
+
+    if(row_count) print_metrics_rows(cloc, rows, row_count);
+
+    free(rows);
+    destroy_counted_files(&counted);
+}
@@ -0,0 +1,17 @@
+struct Cloc;
+
+//
+// With '--metrics', every file is measured in the same pass that classifies its lines: line lengths, trailing
+// whitespace, tab indentation and the bytes per line category. The results live in one array with an entry
+// per file, which the workers fill and add up into their per-language totals, and are printed as additional
+// tables after the line counts.
+//
+
+typedef struct Metrics_Row {
+    const char *ident;
+    s64 lines;
+    Line_Metrics metrics;
+} Metrics_Row;
+
+Line_Metrics *create_line_metrics(struct Cloc *cloc);
+void print_metrics_tables(struct Cloc *cloc);
@@ -29,6 +29,8 @@ typedef unsigned char b8;
 typedef HANDLE Pid;
 typedef HANDLE File_Handle;
 typedef HANDLE File_Iterator_Handle;
+typedef SRWLOCK OS_Mutex;
+typedef CONDITION_VARIABLE OS_Condition;
 
 #elif POSIX
 # include <linux/limits.h>
@@ -38,6 +40,17 @@ typedef HANDLE File_Iterator_Handle;
 # include <dirent.h>
 # include <pthread.h>
 # include <sys/resource.h>
+# include <sys/mman.h>
+# include <sys/ioctl.h>
+# include <linux/fs.h>
+# include <linux/fiemap.h>
+# include <sys/inotify.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <poll.h>
+# include <errno.h>
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
 
 # define min(lhs, rhs) ((lhs) < (rhs) ? (lhs) : (rhs))
 # define max(lhs, rhs) ((lhs) > (rhs) ? (lhs) : (rhs))
@@ -67,44 +80,100 @@ typedef unsigned char b8;
 typedef u64 Pid;
 typedef int File_Handle;
 typedef DIR *File_Iterator_Handle;
+typedef pthread_mutex_t OS_Mutex;
+typedef pthread_cond_t OS_Condition;
 
 #else
 # error "This platform is not supported."
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64)
+# include <emmintrin.h>
+# define USE_SSE2 true
+#else
+# define USE_SSE2 false
+#endif
+
 typedef enum OS_Path_Kind {
     OS_PATH_Non_Existent,
     OS_PATH_Is_File,
     OS_PATH_Is_Directory,
 } OS_Path_Kind;
 
+void *os_reserve_memory(s64 size); // Only reserves the address range, NULL on failure
+b8 os_commit_memory(void *pointer, s64 size); // Backs a part of a reserved range with memory
+void os_release_memory(void *pointer, s64 size);
+
 OS_Path_Kind os_resolve_path_kind(char *path);
-char *os_make_absolute_path(struct Arena *arena, char *path);
+char *os_make_absolute_path(struct Arena *arena, char *path); // NULL if the path cannot be resolved
 File_Handle os_open_file(char *path);
 s64 os_get_file_size(File_Handle handle);
+s64 os_get_file_size_by_path(char *path); // Without opening the file, 0 if it cannot be queried
+b8 os_get_file_identity(char *path, u64 *device, u64 *inode); // Follows symlinks, false if the path cannot be queried
+b8 os_create_directory(char *path); // Also succeeds if the directory already exists
 s64 os_read_file(File_Handle handle, char *dst, s64 offset, s64 size);
 void os_close_file(File_Handle handle);
+void *os_map_file(char *path, s64 *size); // Maps the complete file read-only, returns NULL on failure or for empty files.
+void os_unmap_file(void *pointer, s64 size);
+u64 os_get_physical_file_offset(char *path); // 0 if the file system doesn't tell us where the file lives on disk
+void os_hint_file_read(File_Handle handle);   // Asks the kernel to start reading this file into the cache
 
 typedef struct File_Iterator {
     b8 valid;
+    b8 follow_symlinks; // Symlinks are reported as the kind of their target, with the identity of the target
     File_Iterator_Handle native_handle;
     char *path;
     OS_Path_Kind kind;
+    u64 inode;  // 0 if the platform doesn't report it while listing a directory
+    u64 device; // Only set when following symlinks, together with the inode this identifies the file
+    u64 directory_device;
 } File_Iterator;
 
-File_Iterator find_first_file(struct Arena *arena, char *directory_path);
+File_Iterator find_first_file(struct Arena *arena, char *directory_path, b8 follow_symlinks);
 void find_next_file(struct Arena *arena, File_Iterator *iterator);
 void close_file_iterator(File_Iterator *iterator);
 
 s64 os_get_hardware_thread_count();
+s64 os_count_set_bits(u32 value);
 Pid os_spawn_thread(int (*procedure)(void *), void *argument);
 void os_join_thread(Pid pid);
 void *os_compare_and_swap(void *volatile *dst, void *exchange, void *comparand);
 
+void os_create_mutex(OS_Mutex *mutex);
+void os_destroy_mutex(OS_Mutex *mutex);
+void os_lock_mutex(OS_Mutex *mutex);
+void os_unlock_mutex(OS_Mutex *mutex);
+void os_create_condition(OS_Condition *condition);
+void os_destroy_condition(OS_Condition *condition);
+void os_wait_condition(OS_Condition *condition, OS_Mutex *mutex); // The mutex must be locked by the caller
+void os_wait_condition_timeout(OS_Condition *condition, OS_Mutex *mutex, s64 milliseconds); // May also wake up early
+void os_signal_condition(OS_Condition *condition);
+void os_broadcast_condition(OS_Condition *condition);
+
 typedef s64 Hardware_Time;
 
 Hardware_Time os_get_hardware_time();
 f64 os_convert_hardware_time_to_seconds(Hardware_Time delta);
 
+typedef enum OS_Hardware_Counter {
+    OS_COUNTER_Cpu_Time, // In nanoseconds, always available if any counter is
+    OS_COUNTER_Cycles,
+    OS_COUNTER_Instructions,
+    OS_COUNTER_Branch_Misses,
+    OS_COUNTER_Cache_Misses,
+    OS_COUNTER_COUNT,
+} OS_Hardware_Counter;
+
+// Counters of the thread that opened them. Virtual machines often don't expose the hardware events, in which
+// case only the CPU time is available.
+typedef struct OS_Hardware_Counters {
+    s64 handles[OS_COUNTER_COUNT]; // -1 for counters that are not available
+    u32 available;                 // One bit per counter
+} OS_Hardware_Counters;
+
+b8 os_open_hardware_counters(OS_Hardware_Counters *counters); // For the calling thread, false if nothing can be counted
+void os_read_hardware_counters(OS_Hardware_Counters *counters, u64 values[OS_COUNTER_COUNT]);
+void os_close_hardware_counters(OS_Hardware_Counters *counters);
+
 s64 os_get_working_set_size();
 void os_sleep(f64 seconds);
@@ -0,0 +1,273 @@
+/* ------------------------------------------------- Writing ------------------------------------------------- */
+
+void write_partial_u32(FILE *file, u32 value) {
+    u8 bytes[4] = { (u8) value, (u8) (value >> 8), (u8) (value >> 16), (u8) (value >> 24) };
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+void write_partial_u64(FILE *file, u64 value) {
+    write_partial_u32(file, (u32) value);
+    write_partial_u32(file, (u32) (value >> 32));
+}
+
+void write_partial_string(FILE *file, const char *string, s64 length) {
+    write_partial_u32(file, (u32) length);
+    fwrite(string, 1, length, file);
+}
+
+static
+void write_partial_stats(FILE *file, Stats *stats) {
+    write_partial_u64(file, stats->blank);
+    write_partial_u64(file, stats->comment);
+    write_partial_u64(file, stats->code);
+    write_partial_u64(file, stats->file_count);
+}
+
+static
+void write_partial_directories(FILE *file, Directory_Node *directory, s64 *next_index) {
+    for(Directory_Node *child = directory->first_child; child != NULL; child = child->next_sibling) {
+        if(child->partial_index < 0) continue; // No file lives in or below this directory
+
+        child->partial_index = (*next_index)++;
+        write_partial_u64(file, directory->parent ? directory->partial_index + 1 : 0);
+        write_partial_string(file, child->name, child->path_length - directory->path_length - 1);
+        write_partial_directories(file, child, next_index);
+    }
+}
+
+b8 write_partial_results(Cloc *cloc, char *file_path) {
+    FILE *file = fopen(file_path, "wb");
+    if(!file) {
+        printf("[ERROR]: Failed to create the partial results file '%s'.\n", file_path);
+        return false;
+    }
+
+    //
+    // Only the directories that actually contain files are written. Mark them first, so that we know
+    // how many there are before writing the header.
+    //
+    s64 directory_count = 0;
+    Stats language_stats[LANGUAGE_COUNT];
+    memset(language_stats, 0, sizeof(language_stats));
+
+    for(File *entry = cloc->first_file; entry != NULL; entry = entry->next) {
+        for(Directory_Node *node = entry->directory; node->parent != NULL && node->partial_index < 0; node = node->parent) {
+            node->partial_index = 0;
+            ++directory_count;
+        }
+
+        combine_stats(&language_stats[entry->language], &entry->stats);
+    }
+
+    fwrite(PARTIAL_MAGIC, 1, PARTIAL_MAGIC_SIZE, file);
+    write_partial_u32(file, PARTIAL_VERSION);
+    write_partial_u32(file, (u32) cloc->shard_index);
+    write_partial_u32(file, (u32) max(cloc->shard_count, 1));
+    write_partial_u32(file, LANGUAGE_COUNT);
+    write_partial_u64(file, directory_count);
+    write_partial_u64(file, cloc->file_count);
+
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+        write_partial_string(file, LANGUAGE_STRINGS[i], strlen(LANGUAGE_STRINGS[i]));
+        write_partial_stats(file, &language_stats[i]);
+    }
+
+    s64 next_index = 0;
+    write_partial_directories(file, &cloc->root_directory, &next_index);
+
+    for(File *entry = cloc->first_file; entry != NULL; entry = entry->next) {
+        write_partial_u64(file, entry->directory->partial_index);
+        write_partial_u32(file, entry->language);
+        write_partial_u32(file, entry->status);
+        write_partial_stats(file, &entry->stats);
+        write_partial_string(file, entry->name, strlen(entry->name));
+    }
+
+    b8 success = !ferror(file);
+    if(fclose(file) != 0) success = false;
+
+    if(!success) printf("[ERROR]: Failed to write the partial results file '%s'.\n", file_path);
+    return success;
+}
+
+
+
+/* ------------------------------------------------- Merging ------------------------------------------------- */
+
+u8 *read_partial_bytes(Partial_Reader *reader, s64 count) {
+    if(!reader->valid || count < 0 || count > reader->size - reader->offset) {
+        reader->valid = false;
+        return NULL;
+    }
+
+    u8 *bytes = &reader->data[reader->offset];
+    reader->offset += count;
+    return bytes;
+}
+
+u32 read_partial_u32(Partial_Reader *reader) {
+    u8 *bytes = read_partial_bytes(reader, 4);
+    if(!bytes) return 0;
+    return (u32) bytes[0] | ((u32) bytes[1] << 8) | ((u32) bytes[2] << 16) | ((u32) bytes[3] << 24);
+}
+
+u64 read_partial_u64(Partial_Reader *reader) {
+    u64 low  = read_partial_u32(reader);
+    u64 high = read_partial_u32(reader);
+    return low | (high << 32);
+}
+
+char *read_partial_string(Partial_Reader *reader, s64 *length) {
+    *length = read_partial_u32(reader);
+    return (char *) read_partial_bytes(reader, *length);
+}
+
+static
+void read_partial_stats(Partial_Reader *reader, Stats *stats) {
+    stats->blank      = read_partial_u64(reader);
+    stats->comment    = read_partial_u64(reader);
+    stats->code       = read_partial_u64(reader);
+    stats->file_count = read_partial_u64(reader);
+}
+
+static
+Language find_language_by_name(char *name, s64 length) {
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+        s64 language_length = strlen(LANGUAGE_STRINGS[i]);
+        if(language_length == length && memcmp(LANGUAGE_STRINGS[i], name, length) == 0) return (Language) i;
+    }
+
+    return LANGUAGE_COUNT;
+}
+
+static
+b8 merge_partial_file(Cloc *cloc, char *file_path, Arena *keys, String_Table *files_by_path) {
+    s64 size;
+    u8 *data = os_map_file(file_path, &size);
+    if(!data) {
+        printf("[ERROR]: Failed to read the partial results file '%s'.\n", file_path);
+        return false;
+    }
+
+    if(size < PARTIAL_MAGIC_SIZE || memcmp(data, PARTIAL_MAGIC, PARTIAL_MAGIC_SIZE) != 0) {
+        printf("[ERROR]: The file '%s' is not a partial results file.\n", file_path);
+        os_unmap_file(data, size);
+        return false;
+    }
+
+    Partial_Reader reader = { data, size, PARTIAL_MAGIC_SIZE, true };
+
+    u32 version = read_partial_u32(&reader);
+    if(version > PARTIAL_VERSION) {
+        printf("[ERROR]: The partial results file '%s' was written by a newer version of cloc.\n", file_path);
+        os_unmap_file(data, size);
+        return false;
+    }
+
+    read_partial_u32(&reader); // Shard index
+    read_partial_u32(&reader); // Shard count
+    u64 language_count  = read_partial_u32(&reader);
+    u64 directory_count = read_partial_u64(&reader);
+    u64 file_count      = read_partial_u64(&reader);
+
+    // Every entry takes up at least a few bytes, which protects us from absurd allocations on corrupt files.
+    if(language_count > (u64) size || directory_count > (u64) size || file_count > (u64) size) reader.valid = false;
+
+    Language *languages          = reader.valid ? malloc(max(language_count, 1) * sizeof(Language)) : NULL;
+    Directory_Node **directories = reader.valid ? malloc(max(directory_count, 1) * sizeof(Directory_Node *)) : NULL;
+    s64 unknown_language_count   = 0;
+
+    for(u64 i = 0; reader.valid && i < language_count; ++i) {
+        s64 length;
+        char *name = read_partial_string(&reader, &length);
+        Stats ignored;
+        read_partial_stats(&reader, &ignored); // The language totals are recomputed from the deduplicated files
+        languages[i] = name ? find_language_by_name(name, length) : LANGUAGE_COUNT;
+    }
+
+    for(u64 i = 0; reader.valid && i < directory_count; ++i) {
+        u64 parent_index = read_partial_u64(&reader);
+        s64 length;
+        char *name = read_partial_string(&reader, &length);
+        if(!reader.valid || parent_index > i) {
+            reader.valid = false;
+            break;
+        }
+
+        Directory_Node *parent = parent_index ? directories[parent_index - 1] : &cloc->root_directory;
+        directories[i] = get_or_create_child_directory(&cloc->perm, parent, name, length);
+    }
+
+    for(u64 i = 0; reader.valid && i < file_count; ++i) {
+        u64 directory_index = read_partial_u64(&reader);
+        u64 language_index  = read_partial_u32(&reader);
+        u64 status          = read_partial_u32(&reader);
+        Stats stats;
+        read_partial_stats(&reader, &stats);
+        s64 length;
+        char *name = read_partial_string(&reader, &length);
+        if(!reader.valid || directory_index >= directory_count || language_index >= language_count || status >= FILE_STATUS_COUNT) {
+            reader.valid = false;
+            break;
+        }
+
+        if(languages[language_index] == LANGUAGE_COUNT) {
+            ++unknown_language_count;
+            continue;
+        }
+
+        //
+        // Files that appear in multiple partial results (e.g. because two runs overlapped) are only
+        // counted once, the first occurrence wins.
+        //
+        File probe = { 0 };
+        probe.directory = directories[directory_index];
+        probe.name      = push_arena(keys, length + 1);
+        memcpy(probe.name, name, length);
+        probe.name[length] = 0;
+
+        char *key = get_file_path(keys, &probe, NULL);
+        if(string_table_query(files_by_path, key)) continue;
+
+        File *entry      = push_arena(&cloc->perm, sizeof(File));
+        entry->next      = cloc->first_file;
+        entry->directory = probe.directory;
+        entry->name      = push_string(&cloc->perm, probe.name);
+        entry->language  = languages[language_index];
+        entry->status    = (File_Status) status;
+        entry->index     = (u32) cloc->file_count;
+        entry->read_position = 0;
+        entry->bytes     = 0;
+        entry->stats     = stats;
+        entry->stats.ident = entry->name;
+        cloc->first_file = entry;
+        ++cloc->file_count;
+
+        string_table_insert(files_by_path, key, entry);
+    }
+
+    if(!reader.valid) printf("[ERROR]: The partial results file '%s' is corrupted.\n", file_path);
+    if(unknown_language_count) printf("[WARNING]: Skipped %" PRId64 " files with unknown languages in '%s'.\n", unknown_language_count, file_path);
+
+    free(languages);
+    free(directories);
+    os_unmap_file(data, size);
+    return reader.valid;
+}
+
+b8 merge_partial_results(Cloc *cloc, String_List *file_paths) {
+    Arena keys;
+    create_arena(&keys, PARTIAL_KEY_ARENA_SIZE);
+
+    String_Table files_by_path;
+    create_string_table(&files_by_path, 1024);
+
+    b8 success = true;
+    for(String_List *file_path = file_paths; file_path && success; file_path = file_path->next) {
+        success = merge_partial_file(cloc, file_path->content, &keys, &files_by_path);
+    }
+
+    destroy_string_table(&files_by_path);
+    destroy_arena(&keys);
+    return success;
+}
@@ -0,0 +1,41 @@
+struct Cloc;
+
+#define PARTIAL_MAGIC "CLOCPART"
+#define PARTIAL_MAGIC_SIZE 8
+#define PARTIAL_VERSION 1
+#define PARTIAL_KEY_ARENA_SIZE 64 * 1024 * 1024
+
+//
+// A partial result file stores the outcome of one (possibly sharded) run, so that several runs can later be
+// merged into one report. All integers are little endian, strings are stored as a u32 length followed by
+// the bytes without a null terminator.
+//
+//   Header:      magic[8], u32 version, u32 shard index, u32 shard count,
+//                u32 language count, u64 directory count, u64 file count
+//   Languages:   string name, s64 blank, s64 comment, s64 code, s64 file count
+//   Directories: u64 parent (0 for the root, otherwise the index of the parent + 1), string name
+//   Files:       u64 directory index, u32 language index, u32 status,
+//                s64 blank, s64 comment, s64 code, s64 file count, string name
+//
+// Directories are written in pre-order, so that every parent is known before its children. Languages are
+// referenced by name, so that adding new languages doesn't invalidate older partial files.
+//
+
+typedef struct Partial_Reader {
+    u8 *data;
+    s64 size;
+    s64 offset;
+    b8 valid; // Set as soon as we try to read past the end of the file
+} Partial_Reader;
+
+// The binary encoding, which the cache uses as well.
+void write_partial_u32(FILE *file, u32 value);
+void write_partial_u64(FILE *file, u64 value);
+void write_partial_string(FILE *file, const char *string, s64 length);
+u8 *read_partial_bytes(Partial_Reader *reader, s64 count);
+u32 read_partial_u32(Partial_Reader *reader);
+u64 read_partial_u64(Partial_Reader *reader);
+char *read_partial_string(Partial_Reader *reader, s64 *length);
+
+b8 write_partial_results(struct Cloc *cloc, char *file_path);
+b8 merge_partial_results(struct Cloc *cloc, String_List *file_paths);
@@ -16,7 +16,8 @@ OS_Path_Kind os_resolve_path_kind(char *path) {
 }
 
 char *os_make_absolute_path(Arena *arena, char *path) {
-    return push_string(arena, realpath(path, posix_string_buffer));
+    char *resolved_path = realpath(path, posix_string_buffer);
+    return resolved_path ? push_string(arena, resolved_path) : NULL;
 }
 
 File_Handle os_open_file(char *path) {
@@ -32,6 +33,28 @@ s64 os_get_file_size(File_Handle handle) {
     }
 }
 
+s64 os_get_file_size_by_path(char *path) {
+    struct stat filestat;
+    if(stat(path, &filestat) == 0) {
+        return filestat.st_size;
+    } else {
+        return 0;
+    }
+}
+
+b8 os_get_file_identity(char *path, u64 *device, u64 *inode) {
+    struct stat filestat;
+    if(stat(path, &filestat) != 0) return false;
+
+    *device = filestat.st_dev;
+    *inode  = filestat.st_ino;
+    return true;
+}
+
+b8 os_create_directory(char *path) {
+    return mkdir(path, 0777) == 0 || errno == EEXIST;
+}
+
 s64 os_read_file(File_Handle handle, char *dst, s64 offset, s64 size) {
     lseek(handle, offset, SEEK_SET);
     return read(handle, dst, size);
@@ -41,38 +64,114 @@ void os_close_file(File_Handle handle) {
     close(handle);
 }
 
+void *os_reserve_memory(s64 size) {
+    void *pointer = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return pointer != MAP_FAILED ? pointer : NULL;
+}
+
+b8 os_commit_memory(void *pointer, s64 size) {
+    return mprotect(pointer, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void os_release_memory(void *pointer, s64 size) {
+    munmap(pointer, size);
+}
+
+void *os_map_file(char *path, s64 *size) {
+    int handle = open(path, O_RDONLY);
+    if(handle < 0) return NULL;
 
+    struct stat filestat;
+    if(fstat(handle, &filestat) != 0 || filestat.st_size == 0) {
+        close(handle);
+        return NULL;
+    }
+
+    void *pointer = mmap(NULL, filestat.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+    close(handle);
+    if(pointer == MAP_FAILED) return NULL;
+
+    *size = filestat.st_size;
+    return pointer;
+}
 
-File_Iterator find_first_file(Arena *arena, char *directory_path) {
+void os_unmap_file(void *pointer, s64 size) {
+    munmap(pointer, size);
+}
+
+
+
+File_Iterator find_first_file(Arena *arena, char *directory_path, b8 follow_symlinks) {
     File_Iterator iterator;
-    iterator.native_handle = opendir(directory_path);
-    find_next_file(arena, &iterator);
+    iterator.native_handle    = opendir(directory_path);
+    iterator.valid            = false;
+    iterator.follow_symlinks  = follow_symlinks;
+    iterator.device           = 0;
+    iterator.directory_device = 0;
+
+    if(iterator.native_handle) {
+        //
+        // Regular files live on the device of their directory, so they don't need to be looked at one by
+        // one. Only directories may be mount points, and only symlinks may point anywhere else.
+        //
+        struct stat filestat;
+        if(follow_symlinks && fstat(dirfd(iterator.native_handle), &filestat) == 0) iterator.directory_device = filestat.st_dev;
+        find_next_file(arena, &iterator);
+    }
+
     return iterator;
 }
 
+static
+b8 posix_resolve_iterator_entry(File_Iterator *iterator, char *name, int flags) {
+    struct stat filestat;
+    if(fstatat(dirfd(iterator->native_handle), name, &filestat, flags) != 0) return false; // E.g. a dangling symlink
+
+    if(S_ISDIR(filestat.st_mode)) {
+        iterator->kind = OS_PATH_Is_Directory;
+    } else if(S_ISREG(filestat.st_mode)) {
+        iterator->kind = OS_PATH_Is_File;
+    } else {
+        return false;
+    }
+
+    iterator->inode  = filestat.st_ino;
+    iterator->device = filestat.st_dev;
+    return true;
+}
+
 void find_next_file(Arena *arena, File_Iterator *iterator) {
+    (void) arena; // Only needed on windows, where the names are copied into it
     iterator->valid = false;
 
     struct dirent *entry = NULL;
     while(!iterator->valid && (entry = readdir(iterator->native_handle))) {
         switch(entry->d_type) {
         case DT_DIR:
-            iterator->path  = entry->d_name;
-            iterator->kind  = OS_PATH_Is_Directory;
-            iterator->valid = true;
+            iterator->path   = entry->d_name;
+            iterator->kind   = OS_PATH_Is_Directory;
+            iterator->inode  = entry->d_ino;
+            iterator->valid  = !iterator->follow_symlinks || posix_resolve_iterator_entry(iterator, entry->d_name, AT_SYMLINK_NOFOLLOW);
             break;
 
         case DT_REG:
-            iterator->path = entry->d_name;
-            iterator->kind = OS_PATH_Is_File;
-            iterator->valid = true;
+            iterator->path   = entry->d_name;
+            iterator->kind   = OS_PATH_Is_File;
+            iterator->inode  = entry->d_ino;
+            iterator->device = iterator->directory_device;
+            iterator->valid  = true;
+            break;
+
+        case DT_LNK:
+            iterator->path   = entry->d_name;
+            iterator->valid  = iterator->follow_symlinks && posix_resolve_iterator_entry(iterator, entry->d_name, 0);
             break;
         }
     }
 }
 
 void close_file_iterator(File_Iterator *iterator) {
-    closedir(iterator->native_handle);
+    if(iterator->native_handle) closedir(iterator->native_handle);
     iterator->native_handle = NULL;
     iterator->valid = false;
 }
@@ -83,6 +182,36 @@ s64 os_get_hardware_thread_count() {
     return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
+u64 os_get_physical_file_offset(char *path) {
+    int handle = open(path, O_RDONLY);
+    if(handle < 0) return 0;
+
+    //
+    // We only care about where the file starts, so a single extent is enough.
+    //
+    u64 buffer[(sizeof(struct fiemap) + sizeof(struct fiemap_extent)) / sizeof(u64) + 1];
+    memset(buffer, 0, sizeof(buffer));
+
+    struct fiemap *map = (struct fiemap *) buffer;
+    map->fm_start        = 0;
+    map->fm_length       = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+
+    u64 offset = 0;
+    if(ioctl(handle, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0) offset = map->fm_extents[0].fe_physical;
+
+    close(handle);
+    return offset;
+}
+
+void os_hint_file_read(File_Handle handle) {
+    if(handle >= 0) posix_fadvise(handle, 0, 0, POSIX_FADV_WILLNEED);
+}
+
+s64 os_count_set_bits(u32 value) {
+    return __builtin_popcount(value);
+}
+
 Pid os_spawn_thread(int (*procedure)(void *), void *argument) {
     Pid pid;
     pthread_create(&pid, NULL, (void *) procedure, argument);
@@ -98,6 +227,55 @@ void *os_compare_and_swap(void *volatile *dst, void *exchange, void *comparand)
     return __sync_val_compare_and_swap(dst, comparand, exchange);
 }
 
+void os_create_mutex(OS_Mutex *mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void os_destroy_mutex(OS_Mutex *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void os_lock_mutex(OS_Mutex *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void os_unlock_mutex(OS_Mutex *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void os_create_condition(OS_Condition *condition) {
+    pthread_cond_init(condition, NULL);
+}
+
+void os_destroy_condition(OS_Condition *condition) {
+    pthread_cond_destroy(condition);
+}
+
+void os_wait_condition(OS_Condition *condition, OS_Mutex *mutex) {
+    pthread_cond_wait(condition, mutex);
+}
+
+void os_wait_condition_timeout(OS_Condition *condition, OS_Mutex *mutex, s64 milliseconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec  += milliseconds / 1000;
+    deadline.tv_nsec += (milliseconds % 1000) * 1000000;
+    if(deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec  += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_cond_timedwait(condition, mutex, &deadline);
+}
+
+void os_signal_condition(OS_Condition *condition) {
+    pthread_cond_signal(condition);
+}
+
+void os_broadcast_condition(OS_Condition *condition) {
+    pthread_cond_broadcast(condition);
+}
+
 Hardware_Time os_get_hardware_time() {
     struct timespec time;
     clock_gettime(CLOCK_MONOTONIC, &time);
@@ -119,3 +297,76 @@ s64 os_get_working_set_size() {
     getrusage(RUSAGE_SELF, &usage);
     return usage.ru_maxrss * 1000;
 }
+
+
+
+b8 os_open_hardware_counters(OS_Hardware_Counters *counters) {
+    const u32 TYPES[OS_COUNTER_COUNT]   = { PERF_TYPE_SOFTWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+    const u64 CONFIGS[OS_COUNTER_COUNT] = { PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES };
+
+    //
+    // All counters are in one group that is led by the CPU time, so that the kernel always schedules them
+    // together and one read gets all of them. Unprivileged users may only count user space (with the default
+    // perf_event_paranoid setting), so fall back to that instead of giving up.
+    //
+    counters->available = 0;
+    b8 exclude_kernel   = false;
+
+    for(s64 i = 0; i < OS_COUNTER_COUNT; ++i) {
+        struct perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.size           = sizeof(attributes);
+        attributes.type           = TYPES[i];
+        attributes.config         = CONFIGS[i];
+        attributes.disabled       = i == 0;
+        attributes.exclude_kernel = exclude_kernel;
+        attributes.exclude_hv     = true;
+        attributes.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int leader = i == 0 ? -1 : (int) counters->handles[0];
+        int handle = syscall(SYS_perf_event_open, &attributes, 0, -1, leader, PERF_FLAG_FD_CLOEXEC);
+        if(handle < 0 && (errno == EACCES || errno == EPERM) && !exclude_kernel && i == 0) {
+            exclude_kernel = true;
+            attributes.exclude_kernel = true;
+            handle = syscall(SYS_perf_event_open, &attributes, 0, -1, leader, PERF_FLAG_FD_CLOEXEC);
+        }
+
+        counters->handles[i] = handle;
+        if(handle < 0) {
+            if(i == 0) return false;
+            continue;
+        }
+
+        counters->available |= 1 << i;
+    }
+
+    ioctl((int) counters->handles[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void os_read_hardware_counters(OS_Hardware_Counters *counters, u64 values[OS_COUNTER_COUNT]) {
+    memset(values, 0, OS_COUNTER_COUNT * sizeof(u64));
+    if(!counters->available) return;
+
+    // The values come in the order in which the counters joined the group, after the number of values and the times.
+    u64 buffer[3 + OS_COUNTER_COUNT];
+    if(read((int) counters->handles[0], buffer, sizeof(buffer)) < (ssize_t) (3 * sizeof(u64))) return;
+
+    // If there are more counters than the CPU has registers, the kernel multiplexes them, so extrapolate.
+    u64 enabled = buffer[1], running = buffer[2];
+    f64 scale   = running ? (f64) enabled / (f64) running : 0.;
+
+    s64 index = 0;
+    for(s64 i = 0; i < OS_COUNTER_COUNT && index < (s64) buffer[0]; ++i) {
+        if(counters->available & (1 << i)) values[i] = (u64) (buffer[3 + index++] * scale);
+    }
+}
+
+void os_close_hardware_counters(OS_Hardware_Counters *counters) {
+    for(s64 i = OS_COUNTER_COUNT - 1; i >= 0; --i) {
+        if(counters->handles[i] >= 0) close((int) counters->handles[i]);
+        counters->handles[i] = -1;
+    }
+
+    counters->available = 0;
+}
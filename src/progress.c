@@ -0,0 +1,85 @@
+/* ------------------------------------------------ Reporter ------------------------------------------------ */
+
+static
+void print_progress_line(Progress *progress) {
+    Cloc *cloc = progress->cloc;
+    char line[256];
+    s64 length;
+
+    // Only the main thread changes the file count, but it does so while the reporter is running.
+    s64 discovered = *(volatile s64 *) &cloc->file_count;
+
+    if(!progress->counting) {
+        length = snprintf(line, sizeof(line), "Discovered %" PRId64 " files", discovered);
+    } else {
+        s64 files = 0, bytes = 0, lines = 0;
+        for(s64 i = 0; i < cloc->active_workers; ++i) {
+            files += cloc->workers[i].progress.files_done;
+            bytes += cloc->workers[i].progress.bytes_done;
+            lines += cloc->workers[i].progress.lines_done;
+        }
+
+        f64 seconds = os_convert_hardware_time_to_seconds(os_get_hardware_time() - progress->counting_start);
+        if(seconds <= 0) seconds = 1e-9;
+
+        length = snprintf(line, sizeof(line), "%" PRId64 "/%" PRId64 " files // %.1fmb/s // %" PRId64 " l/s", files, discovered, bytes / seconds / 1000000, (s64) (lines / seconds));
+
+        // All files are known by now, so the remaining time simply follows from the rate of files so far.
+        if(files > 0 && files < discovered) {
+            s64 milliseconds = (s64) (seconds * 1000);
+            s64 eta = ((discovered - files) * milliseconds + files * 1000 - 1) / (files * 1000); // Rounded up to whole seconds
+            length += snprintf(line + length, sizeof(line) - length, " // ETA %" PRId64 ":%02" PRId64, eta / 60, eta % 60);
+        }
+    }
+
+    fprintf(stderr, "\r%s%*s", line, (int) max(progress->line_length - length, 0), "");
+    fflush(stderr);
+    progress->line_length = length;
+}
+
+static
+int progress_reporter_thread(Progress *progress) {
+    os_lock_mutex(&progress->mutex);
+    while(!progress->finished) {
+        print_progress_line(progress);
+        os_wait_condition_timeout(&progress->condition, &progress->mutex, PROGRESS_INTERVAL_MILLISECONDS);
+    }
+    os_unlock_mutex(&progress->mutex);
+
+    fprintf(stderr, "\r%*s\r", (int) progress->line_length, "");
+    fflush(stderr);
+    return 0;
+}
+
+
+
+/* -------------------------------------------------- Setup -------------------------------------------------- */
+
+Progress *start_progress_reporter(Cloc *cloc) {
+    Progress *progress = malloc(sizeof(Progress));
+    memset(progress, 0, sizeof(Progress));
+    progress->cloc = cloc;
+    os_create_mutex(&progress->mutex);
+    os_create_condition(&progress->condition);
+    progress->pid = os_spawn_thread((int(*)(void *)) progress_reporter_thread, progress);
+    return progress;
+}
+
+void start_progress_counting(Progress *progress) {
+    os_lock_mutex(&progress->mutex);
+    progress->counting       = true;
+    progress->counting_start = os_get_hardware_time();
+    os_unlock_mutex(&progress->mutex);
+}
+
+void stop_progress_reporter(Progress *progress) {
+    os_lock_mutex(&progress->mutex);
+    progress->finished = true;
+    os_signal_condition(&progress->condition);
+    os_unlock_mutex(&progress->mutex);
+
+    os_join_thread(progress->pid);
+    os_destroy_condition(&progress->condition);
+    os_destroy_mutex(&progress->mutex);
+    free(progress);
+}
@@ -0,0 +1,25 @@
+struct Cloc;
+
+#define PROGRESS_INTERVAL_MILLISECONDS 250
+
+//
+// With '--progress', a separate thread prints a status line to stderr a few times per second, while the
+// files are discovered and counted. The workers never talk to it, they only bump the counters in their own
+// Worker_Progress, which the reporter sums up whenever it wakes up. The status line is removed again before
+// the tables are printed.
+//
+
+typedef struct Progress {
+    struct Cloc *cloc;
+    Pid pid;
+    OS_Mutex mutex;
+    OS_Condition condition;
+    b8 finished;
+    b8 counting;                  // Set once the traversal is done and the workers were spawned
+    Hardware_Time counting_start;
+    s64 line_length;              // Of the last status line, so that it can be overwritten completely
+} Progress;
+
+Progress *start_progress_reporter(struct Cloc *cloc);
+void start_progress_counting(Progress *progress);
+void stop_progress_reporter(Progress *progress);
@@ -0,0 +1,414 @@
+static const char *REPORT_VIEW_NAMES[REPORT_VIEW_COUNT]     = { "language", "file", "directory" };
+static const char *REPORT_VIEW_HEADERS[REPORT_VIEW_COUNT]   = { "Language", "File", "Directory" };
+static const char *REPORT_FORMAT_NAMES[REPORT_FORMAT_COUNT] = { "table", "csv", "json" };
+
+static
+s64 find_report_name(const char **names, s64 count, const char *name) {
+    for(s64 i = 0; i < count; ++i) {
+        if(strcmp(names[i], name) == 0) return i;
+    }
+
+    return count;
+}
+
+b8 add_report(Cloc *cloc, char *spec) {
+    char *view_name = push_string(&cloc->perm, spec);
+
+    char *path = strchr(view_name, '=');
+    if(path) *path++ = 0;
+
+    char *format_name = strchr(view_name, ':');
+    if(format_name) *format_name++ = 0;
+
+    s64 view   = find_report_name(REPORT_VIEW_NAMES, REPORT_VIEW_COUNT, view_name);
+    s64 format = format_name ? find_report_name(REPORT_FORMAT_NAMES, REPORT_FORMAT_COUNT, format_name) : REPORT_FORMAT_Table;
+
+    if(view == REPORT_VIEW_COUNT) {
+        printf("[ERROR]: Unknown report view '%s', expected 'language', 'file' or 'directory'.\n", view_name);
+        return false;
+    }
+
+    if(format == REPORT_FORMAT_COUNT) {
+        printf("[ERROR]: Unknown report format '%s', expected 'table', 'csv' or 'json'.\n", format_name);
+        return false;
+    }
+
+    Report *report = push_arena(&cloc->perm, sizeof(Report));
+    memset(report, 0, sizeof(Report));
+    report->cloc   = cloc;
+    report->view   = (Report_View) view;
+    report->format = (Report_Format) format;
+    report->path   = path && path[0] && strcmp(path, "-") != 0 ? path : NULL;
+
+    // Keep the order of the command line, which is the order of the reports on the standard output.
+    Report **tail = &cloc->first_report;
+    while(*tail) tail = &(*tail)->next;
+    *tail = report;
+    return true;
+}
+
+b8 reports_write_data_to_standard_output(Cloc *cloc) {
+    for(Report *report = cloc->first_report; report != NULL; report = report->next) {
+        if(!report->path && report->format != REPORT_FORMAT_Table) return true;
+    }
+
+    return false;
+}
+
+
+
+/* ------------------------------------------------ Aggregation ------------------------------------------------ */
+
+typedef struct Report_Directory_Entry {
+    Directory_Node *directory;
+    Stats stats;
+} Report_Directory_Entry;
+
+static
+b8 is_reported_file(Cloc *cloc, File *file) {
+    return file->stats.file_count > 0 && (file->status == FILE_Source || (file->status == FILE_Generated && cloc->report_generated));
+}
+
+static
+Directory_Node *find_reported_common_directory(Cloc *cloc) {
+    Directory_Node *common_directory = NULL;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        if(!is_reported_file(cloc, file)) continue;
+        common_directory = common_directory ? find_common_directory(common_directory, file->directory) : file->directory;
+    }
+
+    return common_directory;
+}
+
+static
+int compare_report_rows(const void *lhs, const void *rhs) {
+    const Stats *a = lhs, *b = rhs;
+    if(a->code != b->code) return a->code > b->code ? -1 : 1;
+    if(a->file_count != b->file_count) return a->file_count > b->file_count ? -1 : 1;
+    return strcmp(a->ident, b->ident);
+}
+
+static
+int compare_report_directory_entries(const void *lhs, const void *rhs) {
+    const Report_Directory_Entry *a = lhs, *b = rhs;
+    if(a->directory == b->directory) return 0;
+    return (uintptr_t) a->directory < (uintptr_t) b->directory ? -1 : 1;
+}
+
+static
+void collect_report_rows(Report *report) {
+    Cloc *cloc = report->cloc;
+
+    switch(report->view) {
+    case REPORT_VIEW_Language: {
+        create_arena(&report->arena, REPORT_ARENA_SIZE);
+        report->rows = malloc(LANGUAGE_COUNT * sizeof(Stats));
+
+        for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+            Stats stats = cloc->totals.language_stats[FILE_Source][i];
+            if(cloc->report_generated) combine_stats(&stats, &cloc->totals.language_stats[FILE_Generated][i]);
+            stats.ident = LANGUAGE_STRINGS[i];
+            if(stats.file_count > 0) report->rows[report->row_count++] = stats;
+        }
+    } break;
+
+    case REPORT_VIEW_File: {
+        //
+        // The arena is sized for the idents up front, since there is one for every counted file.
+        //
+        Directory_Node *common_directory = find_reported_common_directory(cloc);
+        s64 ident_bytes = 0;
+        for(File *file = cloc->first_file; file != NULL; file = file->next) {
+            if(is_reported_file(cloc, file)) ident_bytes += get_file_path_length(file, common_directory) + 1;
+        }
+
+        create_arena(&report->arena, REPORT_ARENA_SIZE + ident_bytes);
+        report->rows = malloc(max(cloc->file_count, 1) * sizeof(Stats));
+
+        for(File *file = cloc->first_file; file != NULL; file = file->next) {
+            if(!is_reported_file(cloc, file)) continue;
+            Stats *row = &report->rows[report->row_count++];
+            *row = file->stats;
+            row->ident = get_file_path(&report->arena, file, common_directory);
+        }
+    } break;
+
+    case REPORT_VIEW_Directory: {
+        //
+        // Group the files by sorting them by their directory, so that this doesn't need to store anything in
+        // the shared directory trie while other reports are reading it.
+        //
+        Report_Directory_Entry *entries = malloc(max(cloc->file_count, 1) * sizeof(Report_Directory_Entry));
+        s64 entry_count = 0;
+        for(File *file = cloc->first_file; file != NULL; file = file->next) {
+            if(is_reported_file(cloc, file)) entries[entry_count++] = (Report_Directory_Entry) { file->directory, file->stats };
+        }
+
+        qsort(entries, entry_count, sizeof(Report_Directory_Entry), compare_report_directory_entries);
+
+        Directory_Node *common_directory = find_reported_common_directory(cloc);
+        s64 ident_bytes = 0;
+        for(s64 i = 0; i < entry_count; ++i) {
+            if(i == 0 || entries[i].directory != entries[i - 1].directory) ident_bytes += 2 * (entries[i].directory->path_length + 2);
+        }
+
+        create_arena(&report->arena, REPORT_ARENA_SIZE + ident_bytes);
+        report->rows = malloc(max(entry_count, 1) * sizeof(Stats));
+
+        for(s64 i = 0; i < entry_count; ++i) {
+            Directory_Node *directory = entries[i].directory;
+
+            if(i == 0 || directory != entries[i - 1].directory) {
+                Stats *row = &report->rows[report->row_count++];
+                memset(row, 0, sizeof(Stats));
+                row->ident = "./";
+
+                if(directory != common_directory) {
+                    char *path = get_directory_path(&report->arena, directory);
+                    row->ident = aprint(&report->arena, "%s/", &path[common_directory->path_length]);
+                }
+            }
+
+            combine_stats(&report->rows[report->row_count - 1], &entries[i].stats);
+        }
+
+        free(entries);
+    } break;
+
+    default: break;
+    }
+
+    report->sum.ident = "SUM:";
+    for(s64 i = 0; i < report->row_count; ++i) combine_stats(&report->sum, &report->rows[i]);
+
+    qsort(report->rows, report->row_count, sizeof(Stats), compare_report_rows);
+}
+
+
+
+/* ------------------------------------------------ Formatting ------------------------------------------------ */
+
+static
+void append_report_output(Report *report, const char *data, s64 size) {
+    if(report->output_size + size > report->output_capacity) {
+        report->output_capacity = max(max(report->output_capacity * 2, report->output_size + size), REPORT_OUTPUT_INITIAL_CAPACITY);
+        report->output = realloc(report->output, report->output_capacity);
+    }
+
+    memcpy(&report->output[report->output_size], data, size);
+    report->output_size += size;
+}
+
+//
+// Every line is built in the arena of the report like the lines of the tables, then copied into the output
+// buffer, so that the arena only ever holds one line besides the idents.
+//
+static
+s64 begin_report_line(Report *report, String_Builder *builder) {
+    s64 mark = mark_arena(&report->arena);
+    create_string_builder(builder, &report->arena);
+    return mark;
+}
+
+static
+void finish_report_line(Report *report, String_Builder *builder, s64 mark) {
+    append_char(builder, '\n');
+    append_report_output(report, builder->pointer, builder->size_in_characters);
+    reset_arena(&report->arena, mark);
+}
+
+static
+void format_report_table(Report *report) {
+    Cloc *cloc = report->cloc;
+    b8 is_language_entries = report->view != REPORT_VIEW_File; // Directories also have a file count
+
+    String_Builder builder;
+    s64 mark = begin_report_line(report, &builder);
+    append_separator_line(&builder, CLOC_VERSION_STRING);
+    finish_report_line(report, &builder, mark);
+
+    mark = begin_report_line(report, &builder);
+    append_table_header(&builder, REPORT_VIEW_HEADERS[report->view], is_language_entries);
+    finish_report_line(report, &builder, mark);
+
+    mark = begin_report_line(report, &builder);
+    append_separator_line(&builder, "");
+    finish_report_line(report, &builder, mark);
+
+    for(s64 i = 0; i < report->row_count; ++i) {
+        mark = begin_report_line(report, &builder);
+        append_table_entry(&builder, report->rows[i].ident, &report->rows[i], is_language_entries);
+        finish_report_line(report, &builder, mark);
+    }
+
+    if(report->sum.file_count > 1) {
+        mark = begin_report_line(report, &builder);
+        append_separator_line(&builder, "");
+        finish_report_line(report, &builder, mark);
+
+        mark = begin_report_line(report, &builder);
+        append_table_entry(&builder, report->sum.ident, &report->sum, is_language_entries);
+        finish_report_line(report, &builder, mark);
+    }
+
+    s64 *status_counts = cloc->totals.status_counts;
+    s64 skipped_generated = cloc->skip_generated ? status_counts[FILE_Generated] : 0;
+    if(status_counts[FILE_Binary] > 0 || skipped_generated > 0) {
+        mark = mark_arena(&report->arena);
+        char *content;
+        if(skipped_generated > 0) {
+            content = aprint(&report->arena, "Skipped %" PRId64 " binary, %" PRId64 " generated files", status_counts[FILE_Binary], skipped_generated);
+        } else {
+            content = aprint(&report->arena, "Skipped %" PRId64 " binary files", status_counts[FILE_Binary]);
+        }
+
+        create_string_builder(&builder, &report->arena);
+        append_separator_line(&builder, content);
+        finish_report_line(report, &builder, mark);
+    }
+}
+
+static
+void append_csv_field(String_Builder *builder, const char *field) {
+    if(!strpbrk(field, ",\"\r\n")) {
+        append_string(builder, field);
+        return;
+    }
+
+    append_char(builder, '"');
+    for(const char *c = field; *c; ++c) {
+        if(*c == '"') append_char(builder, '"');
+        append_char(builder, *c);
+    }
+    append_char(builder, '"');
+}
+
+static
+void format_report_csv(Report *report) {
+    // No sum row, since every consumer of the file can add up the columns itself.
+    String_Builder builder;
+    s64 mark = begin_report_line(report, &builder);
+    append_string(&builder, REPORT_VIEW_NAMES[report->view]);
+    append_string(&builder, ",files,empty,comment,code");
+    finish_report_line(report, &builder, mark);
+
+    for(s64 i = 0; i < report->row_count; ++i) {
+        Stats *row = &report->rows[i];
+        mark = begin_report_line(report, &builder);
+        append_csv_field(&builder, row->ident);
+        sprint(&builder, ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64, row->file_count, row->blank, row->comment, row->code);
+        finish_report_line(report, &builder, mark);
+    }
+}
+
+static
+void append_json_string(String_Builder *builder, const char *string) {
+    append_char(builder, '"');
+    for(const char *c = string; *c; ++c) {
+        if(*c == '"' || *c == '\\') {
+            append_char(builder, '\\');
+            append_char(builder, *c);
+        } else if((u8) *c < 0x20) {
+            sprint(builder, "\\u%04x", (u8) *c);
+        } else {
+            append_char(builder, *c);
+        }
+    }
+    append_char(builder, '"');
+}
+
+static
+void append_json_stats(String_Builder *builder, Stats *stats) {
+    sprint(builder, "\"files\":%" PRId64 ",\"empty\":%" PRId64 ",\"comment\":%" PRId64 ",\"code\":%" PRId64 "}", stats->file_count, stats->blank, stats->comment, stats->code);
+}
+
+static
+void format_report_json(Report *report) {
+    String_Builder builder;
+    s64 mark = begin_report_line(report, &builder);
+    sprint(&builder, "{\"version\":\"%s\",\"view\":\"%s\",\"rows\":[", CLOC_VERSION_STRING, REPORT_VIEW_NAMES[report->view]);
+    finish_report_line(report, &builder, mark);
+
+    for(s64 i = 0; i < report->row_count; ++i) {
+        mark = begin_report_line(report, &builder);
+        append_string(&builder, "{\"name\":");
+        append_json_string(&builder, report->rows[i].ident);
+        append_char(&builder, ',');
+        append_json_stats(&builder, &report->rows[i]);
+        if(i + 1 < report->row_count) append_char(&builder, ',');
+        finish_report_line(report, &builder, mark);
+    }
+
+    mark = begin_report_line(report, &builder);
+    append_string(&builder, "],\"sum\":{");
+    append_json_stats(&builder, &report->sum);
+    append_char(&builder, '}');
+    finish_report_line(report, &builder, mark);
+}
+
+
+
+/* ------------------------------------------------- Running ------------------------------------------------- */
+
+static
+int report_thread(Report *report) {
+    collect_report_rows(report);
+
+    switch(report->format) {
+    case REPORT_FORMAT_Table: format_report_table(report); break;
+    case REPORT_FORMAT_Csv:   format_report_csv(report);   break;
+    case REPORT_FORMAT_Json:  format_report_json(report);  break;
+    default: break;
+    }
+
+    report->success = true;
+    if(report->path) {
+        FILE *output = fopen(report->path, "wb");
+        if(output) {
+            if(fwrite(report->output, 1, report->output_size, output) != (size_t) report->output_size) report->success = false;
+            if(fclose(output) != 0) report->success = false;
+        } else {
+            report->success = false;
+        }
+    }
+
+    return 0;
+}
+
+b8 run_reports(Cloc *cloc, Stats *sum_stats) {
+    //
+    // The reports only read the counted files, so they can all run at the same time.
+    //
+    for(Report *report = cloc->first_report; report != NULL; report = report->next) {
+        if(cloc->no_jobs || report->next == NULL) {
+            report_thread(report); // The last one simply runs on the main thread
+        } else {
+            report->pid = os_spawn_thread((int(*)(void *)) report_thread, report);
+        }
+    }
+
+    b8 success = true;
+    for(Report *report = cloc->first_report; report != NULL; report = report->next) {
+        if(!cloc->no_jobs && report->next != NULL) os_join_thread(report->pid);
+
+        if(!report->path) {
+            fwrite(report->output, 1, report->output_size, stdout);
+        } else if(!report->success) {
+            printf("[ERROR]: Failed to write the report '%s'.\n", report->path);
+            success = false;
+        }
+    }
+
+    *sum_stats = cloc->first_report->sum;
+    return success;
+}
+
+void destroy_reports(Cloc *cloc) {
+    for(Report *report = cloc->first_report; report != NULL; report = report->next) {
+        if(report->arena.base) destroy_arena(&report->arena);
+        free(report->rows);
+        free(report->output);
+    }
+
+    cloc->first_report = NULL;
+}
@@ -0,0 +1,52 @@
+struct Cloc;
+
+#define REPORT_ARENA_SIZE (1024 * 1024) // For formatting lines, the idents of the rows come on top of that
+#define REPORT_OUTPUT_INITIAL_CAPACITY (64 * 1024)
+
+//
+// A single scan can produce many reports with '--report <view>[:<format>][=<path>]', e.g. a language table
+// on the console, a csv file per file and a json file per directory, instead of counting the tree once for
+// each of them. All reports are built from the same counted files once the workers are done, each on its own
+// thread with its own arena and output buffer, since they only ever read the results. Reports for the
+// standard output are printed in the order they were specified after all of them are done.
+//
+// Like the history, the reports cover the source files, and the generated files if they are reported.
+//
+
+typedef enum Report_View {
+    REPORT_VIEW_Language,
+    REPORT_VIEW_File,
+    REPORT_VIEW_Directory, // The files directly inside each directory, relative to the common directory
+    REPORT_VIEW_COUNT,
+} Report_View;
+
+typedef enum Report_Format {
+    REPORT_FORMAT_Table,
+    REPORT_FORMAT_Csv,
+    REPORT_FORMAT_Json,
+    REPORT_FORMAT_COUNT,
+} Report_Format;
+
+typedef struct Report {
+    struct Report *next;
+    struct Cloc *cloc;
+    Report_View view;
+    Report_Format format;
+    char *path; // NULL for the standard output
+    Pid pid;
+    b8 success;
+
+    Arena arena;
+    Stats *rows; // Sorted like the tables, by code lines
+    s64 row_count;
+    Stats sum;
+
+    char *output;
+    s64 output_size;
+    s64 output_capacity;
+} Report;
+
+b8 add_report(struct Cloc *cloc, char *spec); // False if the spec is invalid
+b8 reports_write_data_to_standard_output(struct Cloc *cloc);
+b8 run_reports(struct Cloc *cloc, Stats *sum_stats);
+void destroy_reports(struct Cloc *cloc);
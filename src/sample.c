@@ -0,0 +1,314 @@
+/* ------------------------------------------------ Selection ------------------------------------------------ */
+
+static
+u64 next_sample_random(u64 *state) {
+    // splitmix64, which is good enough for picking files and keeps the sample reproducible.
+    u64 z = (*state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+//
+// The build doesn't link libm, so the little floating point math needed here is done by hand. All values
+// are non-negative.
+//
+static
+s64 round_sample_value(f64 value) {
+    return (s64) (value + 0.5);
+}
+
+static
+s64 ceil_sample_value(f64 value) {
+    s64 result = (s64) value;
+    return (f64) result < value ? result + 1 : result;
+}
+
+static
+f64 sample_square_root(f64 value) {
+    if(value <= 0) return 0;
+
+    // Newton's method, starting above the root so that every step moves down until it converges.
+    f64 root = value > 1 ? value : 1;
+    while(true) {
+        f64 next = 0.5 * (root + value / root);
+        if(next >= root) break;
+        root = next;
+    }
+
+    return root;
+}
+
+static
+s64 get_sample_size_class(s64 size) {
+    s64 size_class = 0;
+    while(size > 0) {
+        ++size_class;
+        size >>= 1;
+    }
+
+    return min(size_class, SAMPLE_SIZE_CLASSES - 1);
+}
+
+typedef struct Sample_Size_Job {
+    File **files;
+    s64 *sizes;
+    s64 first;
+    s64 end;
+    Pid pid;
+} Sample_Size_Job;
+
+static
+int measure_sample_files(Sample_Size_Job *job) {
+    char *path = NULL;
+    s64 path_capacity = 0;
+
+    for(s64 i = job->first; i < job->end; ++i) {
+        s64 length = get_file_path_length(job->files[i], NULL);
+        if(length + 1 > path_capacity) {
+            path_capacity = max(length + 1, path_capacity * 2);
+            path          = realloc(path, path_capacity);
+        }
+
+        write_file_path(path, job->files[i], NULL);
+        job->sizes[i] = os_get_file_size_by_path(path);
+    }
+
+    free(path);
+    return 0;
+}
+
+static
+void measure_sample_population(Cloc *cloc, File **files, s64 *sizes) {
+    //
+    // Querying the size is one system call per file, which adds up for large trees and cold caches, so the
+    // files are split between as many threads as the count itself would use. The main thread takes the
+    // first share.
+    //
+    s64 thread_count = cloc->no_jobs ? 1 : min(min(os_get_hardware_thread_count(), MAX_WORKERS), cloc->file_count);
+    thread_count = max(thread_count, 1);
+
+    Sample_Size_Job jobs[MAX_WORKERS];
+    for(s64 i = 0; i < thread_count; ++i) {
+        jobs[i].files = files;
+        jobs[i].sizes = sizes;
+        jobs[i].first = cloc->file_count * i / thread_count;
+        jobs[i].end   = cloc->file_count * (i + 1) / thread_count;
+        if(i > 0) jobs[i].pid = os_spawn_thread((int(*)(void *)) measure_sample_files, &jobs[i]);
+    }
+
+    measure_sample_files(&jobs[0]);
+    for(s64 i = 1; i < thread_count; ++i) os_join_thread(jobs[i].pid);
+}
+
+Sample *select_sample(Cloc *cloc, f64 fraction, s64 count) {
+    Sample *sample = malloc(sizeof(Sample));
+    memset(sample, 0, sizeof(Sample));
+    sample->population = cloc->file_count;
+    sample->files      = malloc(max(cloc->file_count, 1) * sizeof(File *));
+
+    //
+    // Group the files by stratum with a counting sort. The size is the only thing we need to know about a
+    // file before deciding whether to read it, and it doesn't require opening the file.
+    //
+    const s64 STRATUM_KEY_COUNT = LANGUAGE_COUNT * SAMPLE_SIZE_CLASSES;
+    s64 *stratum_offsets = malloc((STRATUM_KEY_COUNT + 1) * sizeof(s64));
+    u16 *stratum_keys    = malloc(max(cloc->file_count, 1) * sizeof(u16));
+    memset(stratum_offsets, 0, (STRATUM_KEY_COUNT + 1) * sizeof(s64));
+
+    File **files = malloc(max(cloc->file_count, 1) * sizeof(File *));
+    s64 *sizes   = malloc(max(cloc->file_count, 1) * sizeof(s64));
+
+    s64 index = 0;
+    for(File *file = cloc->first_file; file != NULL; file = file->next) files[index++] = file;
+
+    measure_sample_population(cloc, files, sizes);
+
+    for(index = 0; index < cloc->file_count; ++index) {
+        stratum_keys[index] = (u16) (files[index]->language * SAMPLE_SIZE_CLASSES + get_sample_size_class(sizes[index]));
+        ++stratum_offsets[stratum_keys[index] + 1];
+    }
+
+    for(s64 i = 0; i < STRATUM_KEY_COUNT; ++i) {
+        if(stratum_offsets[i + 1]) ++sample->stratum_count;
+        stratum_offsets[i + 1] += stratum_offsets[i];
+    }
+
+    for(index = 0; index < cloc->file_count; ++index) sample->files[stratum_offsets[stratum_keys[index]]++] = files[index];
+
+    //
+    // Every stratum gets its proportional share of the sample, but at least two files, so that we can estimate
+    // its variance. Small strata may therefore push the sample slightly above the requested size.
+    //
+    s64 target = count ? min(count, sample->population) : ceil_sample_value(fraction * sample->population);
+    u64 random_state = SAMPLE_SEED;
+
+    sample->strata = malloc(max(sample->stratum_count, 1) * sizeof(Sample_Stratum));
+    s64 stratum_index = 0;
+    s64 stratum_start = 0;
+
+    for(s64 i = 0; i < STRATUM_KEY_COUNT; ++i) {
+        s64 stratum_end = stratum_offsets[i]; // The scatter moved every offset to the end of its stratum
+        if(stratum_end == stratum_start) continue;
+
+        Sample_Stratum *stratum = &sample->strata[stratum_index++];
+        stratum->language     = (Language) (i / SAMPLE_SIZE_CLASSES);
+        stratum->population   = stratum_end - stratum_start;
+        stratum->files        = &sample->files[stratum_start];
+        stratum->sample_count = round_sample_value((f64) target * stratum->population / sample->population);
+        stratum->sample_count = min(max(stratum->sample_count, SAMPLE_MIN_PER_STRATUM), stratum->population);
+
+        // Partial Fisher-Yates shuffle, moving the sampled files to the front of the stratum.
+        for(s64 j = 0; j < stratum->sample_count; ++j) {
+            s64 k = j + (s64) (next_sample_random(&random_state) % (u64) (stratum->population - j));
+            File *tmp = stratum->files[j];
+            stratum->files[j] = stratum->files[k];
+            stratum->files[k] = tmp;
+        }
+
+        sample->sample_count += stratum->sample_count;
+        stratum_start = stratum_end;
+    }
+
+    //
+    // From here on, the workers only ever see the sampled files.
+    //
+    cloc->first_file = NULL;
+    cloc->file_count = 0;
+    for(s64 i = sample->stratum_count - 1; i >= 0; --i) {
+        Sample_Stratum *stratum = &sample->strata[i];
+        for(s64 j = stratum->sample_count - 1; j >= 0; --j) {
+            stratum->files[j]->next = cloc->first_file;
+            cloc->first_file = stratum->files[j];
+            ++cloc->file_count;
+        }
+    }
+
+    cloc->next_file = cloc->first_file;
+
+    free(stratum_keys);
+    free(sizes);
+    free(files);
+    free(stratum_offsets);
+    return sample;
+}
+
+void destroy_sample(Sample *sample) {
+    free(sample->strata);
+    free(sample->files);
+    free(sample);
+}
+
+
+
+/* ------------------------------------------------ Estimation ------------------------------------------------ */
+
+#define SAMPLE_METRIC_COUNT 4
+
+static
+void get_sample_metrics(Stats *stats, f64 metrics[SAMPLE_METRIC_COUNT]) {
+    metrics[0] = (f64) stats->file_count; // 0 for skipped binary or generated files
+    metrics[1] = (f64) stats->blank;
+    metrics[2] = (f64) stats->comment;
+    metrics[3] = (f64) stats->code;
+}
+
+static
+Stats make_sample_stats(const char *ident, f64 metrics[SAMPLE_METRIC_COUNT]) {
+    Stats stats;
+    stats.ident      = ident;
+    stats.file_count = round_sample_value(metrics[0]);
+    stats.blank      = round_sample_value(metrics[1]);
+    stats.comment    = round_sample_value(metrics[2]);
+    stats.code       = round_sample_value(metrics[3]);
+    return stats;
+}
+
+Stats print_sample_tables(Cloc *cloc) {
+    Sample *sample = cloc->sample;
+
+    //
+    // Every stratum contributes its population times its sample mean, and the variance of that estimate.
+    // Strata that were counted completely are exact and don't contribute any variance.
+    //
+    f64 totals[LANGUAGE_COUNT][SAMPLE_METRIC_COUNT]    = { 0 };
+    f64 variances[LANGUAGE_COUNT][SAMPLE_METRIC_COUNT] = { 0 };
+    Stats counted_stats = { 0 };
+
+    for(s64 i = 0; i < sample->stratum_count; ++i) {
+        Sample_Stratum *stratum = &sample->strata[i];
+        f64 n = (f64) stratum->sample_count;
+        f64 N = (f64) stratum->population;
+
+        f64 sums[SAMPLE_METRIC_COUNT] = { 0 };
+        f64 squared_sums[SAMPLE_METRIC_COUNT] = { 0 };
+        for(s64 j = 0; j < stratum->sample_count; ++j) {
+            f64 metrics[SAMPLE_METRIC_COUNT];
+            get_sample_metrics(&stratum->files[j]->stats, metrics);
+            for(s64 k = 0; k < SAMPLE_METRIC_COUNT; ++k) {
+                sums[k]         += metrics[k];
+                squared_sums[k] += metrics[k] * metrics[k];
+            }
+
+            combine_stats(&counted_stats, &stratum->files[j]->stats);
+        }
+
+        for(s64 k = 0; k < SAMPLE_METRIC_COUNT; ++k) {
+            f64 mean = sums[k] / n;
+            totals[stratum->language][k] += N * mean;
+
+            if(n > 1 && n < N) {
+                f64 sample_variance = max((squared_sums[k] - n * mean * mean) / (n - 1), 0.);
+                variances[stratum->language][k] += N * N * (1 - n / N) * sample_variance / n;
+            }
+        }
+    }
+
+    Stats language_stats[LANGUAGE_COUNT];
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) language_stats[i] = make_sample_stats(LANGUAGE_STRINGS[i], totals[i]);
+
+    Stats sum_stats = print_language_stats_table(cloc, language_stats);
+
+    //
+    // The confidence intervals, in the same order as the estimates above. The variances of the languages are
+    // independent, so they simply add up for the sum.
+    //
+    print_separator_line(cloc, aprint(&cloc->scratch, "Sampled %" PRId64 " of %" PRId64 " files, 95%% confidence (+/-)", sample->sample_count, sample->population));
+
+    s64 order[LANGUAGE_COUNT];
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) order[i] = i;
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+        for(s64 j = i + 1; j < LANGUAGE_COUNT; ++j) {
+            Stats *lhs = &language_stats[order[i]], *rhs = &language_stats[order[j]];
+            if(rhs->code > lhs->code || (rhs->code == lhs->code && rhs->file_count > lhs->file_count)) {
+                s64 tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+            }
+        }
+    }
+
+    f64 sum_intervals[SAMPLE_METRIC_COUNT] = { 0 };
+    for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+        s64 language = order[i];
+        f64 intervals[SAMPLE_METRIC_COUNT];
+        for(s64 k = 0; k < SAMPLE_METRIC_COUNT; ++k) {
+            intervals[k] = SAMPLE_CONFIDENCE_Z * sample_square_root(variances[language][k]);
+            sum_intervals[k] += variances[language][k];
+        }
+
+        if(language_stats[language].file_count > 0) {
+            Stats interval_stats = make_sample_stats(LANGUAGE_STRINGS[language], intervals);
+            print_table_entry_line(cloc, &interval_stats, true);
+        }
+    }
+
+    if(sum_stats.file_count > 1) {
+        for(s64 k = 0; k < SAMPLE_METRIC_COUNT; ++k) sum_intervals[k] = SAMPLE_CONFIDENCE_Z * sample_square_root(sum_intervals[k]);
+        Stats interval_stats = make_sample_stats("SUM:", sum_intervals);
+        print_separator_line(cloc, "");
+        print_table_entry_line(cloc, &interval_stats, true);
+    }
+
+    return counted_stats;
+}
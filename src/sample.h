@@ -0,0 +1,32 @@
+struct Cloc;
+
+#define SAMPLE_SEED 0x853c49e6748fea9b
+#define SAMPLE_SIZE_CLASSES 64
+#define SAMPLE_MIN_PER_STRATUM 2
+#define SAMPLE_CONFIDENCE_Z 1.96 // 95% confidence intervals
+
+//
+// In sampling mode, the complete tree is still traversed, but only a random sample of the files is counted.
+// Files are grouped into strata by language and by the power of two of their size, since files of similar
+// size tend to have similar line counts. Every stratum is sampled in proportion to its size, and its totals
+// are extrapolated from the mean of its sampled files.
+//
+
+typedef struct Sample_Stratum {
+    Language language;
+    s64 population;   // All files of this stratum in the tree
+    s64 sample_count; // The files that are actually counted
+    File **files;     // The first sample_count files are the sampled ones
+} Sample_Stratum;
+
+typedef struct Sample {
+    Sample_Stratum *strata;
+    s64 stratum_count;
+    File **files; // All files, grouped by stratum
+    s64 population;
+    s64 sample_count;
+} Sample;
+
+Sample *select_sample(struct Cloc *cloc, f64 fraction, s64 count);
+void destroy_sample(Sample *sample);
+Stats print_sample_tables(struct Cloc *cloc);
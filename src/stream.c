@@ -0,0 +1,235 @@
+/* ------------------------------------------------- Queues ------------------------------------------------- */
+
+static
+void emit_stream_file(Stream *stream, File *file) {
+    Cloc *cloc = stream->cloc;
+    ++stream->status_counts[file->status];
+    if(file->stats.file_count == 0) return; // Skipped binary or generated file
+
+    combine_stats(file->status == FILE_Generated ? &stream->generated_language_stats[file->language] : &stream->language_stats[file->language], &file->stats);
+    combine_stats(&stream->sum_stats, &file->stats);
+
+    if(cloc->output_mode == OUTPUT_By_File) {
+        s64 mark = mark_arena(&cloc->scratch);
+        Stats stats = file->stats;
+        stats.ident = get_file_path(&cloc->scratch, file, stream->common_directory);
+        print_table_entry_line(cloc, &stats, false);
+        reset_arena(&cloc->scratch, mark);
+    }
+}
+
+static
+void drain_stream_results(Stream *stream) {
+    //
+    // Take all finished files at once, so that the workers aren't blocked while we print.
+    //
+    os_lock_mutex(&stream->mutex);
+    File *results = stream->first_result;
+    stream->first_result = NULL;
+    os_unlock_mutex(&stream->mutex);
+
+    if(!results) return;
+
+    File *last_result = NULL;
+    s64 result_count  = 0;
+    for(File *file = results; file != NULL; file = file->next) {
+        emit_stream_file(stream, file);
+        last_result = file;
+        ++result_count;
+    }
+
+    os_lock_mutex(&stream->mutex);
+    last_result->next = stream->first_free;
+    stream->first_free = results;
+    stream->files_in_flight -= result_count;
+    os_unlock_mutex(&stream->mutex);
+}
+
+File *queue_stream_file(Stream *stream, Directory_Node *directory, char *name, Language language, u64 read_position) {
+    //
+    // Wait for a free file. While waiting, print whatever the workers have finished in the meantime, which
+    // is exactly what frees up files again.
+    //
+    File *file = NULL;
+    while(!file) {
+        drain_stream_results(stream);
+
+        os_lock_mutex(&stream->mutex);
+        if(stream->first_free) {
+            file = stream->first_free;
+            stream->first_free = file->next;
+            ++stream->files_in_flight;
+        } else if(!stream->first_result) {
+            os_wait_condition(&stream->result_available, &stream->mutex);
+        }
+        os_unlock_mutex(&stream->mutex);
+    }
+
+    s64 index  = file - stream->files;
+    s64 length = strlen(name);
+    if(length + 1 > stream->name_capacities[index]) {
+        stream->name_capacities[index] = max(length + 1, stream->name_capacities[index] * 2);
+        stream->names[index] = realloc(stream->names[index], stream->name_capacities[index]);
+    }
+
+    memcpy(stream->names[index], name, length + 1);
+    file->next          = NULL;
+    file->directory     = directory;
+    file->name          = stream->names[index];
+    file->language      = language;
+    file->status        = FILE_Source;
+    file->index         = 0; // Streamed files are recycled, and never have side tables
+    file->read_position = read_position;
+    file->bytes         = 0;
+    file->stats.ident      = file->name;
+    file->stats.blank      = 0;
+    file->stats.comment    = 0;
+    file->stats.code       = 0;
+    file->stats.file_count = 1;
+
+    os_lock_mutex(&stream->mutex);
+    if(stream->last_work) {
+        stream->last_work->next = file;
+    } else {
+        stream->first_work = file;
+    }
+    stream->last_work = file;
+    os_signal_condition(&stream->work_available);
+    os_unlock_mutex(&stream->mutex);
+
+    return file;
+}
+
+File *get_next_stream_file(Stream *stream) {
+    os_lock_mutex(&stream->mutex);
+
+    while(!stream->first_work && !stream->traversal_done) os_wait_condition(&stream->work_available, &stream->mutex);
+
+    File *file = stream->first_work;
+    if(file) {
+        stream->first_work = file->next;
+        if(!stream->first_work) stream->last_work = NULL;
+    }
+
+    os_unlock_mutex(&stream->mutex);
+    return file;
+}
+
+void finish_stream_file(Stream *stream, File *file) {
+    os_lock_mutex(&stream->mutex);
+    file->next = stream->first_result;
+    stream->first_result = file;
+    os_signal_condition(&stream->result_available);
+    os_unlock_mutex(&stream->mutex);
+}
+
+
+
+/* ------------------------------------------------- Driver ------------------------------------------------- */
+
+Stats run_stream(Cloc *cloc, String_List *paths) {
+    Stream *stream = malloc(sizeof(Stream));
+    memset(stream, 0, sizeof(Stream));
+    stream->cloc = cloc;
+    os_create_mutex(&stream->mutex);
+    os_create_condition(&stream->work_available);
+    os_create_condition(&stream->result_available);
+
+    for(s64 i = 0; i < STREAM_FILE_CAPACITY; ++i) {
+        stream->files[i].next = i + 1 < STREAM_FILE_CAPACITY ? &stream->files[i + 1] : NULL;
+    }
+    stream->first_free = &stream->files[0];
+
+    //
+    // We cannot look at all files before printing the first one, so the common prefix is derived from the
+    // paths on the command line instead.
+    //
+    s64 mark = mark_arena(&cloc->scratch);
+    for(String_List *path = paths; path != NULL; path = path->next) {
+        Directory_Node *directory;
+        if(os_resolve_path_kind(path->content) == OS_PATH_Is_File) {
+            char *name;
+            directory = intern_file_directory(cloc, path->content, &name);
+        } else {
+            directory = intern_directory_path(&cloc->perm, &cloc->root_directory, os_make_absolute_path(&cloc->scratch, path->content));
+        }
+
+        stream->common_directory = stream->common_directory ? find_common_directory(stream->common_directory, directory) : directory;
+    }
+    reset_arena(&cloc->scratch, mark);
+
+    cloc->common_prefix        = NULL;
+    cloc->common_prefix_length = 0;
+    cloc->stream               = stream;
+
+    //
+    // Start the workers before the traversal, they pick up files as soon as they are registered.
+    //
+    s64 cpu_cores = os_get_hardware_thread_count();
+    cloc->active_workers = cloc->no_jobs ? 1 : min(cpu_cores, MAX_WORKERS);
+
+    for(int i = 0; i < cloc->active_workers; ++i) {
+        create_worker(&cloc->workers[i], cloc);
+        cloc->workers[i].pid = os_spawn_thread((int(*)(void *)) worker_thread, &cloc->workers[i]);
+    }
+
+    for(String_List *path = paths; path != NULL; path = path->next) {
+        register_path_to_parse(cloc, path->content, os_resolve_path_kind(path->content));
+    }
+
+    os_lock_mutex(&stream->mutex);
+    stream->traversal_done = true;
+    os_broadcast_condition(&stream->work_available);
+    os_unlock_mutex(&stream->mutex);
+
+    //
+    // Print the remaining files as they come in.
+    //
+    while(true) {
+        drain_stream_results(stream);
+
+        os_lock_mutex(&stream->mutex);
+        b8 done = stream->files_in_flight == 0;
+        if(!done && !stream->first_result) os_wait_condition(&stream->result_available, &stream->mutex);
+        os_unlock_mutex(&stream->mutex);
+
+        if(done) break;
+    }
+
+    for(int i = 0; i < cloc->active_workers; ++i) {
+        os_join_thread(cloc->workers[i].pid);
+        destroy_worker(&cloc->workers[i]);
+    }
+
+    cloc->stream = NULL;
+
+    //
+    // Print the totals, which are the only thing we kept over all files.
+    //
+    Stats sum_stats = stream->sum_stats;
+    sum_stats.ident = "SUM:";
+
+    if(cloc->output_mode == OUTPUT_By_File) {
+        if(sum_stats.file_count > 1) {
+            print_separator_line(cloc, "");
+            print_table_entry_line(cloc, &sum_stats, false);
+        }
+    } else {
+        print_language_stats_table(cloc, stream->language_stats);
+
+        if(cloc->report_generated && stream->status_counts[FILE_Generated] > 0) {
+            print_separator_line(cloc, "Generated");
+            print_language_stats_table(cloc, stream->generated_language_stats);
+        }
+    }
+
+    print_skipped_files_line(cloc, stream->status_counts);
+
+    for(s64 i = 0; i < STREAM_FILE_CAPACITY; ++i) free(stream->names[i]);
+    os_destroy_condition(&stream->work_available);
+    os_destroy_condition(&stream->result_available);
+    os_destroy_mutex(&stream->mutex);
+    free(stream);
+
+    return sum_stats;
+}
@@ -0,0 +1,39 @@
+struct Cloc;
+
+#define STREAM_FILE_CAPACITY 1024
+
+//
+// In streaming mode, files are handed to the workers while the traversal is still running, and their results
+// are printed as soon as they are done, in no particular order. Only a fixed number of files is in flight at
+// any time and every file is released once it was printed, so memory doesn't grow with the number of files.
+// The main thread runs the traversal and is also the output stage.
+//
+typedef struct Stream {
+    struct Cloc *cloc;
+    OS_Mutex mutex;
+    OS_Condition work_available;   // Signalled for the workers
+    OS_Condition result_available; // Signalled for the main thread
+
+    File files[STREAM_FILE_CAPACITY];
+    char *names[STREAM_FILE_CAPACITY];
+    s64 name_capacities[STREAM_FILE_CAPACITY];
+
+    File *first_free;
+    File *first_work;
+    File *last_work;
+    File *first_result;
+    s64 files_in_flight; // Taken off the free list, but not printed yet
+    b8 traversal_done;
+
+    // --- Output
+    Directory_Node *common_directory; // Paths are printed relative to this
+    Stats language_stats[LANGUAGE_COUNT];
+    Stats generated_language_stats[LANGUAGE_COUNT];
+    Stats sum_stats;
+    s64 status_counts[FILE_STATUS_COUNT];
+} Stream;
+
+Stats run_stream(struct Cloc *cloc, String_List *paths);
+File *queue_stream_file(Stream *stream, Directory_Node *directory, char *name, Language language, u64 read_position);
+File *get_next_stream_file(Stream *stream);
+void finish_stream_file(Stream *stream, File *file);
@@ -0,0 +1,99 @@
+/* ------------------------------------------------ Recording ------------------------------------------------ */
+
+Trace *create_trace(char *path) {
+    Trace *trace = malloc(sizeof(Trace));
+    memset(trace, 0, sizeof(Trace));
+    trace->path  = path;
+    trace->start = os_get_hardware_time();
+    return trace;
+}
+
+void record_trace_span(Trace_Buffer *buffer, Trace_Span_Kind kind, Hardware_Time start, void *subject, s64 bytes) {
+    if(!buffer->events) buffer->events = malloc(TRACE_BUFFER_CAPACITY * sizeof(Trace_Event));
+
+    Trace_Event *event = &buffer->events[buffer->count & (TRACE_BUFFER_CAPACITY - 1)];
+    event->start   = start;
+    event->end     = os_get_hardware_time();
+    event->kind    = kind;
+    event->subject = subject;
+    event->bytes   = bytes;
+    ++buffer->count;
+}
+
+void destroy_trace(Trace *trace) {
+    for(s64 i = 0; i < MAX_WORKERS + 1; ++i) free(trace->buffers[i].events);
+    free(trace);
+}
+
+
+
+/* ------------------------------------------------- Writing ------------------------------------------------- */
+
+static
+void write_json_string(FILE *output, const char *string) {
+    fputc('"', output);
+    for(const char *c = string; *c; ++c) {
+        if(*c == '"' || *c == '\\') {
+            fputc('\\', output);
+            fputc(*c, output);
+        } else if((u8) *c < 0x20) {
+            fprintf(output, "\\u%04x", (u8) *c);
+        } else {
+            fputc(*c, output);
+        }
+    }
+    fputc('"', output);
+}
+
+b8 write_trace(Cloc *cloc, Trace *trace) {
+    FILE *output = fopen(trace->path, "wb");
+    if(!output) {
+        printf("[ERROR]: Failed to create the trace file '%s'.\n", trace->path);
+        return false;
+    }
+
+    const char *SPAN_NAMES[TRACE_SPAN_COUNT] = { "Directory scan", "Queue wait", "File open", "Read chunk", "Parse" };
+
+    s64 dropped = 0;
+    fprintf(output, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(output, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Main\"}}");
+
+    for(s64 i = 0; i < MAX_WORKERS + 1; ++i) {
+        Trace_Buffer *buffer = &trace->buffers[i];
+        if(!buffer->count) continue;
+
+        if(i > 0) fprintf(output, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%" PRId64 ",\"args\":{\"name\":\"Worker %" PRId64 "\"}}", i, i);
+
+        s64 first = max(buffer->count - TRACE_BUFFER_CAPACITY, 0);
+        dropped += first;
+
+        for(s64 j = first; j < buffer->count; ++j) {
+            Trace_Event *event = &buffer->events[j & (TRACE_BUFFER_CAPACITY - 1)];
+            f64 timestamp = os_convert_hardware_time_to_seconds(event->start - trace->start) * 1e6;
+            f64 duration  = os_convert_hardware_time_to_seconds(event->end - event->start) * 1e6;
+
+            fprintf(output, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%" PRId64 ",\"ts\":%.3f,\"dur\":%.3f", SPAN_NAMES[event->kind], i, timestamp, duration);
+
+            if(event->subject) {
+                s64 mark = mark_arena(&cloc->scratch);
+                char *path = event->kind == TRACE_SPAN_Directory_Scan ? get_directory_path(&cloc->scratch, event->subject) : get_file_path(&cloc->scratch, event->subject, NULL);
+                fprintf(output, ",\"args\":{\"path\":");
+                write_json_string(output, path);
+                if(event->kind == TRACE_SPAN_Read_Chunk || event->kind == TRACE_SPAN_Parse) fprintf(output, ",\"bytes\":%" PRId64, event->bytes);
+                fprintf(output, "}");
+                reset_arena(&cloc->scratch, mark);
+            }
+
+            fprintf(output, "}");
+        }
+    }
+
+    fprintf(output, "\n],\"otherData\":{\"droppedEvents\":%" PRId64 "}}\n", dropped);
+
+    b8 success = !ferror(output);
+    if(fclose(output) != 0) success = false;
+
+    if(!success) printf("[ERROR]: Failed to write the trace file '%s'.\n", trace->path);
+    if(success && dropped) printf("[WARNING]: The trace only contains the last %d events of every thread, %" PRId64 " earlier ones were dropped.\n", TRACE_BUFFER_CAPACITY, dropped);
+    return success;
+}
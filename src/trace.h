@@ -0,0 +1,45 @@
+struct Cloc;
+
+#define TRACE_BUFFER_CAPACITY 256 * 1024 // Events per thread, must be a power of two
+
+//
+// With '--trace', every thread records what it spends its time on into a ring buffer of its own, which is
+// written as a Chrome trace (the JSON trace event format) once everything is done. Nobody else touches a
+// buffer while its thread is running, so recording a span is just two timestamps and a store. When a buffer
+// is full, the oldest events are overwritten, which keeps the memory bounded on huge runs, and keeps the end
+// of the run where the stragglers are.
+//
+
+typedef enum Trace_Span_Kind {
+    TRACE_SPAN_Directory_Scan,
+    TRACE_SPAN_Queue_Wait,
+    TRACE_SPAN_File_Open,
+    TRACE_SPAN_Read_Chunk,
+    TRACE_SPAN_Parse,
+    TRACE_SPAN_COUNT,
+} Trace_Span_Kind;
+
+typedef struct Trace_Event {
+    Hardware_Time start;
+    Hardware_Time end;
+    Trace_Span_Kind kind;
+    void *subject; // The Directory_Node of directory scans, the File otherwise (NULL for empty queues)
+    s64 bytes;     // Of read chunks and parsed content
+} Trace_Event;
+
+typedef struct Trace_Buffer {
+    Trace_Event *events; // Allocated on the first event
+    s64 count;           // All events ever recorded, only the last TRACE_BUFFER_CAPACITY are kept
+    u8 padding[CACHE_LINE_SIZE];
+} Trace_Buffer;
+
+typedef struct Trace {
+    char *path;
+    Hardware_Time start;
+    Trace_Buffer buffers[MAX_WORKERS + 1]; // The main thread's, then one per worker
+} Trace;
+
+Trace *create_trace(char *path);
+void record_trace_span(Trace_Buffer *buffer, Trace_Span_Kind kind, Hardware_Time start, void *subject, s64 bytes);
+b8 write_trace(struct Cloc *cloc, Trace *trace);
+void destroy_trace(Trace *trace);
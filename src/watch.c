@@ -0,0 +1,559 @@
+/*
+ * The watch daemon does one full count of the tree, and then keeps the results up to date by subscribing
+ * to change notifications for every counted directory. Only the files that actually changed get recounted,
+ * and the new stats are propagated up the directory chain, so that an update costs O(changed files * depth).
+ *
+ * All totals are kept in memory and served over a local unix socket. Every query is a single line, and
+ * every answer is a single line unless noted otherwise:
+ *   sum            -> "<files> <blank> <comment> <code>"
+ *   lang           -> "<language> <files> <blank> <comment> <code>" per language, terminated by "end"
+ *   dir <path>     -> "<files> <blank> <comment> <code>", accumulated over all subdirectories
+ *   file <path>    -> "<blank> <comment> <code>"
+ *   shutdown       -> "ok", then the daemon stops
+ * Invalid queries and unknown paths are answered with "error <reason>". Paths must be absolute.
+ */
+
+#if POSIX
+
+#define WATCH_ARENA_SIZE 64 * 1024 * 1024
+#define WATCH_EVENT_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR)
+
+/* ---------------------------------------------- Stats Tracking ---------------------------------------------- */
+
+static
+void apply_stats_delta(Stats *dst, Stats *previous, Stats *current) {
+    dst->blank      += current->blank      - previous->blank;
+    dst->comment    += current->comment    - previous->comment;
+    dst->code       += current->code       - previous->code;
+    dst->file_count += current->file_count - previous->file_count;
+}
+
+static
+void propagate_stats_delta(Watch_Daemon *daemon, Watched_File *watched, Stats *previous, Stats *current) {
+    for(Watched_Directory *directory = watched->directory; directory != NULL; directory = directory->parent) {
+        apply_stats_delta(&directory->stats, previous, current);
+    }
+
+    apply_stats_delta(&daemon->language_stats[watched->file->language], previous, current);
+    apply_stats_delta(&daemon->sum_stats, previous, current);
+}
+
+static
+void mark_file_dirty(Watch_Daemon *daemon, Watched_File *watched) {
+    if(watched->dirty) return;
+    watched->dirty           = true;
+    watched->next_dirty      = daemon->first_dirty_file;
+    daemon->first_dirty_file = watched;
+}
+
+static
+void recount_dirty_files(Watch_Daemon *daemon) {
+    //
+    // All kinds of changes (creation, modification, deletion, renames) just mark the file as dirty, and we
+    // figure out here what actually happened to it. This way, multiple events for the same file in one batch
+    // only cause a single recount.
+    //
+    while(daemon->first_dirty_file) {
+        Watched_File *watched    = daemon->first_dirty_file;
+        daemon->first_dirty_file = watched->next_dirty;
+        watched->next_dirty      = NULL;
+        watched->dirty           = false;
+
+        File *file     = watched->file;
+        Stats previous = file->stats;
+
+        if(os_resolve_path_kind(watched->path) == OS_PATH_Is_File) {
+            count_file(&daemon->worker, file);
+            watched->present = true;
+        } else {
+            file->stats.blank      = 0;
+            file->stats.comment    = 0;
+            file->stats.code       = 0;
+            file->stats.file_count = 0;
+            watched->present = false;
+        }
+
+        propagate_stats_delta(daemon, watched, &previous, &file->stats);
+    }
+}
+
+
+
+/* ------------------------------------------------- Lookup ------------------------------------------------- */
+
+static
+char *get_parent_path(Arena *arena, char *path) {
+    s64 length = strlen(path);
+    while(length > 0 && path[length - 1] != '/') --length;
+
+    if(length == 0) return NULL; // Not an absolute path
+    if(length == 1) return path[1] != 0 ? push_string(arena, "/") : NULL; // The parent of '/' doesn't exist
+
+    char *parent = push_arena(arena, length);
+    memcpy(parent, path, length - 1);
+    parent[length - 1] = 0;
+    return parent;
+}
+
+static
+Watched_Directory *get_or_create_watched_directory(Watch_Daemon *daemon, char *directory_path) {
+    Watched_Directory *directory = string_table_query(&daemon->directories_by_path, directory_path);
+    if(directory) return directory;
+
+    directory = push_arena(&daemon->arena, sizeof(Watched_Directory));
+    memset(directory, 0, sizeof(Watched_Directory));
+    directory->path             = push_string(&daemon->arena, directory_path);
+    directory->watch_descriptor = -1;
+    directory->node             = intern_directory_path(&daemon->arena, &daemon->cloc->root_directory, directory->path);
+    directory->stats.ident      = directory->path;
+
+    //
+    // Directories are always registered top-down during the traversal, so if the parent is part of the
+    // watched tree, it already exists at this point.
+    //
+    s64 mark = mark_arena(&daemon->cloc->scratch);
+    char *parent_path = get_parent_path(&daemon->cloc->scratch, directory->path);
+    if(parent_path) directory->parent = string_table_query(&daemon->directories_by_path, parent_path);
+    reset_arena(&daemon->cloc->scratch, mark);
+
+    if(directory->parent) {
+        directory->next_sibling = directory->parent->first_child;
+        directory->parent->first_child = directory;
+    }
+
+    string_table_insert(&daemon->directories_by_path, directory->path, directory);
+    return directory;
+}
+
+static
+b8 start_watching_directory(Watch_Daemon *daemon, Watched_Directory *directory) {
+    if(directory->watch_descriptor >= 0) return false;
+
+    s32 descriptor = inotify_add_watch(daemon->notify_handle, directory->path, WATCH_EVENT_MASK);
+    if(descriptor < 0) return false;
+
+    if(descriptor >= daemon->descriptor_capacity) {
+        s64 new_capacity = max(daemon->descriptor_capacity * 2, descriptor + 1);
+        daemon->directories_by_descriptor = realloc(daemon->directories_by_descriptor, new_capacity * sizeof(Watched_Directory *));
+        memset(&daemon->directories_by_descriptor[daemon->descriptor_capacity], 0, (new_capacity - daemon->descriptor_capacity) * sizeof(Watched_Directory *));
+        daemon->descriptor_capacity = new_capacity;
+    }
+
+    directory->watch_descriptor = descriptor;
+    daemon->directories_by_descriptor[descriptor] = directory;
+    return true;
+}
+
+static
+void stop_watching_directory(Watch_Daemon *daemon, Watched_Directory *directory) {
+    //
+    // The directory was removed or moved out of the watched tree. Every file inside is marked as dirty,
+    // and the recount will notice that these files don't exist anymore.
+    //
+    if(directory->watch_descriptor >= 0) {
+        inotify_rm_watch(daemon->notify_handle, directory->watch_descriptor); // Fails if the kernel already dropped the watch, which is fine
+        daemon->directories_by_descriptor[directory->watch_descriptor] = NULL;
+        directory->watch_descriptor = -1;
+    }
+
+    for(Watched_File *watched = directory->first_file; watched != NULL; watched = watched->next) {
+        if(watched->present) mark_file_dirty(daemon, watched);
+    }
+
+    for(Watched_Directory *child = directory->first_child; child != NULL; child = child->next_sibling) {
+        stop_watching_directory(daemon, child);
+    }
+}
+
+static
+Watched_File *create_watched_file(Watch_Daemon *daemon, Watched_Directory *directory, File *file, char *path) {
+    Watched_File *watched = push_arena(&daemon->arena, sizeof(Watched_File));
+    memset(watched, 0, sizeof(Watched_File));
+    watched->directory     = directory;
+    watched->file          = file;
+    watched->path          = path;
+    watched->next          = directory->first_file;
+    directory->first_file  = watched;
+    string_table_insert(&daemon->files_by_path, watched->path, watched);
+    return watched;
+}
+
+static
+Watched_File *get_or_create_watched_file(Watch_Daemon *daemon, Watched_Directory *directory, char *file_path) {
+    Watched_File *watched = string_table_query(&daemon->files_by_path, file_path);
+    if(watched) return watched;
+
+    Language language = get_language_for_file_path(file_path);
+    if(language == LANGUAGE_COUNT) return NULL;
+
+    char *path = push_string(&daemon->arena, file_path);
+    s64 name_offset = strlen(path);
+    while(name_offset > 0 && path[name_offset - 1] != '/' && path[name_offset - 1] != '\\') --name_offset;
+
+    File *file = push_arena(&daemon->arena, sizeof(File));
+    memset(file, 0, sizeof(File));
+    file->directory   = directory->node;
+    file->name        = &path[name_offset]; // Share the storage with the lookup key
+    file->language    = language;
+    file->stats.ident = file->name;
+    return create_watched_file(daemon, directory, file, path);
+}
+
+static
+void scan_watched_directory(Watch_Daemon *daemon, Watched_Directory *directory) {
+    //
+    // List the current content of this directory and mark all files in it as dirty. Files that we knew of,
+    // but which were not found anymore, are marked as well so that they get removed.
+    // Subdirectories that we haven't been watching yet are scanned recursively.
+    //
+    Cloc *cloc = daemon->cloc;
+    s64 scan_generation = ++daemon->scan_generation;
+    s64 mark = mark_arena(&cloc->scratch);
+
+    File_Iterator iterator = find_first_file(&cloc->scratch, directory->path, false);
+
+    while(iterator.valid) {
+        if(strcmp(iterator.path, ".") == 0 || strcmp(iterator.path, "..") == 0) {
+            // Ignore these paths
+        } else if(iterator.kind == OS_PATH_Is_Directory && !string_list_contains(cloc->excluded_directories, iterator.path)) {
+            Watched_Directory *child = get_or_create_watched_directory(daemon, combine_file_paths(cloc, directory->path, iterator.path));
+            if(start_watching_directory(daemon, child)) scan_watched_directory(daemon, child);
+        } else if(iterator.kind == OS_PATH_Is_File) {
+            Watched_File *watched = get_or_create_watched_file(daemon, directory, combine_file_paths(cloc, directory->path, iterator.path));
+            if(watched) {
+                watched->scan_generation = scan_generation;
+                mark_file_dirty(daemon, watched);
+            }
+        }
+
+        find_next_file(&cloc->scratch, &iterator);
+    }
+
+    close_file_iterator(&iterator);
+    reset_arena(&cloc->scratch, mark);
+
+    for(Watched_File *watched = directory->first_file; watched != NULL; watched = watched->next) {
+        if(watched->present && watched->scan_generation != scan_generation) mark_file_dirty(daemon, watched);
+    }
+}
+
+
+
+/* ------------------------------------------------- Events ------------------------------------------------- */
+
+static
+void handle_watch_event(Watch_Daemon *daemon, struct inotify_event *event) {
+    Cloc *cloc = daemon->cloc;
+
+    if(event->mask & IN_Q_OVERFLOW) {
+        //
+        // We have lost events, so we don't know what changed. Rescan all directories we are currently
+        // watching, which is still cheaper than starting from scratch since unchanged directories
+        // don't need to be set up again.
+        //
+        for(s64 i = 0; i < daemon->descriptor_capacity; ++i) {
+            if(daemon->directories_by_descriptor[i]) scan_watched_directory(daemon, daemon->directories_by_descriptor[i]);
+        }
+        return;
+    }
+
+    if(event->wd < 0 || event->wd >= daemon->descriptor_capacity) return;
+
+    Watched_Directory *directory = daemon->directories_by_descriptor[event->wd];
+    if(!directory) return;
+
+    if(event->mask & (IN_IGNORED | IN_DELETE_SELF)) {
+        stop_watching_directory(daemon, directory);
+        return;
+    }
+
+    if(event->len == 0) return;
+
+    s64 mark = mark_arena(&cloc->scratch);
+    char *path = combine_file_paths(cloc, directory->path, event->name);
+
+    if(event->mask & IN_ISDIR) {
+        if(event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            if(!string_list_contains(cloc->excluded_directories, event->name)) {
+                Watched_Directory *child = get_or_create_watched_directory(daemon, path);
+                if(start_watching_directory(daemon, child)) scan_watched_directory(daemon, child);
+            }
+        } else if(event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            Watched_Directory *child = string_table_query(&daemon->directories_by_path, path);
+            if(child) stop_watching_directory(daemon, child);
+        }
+    } else {
+        Watched_File *watched = get_or_create_watched_file(daemon, directory, path);
+        if(watched) mark_file_dirty(daemon, watched);
+    }
+
+    reset_arena(&cloc->scratch, mark);
+}
+
+static
+void handle_watch_events(Watch_Daemon *daemon) {
+    char buffer[WATCH_EVENT_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    s64 bytes;
+    while((bytes = read(daemon->notify_handle, buffer, sizeof(buffer))) > 0) {
+        for(char *pointer = buffer; pointer < buffer + bytes;) {
+            struct inotify_event *event = (struct inotify_event *) pointer;
+            handle_watch_event(daemon, event);
+            pointer += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    recount_dirty_files(daemon);
+}
+
+
+
+/* ------------------------------------------------- Queries ------------------------------------------------- */
+
+static
+void append_watch_stats(String_Builder *builder, Stats *stats, b8 include_file_count) {
+    if(include_file_count) sprint(builder, "%" PRId64 " ", stats->file_count);
+    sprint(builder, "%" PRId64 " %" PRId64 " %" PRId64 "\n", stats->blank, stats->comment, stats->code);
+}
+
+static
+char *strip_trailing_slashes(char *path) {
+    s64 length = strlen(path);
+    while(length > 1 && path[length - 1] == '/') path[--length] = 0;
+    return path;
+}
+
+static
+void answer_watch_query(Watch_Daemon *daemon, Watch_Client *client, char *query) {
+    Cloc *cloc = daemon->cloc;
+    s64 mark = mark_arena(&cloc->scratch);
+
+    String_Builder builder;
+    create_string_builder(&builder, &cloc->scratch);
+
+    if(strcmp(query, "sum") == 0) {
+        append_watch_stats(&builder, &daemon->sum_stats, true);
+    } else if(strcmp(query, "lang") == 0) {
+        for(s64 i = 0; i < LANGUAGE_COUNT; ++i) {
+            if(daemon->language_stats[i].file_count == 0) continue;
+            sprint(&builder, "%s ", LANGUAGE_STRINGS[i]);
+            append_watch_stats(&builder, &daemon->language_stats[i], true);
+        }
+        append_string(&builder, "end\n");
+    } else if(strncmp(query, "dir ", 4) == 0) {
+        Watched_Directory *directory = string_table_query(&daemon->directories_by_path, strip_trailing_slashes(&query[4]));
+        if(directory && directory->watch_descriptor >= 0) {
+            append_watch_stats(&builder, &directory->stats, true);
+        } else {
+            append_string(&builder, "error unknown directory\n");
+        }
+    } else if(strncmp(query, "file ", 5) == 0) {
+        Watched_File *watched = string_table_query(&daemon->files_by_path, &query[5]);
+        if(watched && watched->present) {
+            append_watch_stats(&builder, &watched->file->stats, false);
+        } else {
+            append_string(&builder, "error unknown file\n");
+        }
+    } else if(strcmp(query, "shutdown") == 0) {
+        append_string(&builder, "ok\n");
+        daemon->running = false;
+    } else {
+        append_string(&builder, "error unknown query\n");
+    }
+
+    send(client->handle, builder.pointer, builder.size_in_characters, MSG_NOSIGNAL);
+    reset_arena(&cloc->scratch, mark);
+}
+
+static
+void accept_watch_client(Watch_Daemon *daemon) {
+    s32 handle = accept(daemon->server_handle, NULL, NULL);
+    if(handle < 0) return;
+
+    if(daemon->client_count == MAX_WATCH_CLIENTS) {
+        close(handle);
+        return;
+    }
+
+    Watch_Client *client = &daemon->clients[daemon->client_count];
+    client->handle       = handle;
+    client->buffer_size  = 0;
+    ++daemon->client_count;
+}
+
+static
+void close_watch_client(Watch_Daemon *daemon, s64 index) {
+    close(daemon->clients[index].handle);
+    daemon->clients[index] = daemon->clients[daemon->client_count - 1];
+    --daemon->client_count;
+}
+
+static
+void handle_watch_client(Watch_Daemon *daemon, s64 index) {
+    Watch_Client *client = &daemon->clients[index];
+
+    s64 received = recv(client->handle, &client->buffer[client->buffer_size], WATCH_CLIENT_BUFFER_SIZE - client->buffer_size, 0);
+    if(received <= 0) {
+        close_watch_client(daemon, index);
+        return;
+    }
+
+    client->buffer_size += received;
+
+    //
+    // Answer every complete line in the buffer, and keep the incomplete rest for the next read.
+    //
+    s64 line_start = 0;
+    for(s64 i = 0; i < client->buffer_size; ++i) {
+        if(client->buffer[i] != '\n') continue;
+
+        client->buffer[i] = 0;
+        if(i > line_start && client->buffer[i - 1] == '\r') client->buffer[i - 1] = 0;
+        answer_watch_query(daemon, client, &client->buffer[line_start]);
+        line_start = i + 1;
+    }
+
+    if(line_start == 0 && client->buffer_size == WATCH_CLIENT_BUFFER_SIZE) {
+        close_watch_client(daemon, index); // This query is way too long to be valid
+        return;
+    }
+
+    memmove(client->buffer, &client->buffer[line_start], client->buffer_size - line_start);
+    client->buffer_size -= line_start;
+}
+
+
+
+/* ------------------------------------------------- Daemon ------------------------------------------------- */
+
+Watch_Daemon *create_watch_daemon(Cloc *cloc, char *socket_path) {
+    struct sockaddr_un address = { 0 };
+    address.sun_family = AF_UNIX;
+
+    if(strlen(socket_path) >= sizeof(address.sun_path)) {
+        printf("[ERROR]: The socket path '%s' is too long.\n", socket_path);
+        return NULL;
+    }
+
+    strcpy(address.sun_path, socket_path);
+
+    Watch_Daemon *daemon  = calloc(1, sizeof(Watch_Daemon));
+    daemon->cloc          = cloc;
+    daemon->socket_path   = socket_path;
+    daemon->notify_handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    daemon->server_handle = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    daemon->running       = true;
+    create_arena(&daemon->arena, WATCH_ARENA_SIZE);
+    create_worker(&daemon->worker, cloc);
+    create_string_table(&daemon->directories_by_path, 1024);
+    create_string_table(&daemon->files_by_path, 1024);
+
+    if(daemon->notify_handle < 0) {
+        printf("[ERROR]: Failed to set up the file system notifications: %s.\n", strerror(errno));
+        destroy_watch_daemon(daemon);
+        return NULL;
+    }
+
+    unlink(socket_path); // Remove stale sockets of previous runs
+
+    if(daemon->server_handle < 0 || bind(daemon->server_handle, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(daemon->server_handle, MAX_WATCH_CLIENTS) != 0) {
+        printf("[ERROR]: Failed to listen on the socket '%s': %s.\n", socket_path, strerror(errno));
+        destroy_watch_daemon(daemon);
+        return NULL;
+    }
+
+    return daemon;
+}
+
+void register_watched_directory(Watch_Daemon *daemon, char *directory_path) {
+    start_watching_directory(daemon, get_or_create_watched_directory(daemon, directory_path));
+}
+
+void run_watch_daemon(Watch_Daemon *daemon) {
+    Cloc *cloc = daemon->cloc;
+
+    //
+    // Take over the results of the initial count. Files that were specified directly on the command line
+    // weren't part of a directory traversal, so their directory might not be watched yet.
+    //
+    s64 mark = mark_arena(&cloc->scratch);
+
+    for(File *file = cloc->first_file; file != NULL; file = file->next) {
+        char *path = get_file_path(&cloc->scratch, file, NULL);
+        if(string_table_query(&daemon->files_by_path, path)) continue;
+
+        Watched_Directory *directory = get_or_create_watched_directory(daemon, get_directory_path(&cloc->scratch, file->directory));
+        start_watching_directory(daemon, directory);
+
+        Watched_File *watched = create_watched_file(daemon, directory, file, push_string(&daemon->arena, path));
+        watched->present = true;
+
+        Stats empty = { 0 };
+        propagate_stats_delta(daemon, watched, &empty, &file->stats);
+    }
+
+    reset_arena(&cloc->scratch, mark);
+
+    printf("Watching %" PRId64 " directories, serving queries on '%s'.\n", daemon->directories_by_path.count, daemon->socket_path);
+    fflush(stdout);
+
+    while(daemon->running) {
+        struct pollfd handles[2 + MAX_WATCH_CLIENTS];
+        handles[0].fd     = daemon->notify_handle;
+        handles[0].events = POLLIN;
+        handles[1].fd     = daemon->server_handle;
+        handles[1].events = POLLIN;
+
+        s64 client_count = daemon->client_count;
+        for(s64 i = 0; i < client_count; ++i) {
+            handles[2 + i].fd     = daemon->clients[i].handle;
+            handles[2 + i].events = POLLIN;
+        }
+
+        if(poll(handles, 2 + client_count, -1) < 0) {
+            if(errno == EINTR) continue;
+            printf("[ERROR]: Failed to wait for events: %s.\n", strerror(errno));
+            break;
+        }
+
+        if(handles[0].revents & POLLIN) handle_watch_events(daemon);
+
+        // Iterate backwards, since closing a client moves the last client into its slot.
+        for(s64 i = client_count - 1; i >= 0 && daemon->running; --i) {
+            if(handles[2 + i].revents & (POLLIN | POLLHUP | POLLERR)) handle_watch_client(daemon, i);
+        }
+
+        if(handles[1].revents & POLLIN) accept_watch_client(daemon);
+    }
+}
+
+void destroy_watch_daemon(Watch_Daemon *daemon) {
+    for(s64 i = 0; i < daemon->client_count; ++i) close(daemon->clients[i].handle);
+
+    if(daemon->server_handle >= 0) {
+        close(daemon->server_handle);
+        unlink(daemon->socket_path);
+    }
+
+    if(daemon->notify_handle >= 0) close(daemon->notify_handle);
+
+    free(daemon->directories_by_descriptor);
+    destroy_string_table(&daemon->directories_by_path);
+    destroy_string_table(&daemon->files_by_path);
+    destroy_worker(&daemon->worker);
+    destroy_arena(&daemon->arena);
+    free(daemon);
+}
+
+#else
+
+Watch_Daemon *create_watch_daemon(struct Cloc *cloc, char *socket_path) {
+    printf("[ERROR]: The watch mode is not supported on this platform.\n");
+    return NULL;
+}
+
+void register_watched_directory(Watch_Daemon *daemon, char *directory_path) {}
+void run_watch_daemon(Watch_Daemon *daemon) {}
+void destroy_watch_daemon(Watch_Daemon *daemon) {}
+
+#endif
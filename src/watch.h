@@ -0,0 +1,63 @@
+struct Cloc;
+
+#define MAX_WATCH_CLIENTS 64
+#define WATCH_CLIENT_BUFFER_SIZE 4096
+#define WATCH_EVENT_BUFFER_SIZE 64 * 1024
+
+typedef struct Watched_File {
+    struct Watched_File *next;       // The next file in the same directory
+    struct Watched_File *next_dirty; // The next file that needs to be recounted in this batch of events
+    struct Watched_Directory *directory;
+    File *file;
+    char *path;                      // The key in the lookup table, the file itself only stores its name
+    s64 scan_generation;             // Used to find files that have disappeared while we weren't looking
+    b8 present;
+    b8 dirty;
+} Watched_File;
+
+typedef struct Watched_Directory {
+    struct Watched_Directory *parent;
+    struct Watched_Directory *first_child;
+    struct Watched_Directory *next_sibling;
+    Watched_File *first_file;
+    Directory_Node *node;
+    char *path;
+    s32 watch_descriptor; // -1 if this directory is currently not being watched
+    Stats stats;          // Accumulated over all files in this directory and its subdirectories
+} Watched_Directory;
+
+typedef struct Watch_Client {
+    s32 handle;
+    s64 buffer_size;
+    char buffer[WATCH_CLIENT_BUFFER_SIZE];
+} Watch_Client;
+
+typedef struct Watch_Daemon {
+    struct Cloc *cloc;
+    Arena arena;
+    Worker worker; // Recounts the changed files on the daemon thread
+
+    char *socket_path;
+    s32 notify_handle;
+    s32 server_handle;
+    Watch_Client clients[MAX_WATCH_CLIENTS];
+    s64 client_count;
+    b8 running;
+
+    // --- Lookup
+    String_Table directories_by_path;
+    String_Table files_by_path;
+    Watched_Directory **directories_by_descriptor;
+    s64 descriptor_capacity;
+
+    // --- Live totals
+    Stats language_stats[LANGUAGE_COUNT];
+    Stats sum_stats;
+    Watched_File *first_dirty_file;
+    s64 scan_generation;
+} Watch_Daemon;
+
+Watch_Daemon *create_watch_daemon(struct Cloc *cloc, char *socket_path);
+void register_watched_directory(Watch_Daemon *daemon, char *directory_path);
+void run_watch_daemon(Watch_Daemon *daemon);
+void destroy_watch_daemon(Watch_Daemon *daemon);
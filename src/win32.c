@@ -16,11 +16,31 @@ char *os_make_absolute_path(Arena *arena, char *relative_path) {
     // Therefore, we must always allocate space for the null-terminator, and then exclude that from the actual
     // string content.
 	u32 buffer_size = GetFullPathNameA(relative_path, 0, NULL, NULL);
+    if(buffer_size == 0) return NULL;
+
     char *absolute_path = push_arena(arena, buffer_size + 1);
     GetFullPathNameA(relative_path, buffer_size, absolute_path, NULL);
     return absolute_path;
 }
 
+b8 os_get_file_identity(char *path, u64 *device, u64 *inode) {
+    HANDLE handle = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL); // Directories can only be opened with backup semantics
+    if(handle == INVALID_HANDLE_VALUE) return false;
+
+    BY_HANDLE_FILE_INFORMATION information;
+    b8 success = GetFileInformationByHandle(handle, &information);
+    CloseHandle(handle);
+    if(!success) return false;
+
+    *device = information.dwVolumeSerialNumber;
+    *inode  = ((u64) information.nFileIndexHigh << 32) | information.nFileIndexLow;
+    return true;
+}
+
+b8 os_create_directory(char *path) {
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
 File_Handle os_open_file(char *path) {
     return CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 }
@@ -31,6 +51,12 @@ s64 os_get_file_size(File_Handle handle) {
     return (s64) low | ((s64) high << 32);
 }
 
+s64 os_get_file_size_by_path(char *path) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if(!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) return 0;
+    return (s64) attributes.nFileSizeLow | ((s64) attributes.nFileSizeHigh << 32);
+}
+
 s64 os_read_file(File_Handle handle, char *dst, s64 offset, s64 size) {
     s32 distance_to_move_high = (s32) (offset >> 32);
     SetFilePointer(handle, (s32) (offset & 0xffffffff), &distance_to_move_high, FILE_BEGIN);
@@ -43,9 +69,44 @@ void os_close_file(File_Handle handle) {
     CloseHandle(handle);
 }
 
+void *os_reserve_memory(s64 size) {
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+b8 os_commit_memory(void *pointer, s64 size) {
+    return VirtualAlloc(pointer, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void os_release_memory(void *pointer, s64 size) {
+    (void) size; // Windows releases the complete reservation
+    VirtualFree(pointer, 0, MEM_RELEASE);
+}
+
+void *os_map_file(char *path, s64 *size) {
+    HANDLE file = os_open_file(path);
+    if(file == INVALID_HANDLE_VALUE) return NULL;
+
+    *size = os_get_file_size(file);
+
+    // The view keeps the mapping alive, so we can close both handles right away.
+    HANDLE mapping = *size ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    void *pointer  = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if(mapping) CloseHandle(mapping);
+    CloseHandle(file);
+    return pointer;
+}
+
+void os_unmap_file(void *pointer, s64 size) {
+    UnmapViewOfFile(pointer);
+}
 
 
-File_Iterator find_first_file(Arena *arena, char *directory_path) {
+
+File_Iterator find_first_file(Arena *arena, char *directory_path, b8 follow_symlinks) {
+    //
+    // FindFirstFile already reports directory symlinks and junctions as directories, and they are listed
+    // through their target. The identity of every entry would require opening it, so none is reported here.
+    //
     WIN32_FIND_DATAA file_data;
 
     sprintf(win32_string_buffer, "%s\\*", directory_path);
@@ -53,10 +114,14 @@ File_Iterator find_first_file(Arena *arena, char *directory_path) {
     File_Iterator iterator;
     iterator.native_handle = FindFirstFileA(win32_string_buffer, &file_data);
     iterator.valid = iterator.native_handle != INVALID_HANDLE_VALUE;
+    iterator.follow_symlinks = follow_symlinks;
+    iterator.device = 0;
+    iterator.directory_device = 0;
 
     if(iterator.valid) {
         iterator.path = push_string(arena, file_data.cFileName);
         iterator.kind = file_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ? OS_PATH_Is_Directory : OS_PATH_Is_File;
+        iterator.inode = 0;
     } else {
         iterator.native_handle = INVALID_HANDLE_VALUE;
         iterator.path = NULL;
@@ -73,6 +138,7 @@ void find_next_file(Arena *arena, File_Iterator *iterator) {
     if(iterator->valid) {
         iterator->path = push_string(arena, file_data.cFileName);
         iterator->kind = file_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ? OS_PATH_Is_Directory : OS_PATH_Is_File;
+        iterator->inode = 0;
     } else {
         iterator->native_handle = INVALID_HANDLE_VALUE;
         iterator->path = NULL;
@@ -96,6 +162,18 @@ s64 os_get_hardware_thread_count() {
     return system_info.dwNumberOfProcessors;    
 }
 
+u64 os_get_physical_file_offset(char *path) {
+    return 0; // Not supported here, the files just keep their traversal order
+}
+
+void os_hint_file_read(File_Handle handle) {
+    // The Windows cache manager does its own read-ahead once the file is opened.
+}
+
+s64 os_count_set_bits(u32 value) {
+    return __popcnt(value);
+}
+
 Pid os_spawn_thread(int (*procedure)(void *), void *argument) {
     return CreateThread(NULL, 0, procedure, argument, 0, NULL);
 }
@@ -108,6 +186,46 @@ void *os_compare_and_swap(void *volatile *dst, void *exchange, void *comparand)
     return InterlockedCompareExchangePointer(dst, exchange, comparand);
 }
 
+void os_create_mutex(OS_Mutex *mutex) {
+    InitializeSRWLock(mutex);
+}
+
+void os_destroy_mutex(OS_Mutex *mutex) {
+    // SRW locks don't own any resources.
+}
+
+void os_lock_mutex(OS_Mutex *mutex) {
+    AcquireSRWLockExclusive(mutex);
+}
+
+void os_unlock_mutex(OS_Mutex *mutex) {
+    ReleaseSRWLockExclusive(mutex);
+}
+
+void os_create_condition(OS_Condition *condition) {
+    InitializeConditionVariable(condition);
+}
+
+void os_destroy_condition(OS_Condition *condition) {
+    // Condition variables don't own any resources.
+}
+
+void os_wait_condition(OS_Condition *condition, OS_Mutex *mutex) {
+    SleepConditionVariableSRW(condition, mutex, INFINITE, 0);
+}
+
+void os_wait_condition_timeout(OS_Condition *condition, OS_Mutex *mutex, s64 milliseconds) {
+    SleepConditionVariableSRW(condition, mutex, (DWORD) milliseconds, 0);
+}
+
+void os_signal_condition(OS_Condition *condition) {
+    WakeConditionVariable(condition);
+}
+
+void os_broadcast_condition(OS_Condition *condition) {
+    WakeAllConditionVariable(condition);
+}
+
 
 
 Hardware_Time os_get_hardware_time() {
@@ -137,3 +255,19 @@ void os_sleep(f64 seconds) {
     Sleep(milliseconds);
 }
 
+
+
+b8 os_open_hardware_counters(OS_Hardware_Counters *counters) {
+    // Windows only exposes these through ETW and a kernel driver, which is more than a line counter should need.
+    for(s64 i = 0; i < OS_COUNTER_COUNT; ++i) counters->handles[i] = -1;
+    counters->available = 0;
+    return false;
+}
+
+void os_read_hardware_counters(OS_Hardware_Counters *counters, u64 values[OS_COUNTER_COUNT]) {
+    memset(values, 0, OS_COUNTER_COUNT * sizeof(u64));
+}
+
+void os_close_hardware_counters(OS_Hardware_Counters *counters) {
+    counters->available = 0;
+}
@@ -9,12 +9,15 @@ typedef enum Line_Result {
 typedef void(*Reset)(void *user_data);
 typedef void(*Eat_Character)(void *user_data, char character);
 typedef Line_Result(*Finish_Line)(void *user_data);
+typedef b8(*Inside_Comment)(void *user_data);
 
 typedef struct Parser {
     void *user_data;
     Reset reset;
     Eat_Character eat_character;
     Finish_Line finish_line;
+    Inside_Comment inside_comment; // Whether the last eaten character was part of a comment
+    s64 state_size;                // Of the user data, which is all the state there is, e.g. for checkpoints
 } Parser;
 
 
@@ -73,6 +76,11 @@ Line_Result c_finish_line(C_Parser *parser) {
     return result;
 }
 
+static
+b8 c_inside_comment(C_Parser *parser) {
+    return parser->inside_single_line_comment || parser->inside_multiline_comment;
+}
+
 typedef struct Jai_Parser {
     Line_Result current_line;
     char previous_character;
@@ -83,6 +91,13 @@ typedef struct Jai_Parser {
 
 thread_local Jai_Parser jai_parser;
 
+//
+// The cache snapshots the state of every parser into CACHE_PARSER_STATE_SIZE bytes, so a parser that outgrows
+// them must not compile. A negative array size works with every compiler, unlike _Static_assert.
+//
+typedef char C_Parser_Fits_Cache_Checkpoint[sizeof(C_Parser) <= CACHE_PARSER_STATE_SIZE ? 1 : -1];
+typedef char Jai_Parser_Fits_Cache_Checkpoint[sizeof(Jai_Parser) <= CACHE_PARSER_STATE_SIZE ? 1 : -1];
+
 static
 void jai_reset_parser(Jai_Parser *parser) {
     parser->current_line                     = LINE_RESULT_Blank;
@@ -125,72 +140,1084 @@ Line_Result jai_finish_line(Jai_Parser *parser) {
     return result;
 }
 
+static
+b8 jai_inside_comment(Jai_Parser *parser) {
+    return parser->inside_single_line_comment || parser->multiline_comment_depth > 0;
+}
+
 
 /* -------------------------------------------------- Worker -------------------------------------------------- */
 
 static inline
-void register_line(Worker *worker, File *file, Parser *parser) {
+Line_Result register_line(Stats *stats, Parser *parser) {
     Line_Result result = parser->finish_line(parser->user_data);
     switch(result) {
-    case LINE_RESULT_Blank:   ++file->stats.blank; break;
-    case LINE_RESULT_Comment: ++file->stats.comment; break;
-    case LINE_RESULT_Code:    ++file->stats.code; break;
+    case LINE_RESULT_Blank:   ++stats->blank; break;
+    case LINE_RESULT_Comment: ++stats->comment; break;
+    case LINE_RESULT_Code:    ++stats->code; break;
     }
+    return result;
 }
 
-int worker_thread(Worker *worker) {
-    worker->file_buffer = malloc(FILE_BUFFER_SIZE);
+// The line that is currently being read while collecting metrics.
+typedef struct Metrics_Line {
+    s64 length;
+    s64 bytes;
+    char first_character;
+    char last_character;
+} Metrics_Line;
+
+// The token state while scanning for functions and branches with '--complexity'. It only ever sees the code
+// characters of a file, the parser already takes care of comments.
+typedef struct Complexity_Scanner {
+    Code_Complexity *complexity;
+    char word[COMPLEXITY_WORD_SIZE]; // The start of the identifier that is currently being read
+    s64 word_length;
+    char previous_character;
+    char string_delimiter;          // '"' or '\'' while inside a literal
+    b8 escaped;
+    b8 number;                      // Whether the last word was a number, in which a '\'' is a digit separator
+    b8 line_has_code;
+    b8 inside_directive;            // The rest of a preprocessor line (including continuations) is skipped
+    b8 skip_word;                   // The word after a '#' is a directive, not a keyword
+    b8 function_candidate;          // A ')' ended the last parameter list, so a '{' would open a function body
+    b8 c_family;                    // Preprocessor lines, character literals and '?' only exist in C and C++
+    s64 paren_depth;
+    s64 brace_depth;
+    s64 function_depth;             // The brace depth outside of the current function body, -1 outside of functions
+    s64 function_branches;
+} Complexity_Scanner;
+
+// Which characters may be part of an identifier or number, since this is checked for every code character.
+static const b8 COMPLEXITY_WORD_CHARACTERS[256] = {
+    ['0'] = 1, ['1'] = 1, ['2'] = 1, ['3'] = 1, ['4'] = 1, ['5'] = 1, ['6'] = 1, ['7'] = 1, ['8'] = 1, ['9'] = 1,
+    ['A'] = 1, ['B'] = 1, ['C'] = 1, ['D'] = 1, ['E'] = 1, ['F'] = 1, ['G'] = 1, ['H'] = 1, ['I'] = 1, ['J'] = 1,
+    ['K'] = 1, ['L'] = 1, ['M'] = 1, ['N'] = 1, ['O'] = 1, ['P'] = 1, ['Q'] = 1, ['R'] = 1, ['S'] = 1, ['T'] = 1,
+    ['U'] = 1, ['V'] = 1, ['W'] = 1, ['X'] = 1, ['Y'] = 1, ['Z'] = 1, ['_'] = 1,
+    ['a'] = 1, ['b'] = 1, ['c'] = 1, ['d'] = 1, ['e'] = 1, ['f'] = 1, ['g'] = 1, ['h'] = 1, ['i'] = 1, ['j'] = 1,
+    ['k'] = 1, ['l'] = 1, ['m'] = 1, ['n'] = 1, ['o'] = 1, ['p'] = 1, ['q'] = 1, ['r'] = 1, ['s'] = 1, ['t'] = 1,
+    ['u'] = 1, ['v'] = 1, ['w'] = 1, ['x'] = 1, ['y'] = 1, ['z'] = 1,
+};
 
+static
+void create_complexity_scanner(Complexity_Scanner *scanner, Code_Complexity *complexity, Language language) {
+    memset(scanner, 0, sizeof(Complexity_Scanner));
+    scanner->complexity     = complexity;
+    scanner->c_family       = language != LANGUAGE_Jai;
+    scanner->function_depth = -1;
+    memset(complexity, 0, sizeof(Code_Complexity));
+}
+
+static
+void count_complexity_branch(Complexity_Scanner *scanner) {
+    ++scanner->complexity->branches;
+    ++scanner->function_branches;
+}
+
+static
+void finish_complexity_word(Complexity_Scanner *scanner) {
     //
-    // Set up the thread local parser table
+    // Longer words can never be one of the keywords, and for them only the start was kept.
     //
-    Parser PARSER_TABLE[LANGUAGE_COUNT] = {
-        { &c_parser,   (Reset) &c_reset_parser,  (Eat_Character) c_eat_character,   (Finish_Line) c_finish_line }, // C
-        { &c_parser,   (Reset) &c_reset_parser,  (Eat_Character) c_eat_character,   (Finish_Line) c_finish_line }, // C Header
-        { &c_parser,   (Reset) &c_reset_parser,  (Eat_Character) c_eat_character,   (Finish_Line) c_finish_line }, // Cpp
-        { &jai_parser, (Reset) jai_reset_parser, (Eat_Character) jai_eat_character, (Finish_Line) jai_finish_line }, // Jai
-    };
+    const char *BRANCH_KEYWORDS[] = { "if", "ifx", "for", "while", "case", "catch" };
+    const s64 BRANCH_KEYWORD_COUNT = sizeof(BRANCH_KEYWORDS) / sizeof(BRANCH_KEYWORDS[0]);
 
-    File *file;
-    while((file = get_next_file_to_parse(worker->cloc))) {
+    s64 length = scanner->word_length;
+    scanner->number      = scanner->word[0] >= '0' && scanner->word[0] <= '9';
+    scanner->word_length = 0;
+
+    if(scanner->skip_word) {
+        scanner->skip_word = false;
+        return;
+    }
+
+    if(length > COMPLEXITY_WORD_SIZE) return;
+
+    for(s64 i = 0; i < BRANCH_KEYWORD_COUNT; ++i) {
+        s64 keyword_length = strlen(BRANCH_KEYWORDS[i]);
+        if(keyword_length == length && memcmp(BRANCH_KEYWORDS[i], scanner->word, length) == 0) {
+            count_complexity_branch(scanner);
+            return;
+        }
+    }
+}
+
+static
+void finish_complexity_function(Complexity_Scanner *scanner) {
+    Code_Complexity *complexity = scanner->complexity;
+    complexity->max_function_complexity = max(complexity->max_function_complexity, scanner->function_branches + 1);
+    scanner->function_depth = -1;
+}
+
+static inline
+void scan_complexity_character(Complexity_Scanner *scanner, char character) {
+    if(scanner->inside_directive) {
+        scanner->previous_character = character;
+        return;
+    }
+
+    if(scanner->string_delimiter) {
+        if(scanner->escaped) {
+            scanner->escaped = false;
+        } else if(character == '\\') {
+            scanner->escaped = true;
+        } else if(character == scanner->string_delimiter) {
+            scanner->string_delimiter = 0;
+        }
+        return;
+    }
+
+    if(scanner->word_length) finish_complexity_word(scanner);
+
+    switch(character) {
+    case '"': scanner->string_delimiter = character; break;
+
+    case '\'':
+        if(scanner->c_family && !(scanner->number && scanner->previous_character >= '0' && scanner->previous_character <= '9')) scanner->string_delimiter = character;
+        break;
+
+    case '#':
+        if(scanner->c_family && !scanner->line_has_code) {
+            scanner->inside_directive = true;
+        } else {
+            scanner->skip_word = true; // Jai's '#if', '#run' and friends
+        }
+        break;
+
+    case '(': ++scanner->paren_depth; break;
+
+    case ')':
+        scanner->paren_depth = max(scanner->paren_depth - 1, 0);
+        if(scanner->paren_depth == 0) scanner->function_candidate = true;
+        break;
+
+    case ';': case '=': scanner->function_candidate = false; break;
+
+    case '{':
         //
-        // Get the appropriate parser for this file
+        // A block right after a parameter list, outside of any other function, is a function body. Lambdas
+        // and local blocks just count towards the function they live in.
         //
-        Parser *parser = &PARSER_TABLE[file->language];
-        parser->reset(parser->user_data);
-        
+        if(scanner->function_candidate && scanner->function_depth < 0) {
+            ++scanner->complexity->functions;
+            scanner->function_depth    = scanner->brace_depth;
+            scanner->function_branches = 0;
+        }
+
+        ++scanner->brace_depth;
+        if(scanner->function_depth >= 0) scanner->complexity->max_nesting_depth = max(scanner->complexity->max_nesting_depth, scanner->brace_depth - scanner->function_depth);
+        scanner->function_candidate = false;
+        break;
+
+    case '}':
+        scanner->brace_depth = max(scanner->brace_depth - 1, 0);
+        if(scanner->brace_depth == scanner->function_depth) finish_complexity_function(scanner);
+        scanner->function_candidate = false;
+        break;
+
+    case '&': case '|':
+        if(scanner->previous_character == character) {
+            count_complexity_branch(scanner);
+            character = 0; // So that a third one doesn't count again
+        }
+        break;
+
+    case '?':
+        if(scanner->c_family) count_complexity_branch(scanner);
+        break;
+    }
+
+    if(character > 32) scanner->line_has_code = true;
+    scanner->previous_character = character;
+}
+
+static
+void finish_complexity_line(Complexity_Scanner *scanner) {
+    if(scanner->word_length) finish_complexity_word(scanner);
+
+    // Preprocessor lines continue after a trailing backslash, literals never do (as far as we care).
+    if(scanner->previous_character != '\\') scanner->inside_directive = false;
+    scanner->string_delimiter   = 0;
+    scanner->escaped            = false;
+    scanner->line_has_code      = false;
+    scanner->previous_character = '\n';
+}
+
+static
+void finish_complexity_scan(Complexity_Scanner *scanner) {
+    if(scanner->function_depth >= 0) finish_complexity_function(scanner); // Unbalanced braces at the end of the file
+}
+
+static inline
+void scan_complexity_code(Complexity_Scanner *scanner, Parser *parser, char character) {
+    //
+    // Words are only checked against comments once they end, instead of asking the parser for every single
+    // letter. Whitespace only matters if it ends a word.
+    //
+    if(COMPLEXITY_WORD_CHARACTERS[(u8) character] && !scanner->string_delimiter && !scanner->inside_directive) {
+        if(scanner->word_length < COMPLEXITY_WORD_SIZE) scanner->word[scanner->word_length] = character;
+        ++scanner->word_length;
+        scanner->previous_character = character;
+        scanner->line_has_code      = true;
+    } else if(scanner->word_length || character > 32) {
+        if(parser->inside_comment(parser->user_data)) {
+            scanner->word_length = 0; // The word was part of a comment
+        } else {
+            scan_complexity_character(scanner, character);
+        }
+    }
+}
+
+// Everything that looks at the lines of a file while they are being counted. Every hook is optional, and they
+// can all run at the same time, so that a file is only ever parsed once no matter which options are given.
+typedef struct Line_Hooks {
+    Line_Hashes *hashes;         // '--duplicates'
+    Line_Metrics *metrics;       // '--metrics'
+    Metrics_Line metrics_line;
+    Complexity_Scanner *scanner; // '--complexity'
+} Line_Hooks;
+
+static
+void finish_hashed_line(Line_Hashes *hashes, Line_Result result) {
+    if(hashes->pending_character) hashes->current_hash = (hashes->current_hash ^ (u8) hashes->pending_character) * 0x100000001b3;
+
+    ++hashes->current_line;
+    if(result == LINE_RESULT_Code && hashes->current_hash != STRING_HASH_SEED) {
+        if(hashes->count == hashes->capacity) {
+            hashes->capacity = max(hashes->capacity * 2, 1024);
+            hashes->hashes   = realloc(hashes->hashes, hashes->capacity * sizeof(u64));
+            hashes->lines    = realloc(hashes->lines, hashes->capacity * sizeof(u32));
+        }
+
+        hashes->hashes[hashes->count] = hashes->current_hash;
+        hashes->lines[hashes->count]  = (u32) hashes->current_line;
+        ++hashes->count;
+    }
+
+    hashes->current_hash      = STRING_HASH_SEED;
+    hashes->pending_character = 0;
+}
+
+static
+void finish_metrics_line(Line_Metrics *metrics, Metrics_Line *line, Line_Result result) {
+    switch(result) {
+    case LINE_RESULT_Blank:   metrics->blank_bytes   += line->bytes; break;
+    case LINE_RESULT_Comment: metrics->comment_bytes += line->bytes; break;
+    case LINE_RESULT_Code:    metrics->code_bytes    += line->bytes; break;
+    }
+
+    s64 bucket = line->length < 80 ? 0 : line->length < 100 ? 1 : line->length < 120 ? 2 : 3;
+    ++metrics->line_length_histogram[bucket];
+    metrics->max_line_length    = max(metrics->max_line_length, line->length);
+    metrics->total_line_length += line->length;
+    if(line->last_character == ' ' || line->last_character == '\t') ++metrics->trailing_whitespace_lines;
+    if(line->first_character == '\t') ++metrics->tab_indented_lines;
+
+    line->length          = 0;
+    line->bytes           = 0;
+    line->first_character = 0;
+    line->last_character  = 0;
+}
+
+static inline
+void finish_line(Stats *stats, Parser *parser, Line_Hooks *hooks) {
+    if(!hooks) {
+        register_line(stats, parser);
+        return;
+    }
+
+    // A word that is still pending might have been part of a single line comment, which ends right here.
+    Complexity_Scanner *scanner = hooks->scanner;
+    if(scanner && scanner->word_length && parser->inside_comment(parser->user_data)) scanner->word_length = 0;
+
+    Line_Result result = register_line(stats, parser);
+    if(hooks->hashes)  finish_hashed_line(hooks->hashes, result);
+    if(hooks->metrics) finish_metrics_line(hooks->metrics, &hooks->metrics_line, result);
+    if(scanner)        finish_complexity_line(scanner);
+}
+
+static inline
+void eat_hooked_character(Parser *parser, Line_Hooks *hooks, char character) {
+    Line_Hashes *hashes = hooks->hashes;
+    b8 was_inside_comment = hashes && parser->inside_comment(parser->user_data);
+    parser->eat_character(parser->user_data, character);
+
+    if(hooks->metrics) {
+        Metrics_Line *line = &hooks->metrics_line;
+        if(line->length == 0) line->first_character = character;
+        line->last_character = character;
+        ++line->length;
+    }
+
+    if(hashes) {
         //
-        // Handle one file
+        // Every code line is hashed with all whitespace and comments stripped, so that lines only differing in
+        // formatting or comments hash to the same value. A '/' might turn out to start a comment with the next
+        // character, so every character is only hashed once we have seen the next one.
         //
-        File_Handle handle = os_open_file(file->file_path);
+        if(parser->inside_comment(parser->user_data)) {
+            hashes->pending_character = 0; // Either already in a comment, or the pending '/' just opened one
+        } else if(!was_inside_comment && character > 32) {
+            if(hashes->pending_character) hashes->current_hash = (hashes->current_hash ^ (u8) hashes->pending_character) * 0x100000001b3;
+            hashes->pending_character = character;
+        }
+    }
+
+    if(hooks->scanner) scan_complexity_code(hooks->scanner, parser, character);
+}
+
+static inline
+void count_chunk(Stats *stats, Parser *parser, Line_Hooks *hooks, char *data, s64 size) {
+    //
+    // The one loop that every file goes through. Since this is inlined, plain counting without any hooks
+    // doesn't pay for the checks.
+    //
+    for(s64 i = 0; i < size; ++i) {
+        char character = data[i];
+        if(hooks && hooks->metrics) ++hooks->metrics_line.bytes;
+
+        switch(character) {
+        case '\r': break; // Ignore
+        case '\n': finish_line(stats, parser, hooks); break;
+        default:
+            if(hooks) {
+                eat_hooked_character(parser, hooks, character);
+            } else {
+                parser->eat_character(parser->user_data, character);
+            }
+            break;
+        }
+    }
+}
+
+static
+Parser get_parser_for_language(Language language) {
+    //
+    // The parser states are thread local, so we cannot build a static table of these,
+    // and instead have to look up the address for the calling thread.
+    //
+    switch(language) {
+    case LANGUAGE_C:
+    case LANGUAGE_C_Header:
+    case LANGUAGE_Cpp: {
+        Parser parser = { &c_parser, (Reset) c_reset_parser, (Eat_Character) c_eat_character, (Finish_Line) c_finish_line, (Inside_Comment) c_inside_comment, sizeof(C_Parser) };
+        return parser;
+    }
+
+    case LANGUAGE_Jai: {
+        Parser parser = { &jai_parser, (Reset) jai_reset_parser, (Eat_Character) jai_eat_character, (Finish_Line) jai_finish_line, (Inside_Comment) jai_inside_comment, sizeof(Jai_Parser) };
+        return parser;
+    }
+
+    default: {
+        Parser parser = { 0 };
+        assert(false && "Invalid language for a parser.");
+        return parser;
+    }
+    }
+}
+
+void create_worker_with_buffer(Worker *worker, struct Cloc *cloc, char *file_buffer, s64 file_buffer_size) {
+    worker->cloc             = cloc;
+    worker->file_buffer      = file_buffer;
+    worker->file_buffer_size = file_buffer_size;
+    worker->owns_file_buffer = false;
+    worker->path_buffer      = NULL;
+    worker->path_capacity    = 0;
+    worker->totals           = NULL;
+    worker->counters         = NULL;
+    worker->trace            = NULL;
+    worker->opened_file      = NULL;
+    worker->progress.files_done = 0;
+    worker->progress.bytes_done = 0;
+    worker->progress.lines_done = 0;
+}
+
+void create_worker(Worker *worker, struct Cloc *cloc) {
+    create_worker_with_buffer(worker, cloc, malloc(FILE_BUFFER_SIZE), FILE_BUFFER_SIZE);
+    worker->owns_file_buffer = true;
+}
+
+void destroy_worker(Worker *worker) {
+    if(worker->owns_file_buffer) free(worker->file_buffer);
+    free(worker->path_buffer);
+    worker->file_buffer   = NULL;
+    worker->path_buffer   = NULL;
+    worker->path_capacity = 0;
+}
+
+static inline
+void enter_counter_phase(Worker *worker, Counter_Phase phase) {
+    if(worker->counters) switch_counter_phase(worker->counters, phase);
+}
+
+static inline
+Hardware_Time begin_trace_span(Worker *worker) {
+    return worker->trace ? os_get_hardware_time() : 0;
+}
+
+static inline
+void end_trace_span(Worker *worker, Trace_Span_Kind kind, Hardware_Time start, File *file, s64 bytes) {
+    if(worker->trace) record_trace_span(worker->trace, kind, start, file, bytes);
+}
+
+char *get_worker_file_path(Worker *worker, File *file) {
+    s64 length = get_file_path_length(file, NULL);
+
+    if(length + 1 > worker->path_capacity) {
+        worker->path_capacity = max(length + 1, worker->path_capacity * 2);
+        worker->path_buffer   = realloc(worker->path_buffer, worker->path_capacity);
+    }
+
+    write_file_path(worker->path_buffer, file, NULL);
+    return worker->path_buffer;
+}
+
+static
+File_Handle open_file_for_worker(Worker *worker, File *file) {
+    Hardware_Time open_start = begin_trace_span(worker);
+    File_Handle handle = os_open_file(get_worker_file_path(worker, file));
+    end_trace_span(worker, TRACE_SPAN_File_Open, open_start, file, 0);
+    return handle;
+}
+
+static
+File_Handle open_worker_file(Worker *worker, File *file) {
+    // The readahead window already opened the file, and the handle is only ever used once.
+    if(worker->opened_file == file) {
+        worker->opened_file = NULL;
+        return worker->opened_handle;
+    }
+
+    return open_file_for_worker(worker, file);
+}
+
+static
+b8 find_generated_marker(char *data, s64 size) {
+    const char *MARKERS[] = { "@generated", "DO NOT EDIT", "Code generated by", "auto-generated", "Auto-generated", "autogenerated", "Autogenerated" };
+    const s64 MARKER_COUNT = sizeof(MARKERS) / sizeof(MARKERS[0]);
+
+    for(s64 i = 0; i < MARKER_COUNT; ++i) {
+        s64 marker_length = strlen(MARKERS[i]);
+        for(s64 j = 0; j + marker_length <= size; ++j) {
+            if(data[j] == MARKERS[i][0] && memcmp(&data[j], MARKERS[i], marker_length) == 0) return true;
+        }
+    }
+
+    return false;
+}
+
+static
+File_Status sniff_file_status(char *data, s64 size) {
+    //
+    // Look at the start of the file to figure out whether it is worth parsing at all. Any NUL byte means
+    // binary content. Very long lines on average mean minified or otherwise machine-generated content, and
+    // so do the usual markers that code generators put into their file headers.
+    //
+    size = min(size, SNIFF_SIZE);
+
+    s64 nul_count     = 0;
+    s64 newline_count = 0;
+    s64 index         = 0;
+
+#if USE_SSE2
+    __m128i zero    = _mm_setzero_si128();
+    __m128i newline = _mm_set1_epi8('\n');
+
+    for(; index + 16 <= size; index += 16) {
+        __m128i block = _mm_loadu_si128((__m128i *) &data[index]);
+        nul_count     += _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)) != 0;
+        newline_count += os_count_set_bits(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+    }
+#endif
+
+    for(; index < size; ++index) {
+        nul_count     += data[index] == 0;
+        newline_count += data[index] == '\n';
+    }
+
+    if(nul_count) return FILE_Binary;
+
+    s64 line_count = newline_count + (size > 0 && data[size - 1] != '\n');
+    if(line_count > 0 && size / line_count > GENERATED_LINE_LENGTH) return FILE_Generated;
+
+    if(find_generated_marker(data, min(size, SNIFF_MARKER_SIZE))) return FILE_Generated;
+
+    return FILE_Source;
+}
+
+static
+b8 drop_sniffed_file(Worker *worker, File *file, File_Status status) {
+    //
+    // Generated files are counted like any other source, unless they should be reported on their own, or
+    // skipped. Binary files are always dropped.
+    //
+    Cloc *cloc = worker->cloc;
+    if(status == FILE_Generated && !cloc->report_generated && !cloc->skip_generated) status = FILE_Source;
+
+    file->status = status;
+    return status == FILE_Binary || (status == FILE_Generated && cloc->skip_generated);
+}
+
+static
+s64 count_newlines(char *data, s64 size) {
+    s64 newline_count = 0;
+    s64 index         = 0;
+
+#if USE_SSE2
+    //
+    // Count the newlines in 16 byte lanes, and fold the lanes into the total before they can overflow.
+    //
+    __m128i zero    = _mm_setzero_si128();
+    __m128i newline = _mm_set1_epi8('\n');
+
+    while(index + 16 <= size) {
+        __m128i lanes = zero;
+        for(s64 i = 0; i < 255 && index + 16 <= size; ++i, index += 16) {
+            __m128i block = _mm_loadu_si128((__m128i *) &data[index]);
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(block, newline));
+        }
+
+        __m128i sums   = _mm_sad_epu8(lanes, zero);
+        newline_count += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+    }
+#endif
+
+    for(char *end = &data[size], *pointer = &data[index]; (pointer = memchr(pointer, '\n', end - pointer)) != NULL; ++pointer) {
+        ++newline_count;
+    }
+
+    return newline_count;
+}
+
+typedef enum Text_Encoding {
+    TEXT_ENCODING_Bytes, // ASCII, UTF-8 or anything else where every line break is a single '\n' byte
+    TEXT_ENCODING_Utf16_Le,
+    TEXT_ENCODING_Utf16_Be,
+} Text_Encoding;
+
+static
+Text_Encoding detect_text_encoding(char *data, s64 size, s64 *bom_size) {
+    u8 *bytes = (u8 *) data;
+    *bom_size = 0;
+
+    if(size >= 3 && bytes[0] == 0xef && bytes[1] == 0xbb && bytes[2] == 0xbf) {
+        *bom_size = 3;
+        return TEXT_ENCODING_Bytes;
+    }
+
+    if(size >= 2 && bytes[0] == 0xff && bytes[1] == 0xfe) {
+        *bom_size = 2;
+        return TEXT_ENCODING_Utf16_Le;
+    }
+
+    if(size >= 2 && bytes[0] == 0xfe && bytes[1] == 0xff) {
+        *bom_size = 2;
+        return TEXT_ENCODING_Utf16_Be;
+    }
+
+    //
+    // Without a byte order mark, UTF-16 text that is mostly ASCII has a NUL in every other byte, and almost
+    // never in the other ones. Anything else with NUL bytes is left for the binary check. Text files never
+    // have a NUL right at the start, so they don't pay for the full scan.
+    //
+    if(!memchr(data, 0, min(size, UTF16_DETECTION_SIZE))) return TEXT_ENCODING_Bytes;
+
+    s64 unit_count = min(size, SNIFF_SIZE) / 2;
+    s64 even_nul_count = 0, odd_nul_count = 0;
+    for(s64 i = 0; i < unit_count; ++i) {
+        even_nul_count += bytes[i * 2] == 0;
+        odd_nul_count  += bytes[i * 2 + 1] == 0;
+    }
+
+    if(odd_nul_count * 10 >= unit_count * 9 && even_nul_count * 10 <= unit_count) return TEXT_ENCODING_Utf16_Le;
+    if(even_nul_count * 10 >= unit_count * 9 && odd_nul_count * 10 <= unit_count) return TEXT_ENCODING_Utf16_Be;
+    return TEXT_ENCODING_Bytes;
+}
+
+static
+void narrow_utf16(char *dst, char *src, s64 unit_count, Text_Encoding encoding) {
+    //
+    // The parsers only care about ASCII, so every UTF-16 code unit becomes one byte: ASCII stays as it is, and
+    // everything else becomes 0x80, which the parsers treat just like the bytes of a multibyte UTF-8 sequence.
+    // This way UTF-16 text counts exactly like the same text in UTF-8.
+    //
+    s64 index = 0;
+
+#if USE_SSE2
+    __m128i zero            = _mm_setzero_si128();
+    __m128i non_ascii_bits  = _mm_set1_epi16((short) 0xff80);
+    __m128i non_ascii_value = _mm_set1_epi16(0x80);
+
+    for(; index + 16 <= unit_count; index += 16) {
+        __m128i lo = _mm_loadu_si128((__m128i *) &src[index * 2]);
+        __m128i hi = _mm_loadu_si128((__m128i *) &src[index * 2 + 16]);
+
+        if(encoding == TEXT_ENCODING_Utf16_Be) {
+            lo = _mm_or_si128(_mm_slli_epi16(lo, 8), _mm_srli_epi16(lo, 8));
+            hi = _mm_or_si128(_mm_slli_epi16(hi, 8), _mm_srli_epi16(hi, 8));
+        }
+
+        __m128i lo_ascii = _mm_cmpeq_epi16(_mm_and_si128(lo, non_ascii_bits), zero);
+        __m128i hi_ascii = _mm_cmpeq_epi16(_mm_and_si128(hi, non_ascii_bits), zero);
+        lo = _mm_or_si128(_mm_and_si128(lo_ascii, lo), _mm_andnot_si128(lo_ascii, non_ascii_value));
+        hi = _mm_or_si128(_mm_and_si128(hi_ascii, hi), _mm_andnot_si128(hi_ascii, non_ascii_value));
+        _mm_storeu_si128((__m128i *) &dst[index], _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for(; index < unit_count; ++index) {
+        u8 *unit = (u8 *) &src[index * 2];
+        u16 value = encoding == TEXT_ENCODING_Utf16_Le ? (unit[0] | (unit[1] << 8)) : ((unit[0] << 8) | unit[1]);
+        dst[index] = value < 0x80 ? (char) value : (char) 0x80;
+    }
+}
+
+static
+File_Status sniff_text_status(char *data, s64 size, Text_Encoding encoding) {
+    if(encoding == TEXT_ENCODING_Bytes) return sniff_file_status(data, size);
+
+    // A NUL code unit still means binary content, while the NUL bytes of ASCII characters are gone.
+    char narrowed[SNIFF_SIZE / 2];
+    s64 unit_count = min(size, SNIFF_SIZE) / 2;
+    narrow_utf16(narrowed, data, unit_count, encoding);
+    return sniff_file_status(narrowed, unit_count);
+}
+
+static
+Line_Hooks *create_line_hooks(Line_Hooks *hooks, Complexity_Scanner *scanner, Worker *worker, File *file, Line_Hashes *hashes) {
+    memset(hooks, 0, sizeof(Line_Hooks));
+    hooks->hashes  = hashes;
+    hooks->metrics = get_file_metrics(worker->cloc, file);
+    if(hooks->metrics) memset(hooks->metrics, 0, sizeof(Line_Metrics));
+
+    Code_Complexity *complexity = get_file_complexity(worker->cloc, file);
+    if(complexity) {
+        create_complexity_scanner(scanner, complexity, file->language);
+        hooks->scanner = scanner;
+    }
+
+    return (hooks->hashes || hooks->metrics || hooks->scanner) ? hooks : NULL; // Plain counting skips the hooks entirely
+}
+
+static inline
+void count_text(Stats *stats, Parser *parser, Line_Hooks *hooks, char *data, s64 size) {
+    if(hooks) {
+        count_chunk(stats, parser, hooks, data, size);
+    } else {
+        count_chunk(stats, parser, NULL, data, size);
+    }
+}
+
+static
+void count_utf16_text(Stats *stats, Parser *parser, Line_Hooks *hooks, char *data, s64 size, Text_Encoding encoding) {
+    //
+    // The text is narrowed in small blocks that stay in the L1 cache, instead of transcoding the whole file
+    // into a second buffer first.
+    //
+    char narrowed[UTF16_BLOCK_SIZE];
+    for(s64 offset = 0; offset + 2 <= size; offset += UTF16_BLOCK_SIZE * 2) {
+        s64 unit_count = min(UTF16_BLOCK_SIZE, (size - offset) / 2);
+        narrow_utf16(narrowed, &data[offset], unit_count, encoding);
+        count_text(stats, parser, hooks, narrowed, unit_count);
+    }
+}
+
+//
+// Reads a file chunk by chunk into the worker buffer, for every way of counting it. The first chunk decides
+// the encoding and gets sniffed, before anybody spends time on parsing it. A byte order mark is not part of
+// the content, and must not turn the first line into code.
+//
+typedef struct Chunk_Reader {
+    Worker *worker;
+    File *file;
+    File_Handle handle;
+    s64 file_size;
+    s64 offset_in_file; // Where the current chunk starts
+    s64 chunk_size;     // How much of the file the current chunk covers, including a byte order mark
+    Hardware_Time parse_start;
+
+    Text_Encoding encoding;
+    File_Status sniffed_status; // Only valid on the first chunk
+    char *data;                 // The content of the current chunk, UTF-16 only ever in whole code units
+    s64 size;
+    b8 inside_line;             // Whether the content so far ends in an unterminated line
+} Chunk_Reader;
+
+static
+void open_chunk_reader(Chunk_Reader *reader, Worker *worker, File *file) {
+    memset(reader, 0, sizeof(Chunk_Reader));
+    reader->worker    = worker;
+    reader->file      = file;
+    reader->handle    = open_worker_file(worker, file);
+    reader->file_size = os_get_file_size(reader->handle);
+    reader->encoding  = TEXT_ENCODING_Bytes;
+}
+
+static
+b8 read_next_chunk(Chunk_Reader *reader) {
+    Worker *worker = reader->worker;
+
+    if(reader->chunk_size > 0) {
+        reader->offset_in_file += reader->chunk_size;
+        end_trace_span(worker, TRACE_SPAN_Parse, reader->parse_start, reader->file, reader->chunk_size);
+        reader->chunk_size = 0;
+    }
+
+    if(reader->offset_in_file >= reader->file_size) return false;
+
+    s64 chunk_size = min(worker->file_buffer_size, reader->file_size - reader->offset_in_file);
+    enter_counter_phase(worker, COUNTER_PHASE_Read);
+    Hardware_Time read_start = begin_trace_span(worker);
+    chunk_size = os_read_file(reader->handle, worker->file_buffer, reader->offset_in_file, chunk_size);
+    end_trace_span(worker, TRACE_SPAN_Read_Chunk, read_start, reader->file, max(chunk_size, 0));
+    enter_counter_phase(worker, COUNTER_PHASE_Parse);
+    reader->parse_start = begin_trace_span(worker);
+    if(chunk_size <= 0) return false; // The file was truncated while we were reading it
+
+    reader->data = worker->file_buffer;
+    reader->size = chunk_size;
+
+    if(reader->offset_in_file == 0) {
+        s64 bom_size;
+        reader->encoding = detect_text_encoding(reader->data, reader->size, &bom_size);
+        reader->data += bom_size;
+        reader->size -= bom_size;
+        reader->sniffed_status = sniff_text_status(reader->data, reader->size, reader->encoding);
+    }
+
+    if(reader->encoding == TEXT_ENCODING_Bytes) {
+        if(reader->size > 0) reader->inside_line = reader->data[reader->size - 1] != '\n';
+    } else {
+        reader->size &= ~(s64) 1; // A code unit that was cut in half is read again with the next chunk
+        chunk_size = (reader->data - worker->file_buffer) + reader->size;
+        if(reader->size == 0) return false; // A single stray byte at the end of the file
+
+        char last_character;
+        narrow_utf16(&last_character, &reader->data[reader->size - 2], 1, reader->encoding);
+        reader->inside_line = last_character != '\n';
+    }
+
+    reader->chunk_size = chunk_size;
+    return true;
+}
+
+static
+void close_chunk_reader(Chunk_Reader *reader) {
+    reader->file->bytes = reader->offset_in_file;
+    os_close_file(reader->handle);
+}
+
+static
+void count_raw_file(Worker *worker, File *file) {
+    //
+    // Files of unknown languages only get their physical lines counted, there is nothing to classify.
+    //
+    file->status           = FILE_Raw;
+    file->stats.blank      = 0;
+    file->stats.comment    = 0;
+    file->stats.code       = 0;
+    file->stats.file_count = 1;
+
+    Chunk_Reader reader;
+    open_chunk_reader(&reader, worker, file);
+
+    while(read_next_chunk(&reader)) {
+        if(reader.offset_in_file == 0 && reader.sniffed_status == FILE_Binary) {
+            file->status           = FILE_Binary;
+            file->stats.file_count = 0;
+            break;
+        }
+
+        if(reader.encoding == TEXT_ENCODING_Bytes) {
+            file->stats.code += count_newlines(reader.data, reader.size);
+        } else {
+            char narrowed[UTF16_BLOCK_SIZE];
+            for(s64 offset = 0; offset < reader.size; offset += UTF16_BLOCK_SIZE * 2) {
+                s64 unit_count = min(UTF16_BLOCK_SIZE, (reader.size - offset) / 2);
+                narrow_utf16(narrowed, &reader.data[offset], unit_count, reader.encoding);
+                file->stats.code += count_newlines(narrowed, unit_count);
+            }
+        }
+    }
+
+    if(file->status == FILE_Raw && reader.inside_line) ++file->stats.code;
 
-        s64 file_size = os_get_file_size(handle);
-        s64 offset_in_file = 0;
-        s64 chunk_size = 0;
+    close_chunk_reader(&reader);
+}
+
+static
+void count_file_internal(Worker *worker, File *file, Line_Hashes *hashes) {
+    //
+    // Get the appropriate parser for this file
+    //
+    Parser parser = get_parser_for_language(file->language);
+    parser.reset(parser.user_data);
+
+    file->status           = FILE_Source;
+    file->stats.blank      = 0;
+    file->stats.comment    = 0;
+    file->stats.code       = 0;
+    file->stats.file_count = 1;
+
+    Line_Hooks line_hooks;
+    Complexity_Scanner complexity_scanner;
+    Line_Hooks *hooks = create_line_hooks(&line_hooks, &complexity_scanner, worker, file, hashes);
+    
+    //
+    // Handle one file
+    //
+    Chunk_Reader reader;
+    open_chunk_reader(&reader, worker, file);
+
+    while(read_next_chunk(&reader)) {
+        if(reader.offset_in_file == 0 && drop_sniffed_file(worker, file, reader.sniffed_status)) {
+            file->stats.file_count = 0;
+            close_chunk_reader(&reader);
+            return;
+        }
+
+        if(reader.encoding == TEXT_ENCODING_Bytes) {
+            count_text(&file->stats, &parser, hooks, reader.data, reader.size);
+        } else {
+            count_utf16_text(&file->stats, &parser, hooks, reader.data, reader.size, reader.encoding);
+        }
+    }
+
+    if(reader.inside_line) finish_line(&file->stats, &parser, hooks);
+    if(line_hooks.scanner) finish_complexity_scan(line_hooks.scanner);
         
-        while(offset_in_file < file_size) {
+    close_chunk_reader(&reader);
+}
+
+static
+u64 hash_cache_block(char *data, s64 size) {
+    //
+    // This only needs to notice changed blocks, and has to be a lot cheaper than parsing them again, so it
+    // eats eight bytes at a time.
+    //
+    u64 hash = STRING_HASH_SEED ^ (u64) size;
+    s64 index = 0;
+
+    for(; index + 8 <= size; index += 8) {
+        u64 word;
+        memcpy(&word, &data[index], sizeof(u64));
+        hash = (hash ^ word) * 0xbf58476d1ce4e5b9;
+        hash ^= hash >> 31;
+    }
+
+    for(; index < size; ++index) hash = (hash ^ (u8) data[index]) * 0x100000001b3;
+
+    return hash;
+}
+
+static
+void push_cache_checkpoint(File_Cache *cache, Cache_Checkpoint *checkpoint) {
+    if(cache->checkpoint_count == cache->checkpoint_capacity) {
+        cache->checkpoint_capacity = max(cache->checkpoint_capacity * 2, 16);
+        cache->checkpoints = realloc(cache->checkpoints, cache->checkpoint_capacity * sizeof(Cache_Checkpoint));
+    }
+
+    cache->checkpoints[cache->checkpoint_count++] = *checkpoint;
+}
+
+static
+void restore_cache_checkpoint(File *file, Parser *parser, Cache_Checkpoint *checkpoint) {
+    file->stats.blank   = checkpoint->blank;
+    file->stats.comment = checkpoint->comment;
+    file->stats.code    = checkpoint->code;
+    memcpy(parser->user_data, checkpoint->parser_state, parser->state_size);
+}
+
+static
+void count_file_with_checkpoints(Worker *worker, File *file, File_Cache *cache) {
+    cache->checkpoint_count = 0;
+
+    Parser parser = get_parser_for_language(file->language);
+    parser.reset(parser.user_data);
+
+    file->status           = FILE_Source;
+    file->stats.blank      = 0;
+    file->stats.comment    = 0;
+    file->stats.code       = 0;
+    file->stats.file_count = 1;
+
+    //
+    // The checkpoints only know the line counts and the parser state, not what the hooks collected. With
+    // '--metrics' or '--complexity' every block is parsed again, but its checkpoint is still written, so the
+    // next run without them can adopt it.
+    //
+    Line_Hooks line_hooks;
+    Complexity_Scanner complexity_scanner;
+    Line_Hooks *hooks = create_line_hooks(&line_hooks, &complexity_scanner, worker, file, NULL);
+
+    Chunk_Reader reader;
+    open_chunk_reader(&reader, worker, file);
+    b8 adopting = hooks == NULL; // Whether every block so far is unchanged since the previous run
+
+    while(read_next_chunk(&reader)) {
+        if(reader.offset_in_file == 0 && drop_sniffed_file(worker, file, reader.sniffed_status)) {
+            file->stats.file_count = 0;
+            close_chunk_reader(&reader);
+            return;
+        }
+
+        //
+        // UTF-16 files are rare enough that they are just counted without checkpoints, instead of dealing
+        // with code units that straddle block boundaries.
+        //
+        if(reader.encoding != TEXT_ENCODING_Bytes) {
+            count_utf16_text(&file->stats, &parser, hooks, reader.data, reader.size, reader.encoding);
+            continue;
+        }
+
+        for(s64 block_start = 0; block_start < reader.chunk_size; block_start += CACHE_BLOCK_SIZE) {
+            char *block     = &worker->file_buffer[block_start];
+            s64 block_size  = min(CACHE_BLOCK_SIZE, reader.chunk_size - block_start);
+            s64 block_end   = reader.offset_in_file + block_start + block_size;
+            u64 block_hash  = hash_cache_block(block, block_size);
+            s64 index       = cache->checkpoint_count;
+
+            if(adopting && index < cache->previous_count && cache->previous[index].end == block_end && cache->previous[index].hash == block_hash) {
+                push_cache_checkpoint(cache, &cache->previous[index]);
+                continue;
+            }
+
             //
-            // Handle one chunk of the file
+            // The first changed block. Everything before it is known, so continue parsing right where the
+            // last unchanged block left off.
             //
-            chunk_size = min(FILE_BUFFER_SIZE, file_size - offset_in_file);
-            chunk_size = os_read_file(handle, worker->file_buffer, offset_in_file, chunk_size);
-            
-            for(s64 i = 0; i < chunk_size; ++i) {
-                char character = worker->file_buffer[i];
-
-                switch(character) {
-                case '\r': break; // Ignore
-                case '\n': register_line(worker, file, parser); break;
-                default: parser->eat_character(parser->user_data, character); break;
-                }
+            if(adopting) {
+                if(index > 0) restore_cache_checkpoint(file, &parser, &cache->checkpoints[index - 1]);
+                adopting = false;
             }
-        
-            offset_in_file += chunk_size;
+
+            s64 skip = (block_start == 0) ? reader.data - worker->file_buffer : 0; // The byte order mark
+            count_text(&file->stats, &parser, hooks, block + skip, block_size - skip);
+
+            Cache_Checkpoint checkpoint;
+            checkpoint.end     = block_end;
+            checkpoint.hash    = block_hash;
+            checkpoint.blank   = file->stats.blank;
+            checkpoint.comment = file->stats.comment;
+            checkpoint.code    = file->stats.code;
+            memcpy(checkpoint.parser_state, parser.user_data, parser.state_size);
+            push_cache_checkpoint(cache, &checkpoint);
         }
+    }
 
-        if(chunk_size > 0 && worker->file_buffer[chunk_size - 1] != '\n') register_line(worker, file, parser);
-        
-        os_close_file(handle);
+    if(adopting && cache->checkpoint_count > 0) restore_cache_checkpoint(file, &parser, &cache->checkpoints[cache->checkpoint_count - 1]);
+
+    if(reader.inside_line) finish_line(&file->stats, &parser, hooks);
+    if(line_hooks.scanner) finish_complexity_scan(line_hooks.scanner);
+
+    close_chunk_reader(&reader);
+}
+
+void count_file(Worker *worker, File *file) {
+    if(file->language == LANGUAGE_COUNT) {
+        count_raw_file(worker, file);
+    } else if(worker->cloc->cache) {
+        count_file_with_checkpoints(worker, file, get_file_cache(worker->cloc->cache, file));
+    } else {
+        count_file_internal(worker, file, NULL);
     }
+}
+
+void count_file_with_line_hashes(Worker *worker, File *file, Line_Hashes *hashes) {
+    hashes->count             = 0;
+    hashes->current_line      = 0;
+    hashes->current_hash      = STRING_HASH_SEED;
+    hashes->pending_character = 0;
+    count_file_internal(worker, file, hashes);
+}
+
+void note_file_done(Worker *worker, File *file) {
+    if(worker->totals) add_file_to_totals(worker->cloc, worker->totals, file);
+
+    // Plain stores are enough, nobody else ever writes these counters.
+    worker->progress.files_done += 1;
+    worker->progress.bytes_done += file->bytes;
+    worker->progress.lines_done += file->stats.blank + file->stats.comment + file->stats.code;
+}
+
+void count_buffer(Stats *stats, Language language, char *data, s64 size) {
+    Parser parser = get_parser_for_language(language);
+    parser.reset(parser.user_data);
+
+    s64 bom_size;
+    Text_Encoding encoding = detect_text_encoding(data, size, &bom_size);
+    data += bom_size;
+    size -= bom_size;
+
+    if(encoding == TEXT_ENCODING_Bytes) {
+        count_chunk(stats, &parser, NULL, data, size);
+        if(size > 0 && data[size - 1] != '\n') register_line(stats, &parser);
+    } else if(size >= 2) {
+        size &= ~(s64) 1;
+        count_utf16_text(stats, &parser, NULL, data, size, encoding);
+
+        char last_character;
+        narrow_utf16(&last_character, &data[size - 2], 1, encoding);
+        if(last_character != '\n') register_line(stats, &parser);
+    }
+}
+
+static
+File *take_next_file(Worker *worker) {
+    Hardware_Time wait_start = begin_trace_span(worker);
+    File *file = get_next_file_to_parse(worker->cloc);
+    end_trace_span(worker, TRACE_SPAN_Queue_Wait, wait_start, file, 0);
+    return file;
+}
+
+int worker_thread(Worker *worker) {
+    // Counters only count the thread that opened them.
+    if(worker->counters && !start_thread_counters(worker->counters, COUNTER_PHASE_Read)) worker->counters = NULL;
+
+    //
+    // When the files are sorted by where they live on disk, every worker keeps a small window of files that
+    // it already took off the queue, opened and hinted to the kernel, and counts the oldest of them. The
+    // handles are opened anyway, so hinting costs no extra open, and the window is full before the first
+    // read. Together the windows of all workers cover READAHEAD_DISTANCE files ahead.
+    //
+    File *window_files[READAHEAD_DISTANCE];
+    File_Handle window_handles[READAHEAD_DISTANCE];
+    s64 window_first = 0;
+    s64 window_count = 0;
+    s64 window_size  = 0;
+    if(worker->cloc->read_order != READ_ORDER_Traversal) window_size = max(READAHEAD_DISTANCE / max(worker->cloc->active_workers, 1), 1);
+
+    File *file;
+    while(true) {
+        while(window_count < window_size && (file = take_next_file(worker)) != NULL) {
+            s64 slot = (window_first + window_count) % READAHEAD_DISTANCE;
+            window_files[slot]   = file;
+            window_handles[slot] = open_file_for_worker(worker, file);
+            os_hint_file_read(window_handles[slot]);
+            ++window_count;
+        }
+
+        if(window_count) {
+            file = window_files[window_first];
+            worker->opened_file   = file;
+            worker->opened_handle = window_handles[window_first];
+            window_first = (window_first + 1) % READAHEAD_DISTANCE;
+            --window_count;
+        } else {
+            file = take_next_file(worker);
+            if(!file) break;
+        }
+
+        count_file(worker, file);
+        note_file_done(worker, file);
+
+        // In streaming mode the file is handed over to the output, and may be reused right away.
+        if(worker->cloc->stream) finish_stream_file(worker->cloc->stream, file);
+
+        enter_counter_phase(worker, COUNTER_PHASE_Read); // Taking the next file off the queue and opening it
+    }
+
+    if(worker->counters) stop_thread_counters(worker->counters);
     return 0;
 }
@@ -1,11 +1,68 @@
 struct Cloc;
+struct File;
+struct Thread_Counters;
+struct Trace_Buffer;
 
 #define FILE_BUFFER_SIZE 1024 * 1024
+#define INLINE_FILE_BUFFER_SIZE 256 * 1024 // At least SNIFF_SIZE, and a multiple of the cache block size
+#define INLINE_MAX_FILES 8                 // Inputs up to this size are counted on the main thread...
+#define INLINE_MAX_BYTES 256 * 1024        // ...instead of spawning workers
+#define SNIFF_SIZE 64 * 1024          // How much of the first chunk is looked at to classify a file
+#define SNIFF_MARKER_SIZE 2 * 1024    // How far into a file we look for generated-file markers
+#define GENERATED_LINE_LENGTH 300     // Average line length above which a file is considered minified
+#define READAHEAD_DISTANCE 16         // How many files ahead of the current ones we ask the kernel to prefetch, split across the workers
+#define UTF16_DETECTION_SIZE 64       // A file without a byte order mark is only checked for UTF-16 if it has a NUL this early
+#define UTF16_BLOCK_SIZE 4 * 1024     // How many UTF-16 code units are narrowed at once
+#define COMPLEXITY_WORD_SIZE 8       // Long enough for every branch keyword
+#define CACHE_LINE_SIZE 64
+
+//
+// Only ever written by the worker that owns them, and read by the progress reporter. They live on a cache
+// line of their own, so that bumping them never invalidates anything the other workers are reading.
+//
+typedef struct Worker_Progress {
+    u8 padding_before[CACHE_LINE_SIZE];
+    volatile s64 files_done;
+    volatile s64 bytes_done;
+    volatile s64 lines_done;
+    u8 padding_after[CACHE_LINE_SIZE - 3 * sizeof(s64)];
+} Worker_Progress;
 
 typedef struct Worker {
     struct Cloc *cloc;
     Pid pid;
     char *file_buffer;
+    s64 file_buffer_size;
+    b8 owns_file_buffer;
+    char *path_buffer; // Full paths are only built on demand, since files just store their name
+    s64 path_capacity;
+    struct File_Totals *totals; // Only set for the workers that count the files of the main run
+    struct Thread_Counters *counters; // Only set with '--hw-counters'
+    struct Trace_Buffer *trace;       // Only set with '--trace'
+    struct File *opened_file;         // Already opened and hinted by the readahead window, and about to be counted
+    File_Handle opened_handle;
+    Worker_Progress progress;
 } Worker;
 
+// The normalized hashes of all code lines in a file, together with their line numbers. Only filled when
+// looking for duplicated code.
+typedef struct Line_Hashes {
+    u64 *hashes;
+    u32 *lines;
+    s64 count;
+    s64 capacity;
+
+    // --- State while hashing
+    u64 current_hash;
+    s64 current_line;
+    char pending_character;
+} Line_Hashes;
+
+void create_worker(Worker *worker, struct Cloc *cloc);
+void create_worker_with_buffer(Worker *worker, struct Cloc *cloc, char *file_buffer, s64 file_buffer_size);
+void destroy_worker(Worker *worker);
+char *get_worker_file_path(Worker *worker, struct File *file);
+void count_file(Worker *worker, struct File *file);
+void count_file_with_line_hashes(Worker *worker, struct File *file, Line_Hashes *hashes);
+void note_file_done(Worker *worker, struct File *file);
 int worker_thread(Worker *worker);